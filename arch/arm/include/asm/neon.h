@@ -0,0 +1,24 @@
+/*
+ * arch/arm/include/asm/neon.h
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#ifndef __ASM_ARM_NEON_H
+#define __ASM_ARM_NEON_H
+
+#include <asm/hwcap.h>
+
+#define cpu_has_neon()		(!!(elf_hwcap & HWCAP_NEON))
+
+/*
+ * NEON registers may only be used by the kernel between
+ * kernel_neon_begin() and kernel_neon_end().  The section must not be
+ * entered from interrupt context, runs with preemption disabled and
+ * must not sleep.  Sections do not nest.
+ */
+extern void kernel_neon_begin(void);
+extern void kernel_neon_end(void);
+
+#endif /* __ASM_ARM_NEON_H */
@@ -148,8 +148,13 @@ extern void __cpu_copy_user_highpage(struct page *to, struct page *from,
 #define copy_user_highpage(to,from,vaddr,vma)	\
 	__cpu_copy_user_highpage(to, from, vaddr, vma)
 
+#ifdef CONFIG_NEON_PAGE_OPS
+extern void clear_page(void *page);
+#else
 #define clear_page(page)	memset((void *)(page), 0, PAGE_SIZE)
+#endif
 extern void copy_page(void *to, const void *from);
+extern void __copy_page_std(void *to, const void *from);
 
 typedef unsigned long pteval_t;
 
@@ -3,4 +3,29 @@
 
 #include <asm-generic/percpu.h>
 
+#ifdef CONFIG_CMPXCHG_DOUBLE
+/*
+ * Per cpu double word cmpxchg on top of ldrexd/strexd. The exclusive
+ * monitor is cleared on every exception return, so an interrupt that
+ * hits between the load and the store makes the store fail and the
+ * compare is redone. Only preemption has to be held off to stay on
+ * this cpu's data; interrupts can stay enabled.
+ */
+#define __this_cpu_cmpxchg_double_4(pcp1, pcp2, o1, o2, n1, n2)		\
+	cmpxchg_double_local(__this_cpu_ptr(&(pcp1)), o1, o2, n1, n2)
+
+#define this_cpu_cmpxchg_double_4(pcp1, pcp2, o1, o2, n1, n2)		\
+({									\
+	int __ret;							\
+	preempt_disable();						\
+	__ret = __this_cpu_cmpxchg_double_4(pcp1, pcp2,			\
+					    o1, o2, n1, n2);		\
+	preempt_enable();						\
+	__ret;								\
+})
+
+#define irqsafe_cpu_cmpxchg_double_4(pcp1, pcp2, o1, o2, n1, n2)	\
+	this_cpu_cmpxchg_double_4(pcp1, pcp2, o1, o2, n1, n2)
+#endif
+
 #endif
@@ -527,6 +527,44 @@ static inline unsigned long long __cmpxchg64_mb(volatile void *ptr,
 					 (unsigned long long)(o),	\
 					 (unsigned long long)(n)))
 
+/*
+ * cmpxchg_double replaces the two adjacent words at ptr if they still
+ * hold o1 and o2, using the same ldrexd/strexd sequence. ptr must be
+ * double word aligned. Returns 1 if the exchange was done.
+ */
+static inline int __cmpxchg_double(volatile void *ptr,
+				   unsigned long o1, unsigned long o2,
+				   unsigned long n1, unsigned long n2)
+{
+	union {
+		unsigned long w[2];
+		unsigned long long dw;
+	} old = { .w = { o1, o2 } }, new = { .w = { n1, n2 } };
+
+	return __cmpxchg64(ptr, old.dw, new.dw) == old.dw;
+}
+
+#define cmpxchg_double(ptr, o1, o2, n1, n2)				\
+({									\
+	int __ret;							\
+	BUILD_BUG_ON(sizeof(*(ptr)) != sizeof(unsigned long));		\
+	smp_mb();							\
+	__ret = __cmpxchg_double((ptr), (unsigned long)(o1),		\
+				 (unsigned long)(o2),			\
+				 (unsigned long)(n1),			\
+				 (unsigned long)(n2));			\
+	smp_mb();							\
+	__ret;								\
+})
+
+#define cmpxchg_double_local(ptr, o1, o2, n1, n2)			\
+	__cmpxchg_double((ptr), (unsigned long)(o1),			\
+			 (unsigned long)(o2),				\
+			 (unsigned long)(n1),				\
+			 (unsigned long)(n2))
+
+#define system_has_cmpxchg_double()	1
+
 #else /* min ARCH = ARMv6 */
 
 #define cmpxchg64_local(ptr, o, n) __cmpxchg64_local_generic((ptr), (o), (n))
@@ -0,0 +1,160 @@
+/*
+ *  linux/arch/arm/lib/page-neon-glue.c
+ *
+ *  Use the NEON copy_page and clear_page when they are faster.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/mm.h>
+#include <linux/gfp.h>
+#include <linux/string.h>
+#include <linux/hardirq.h> /* for in_interrupt() */
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <asm/neon.h>
+#include <asm/page.h>
+
+extern void copy_page_neon(void *to, const void *from);
+extern void clear_page_neon(void *page);
+
+/* Set at boot once the NEON routines were checked and found faster */
+static int neon_copy_page __read_mostly;
+static int neon_clear_page __read_mostly;
+
+void copy_page(void *to, const void *from)
+{
+	/*
+	 * kernel_neon_begin() is not allowed from interrupt context, and
+	 * an interrupted kernel NEON user would lose its registers.
+	 */
+	if (neon_copy_page && !in_interrupt()) {
+		kernel_neon_begin();
+		copy_page_neon(to, from);
+		kernel_neon_end();
+	} else
+		__copy_page_std(to, from);
+}
+
+void clear_page(void *page)
+{
+	if (neon_clear_page && !in_interrupt()) {
+		kernel_neon_begin();
+		clear_page_neon(page);
+		kernel_neon_end();
+	} else
+		memset(page, 0, PAGE_SIZE);
+}
+EXPORT_SYMBOL(clear_page);
+
+#define NEON_PAGE_LOOPS		256
+
+static void __init neon_copy(void *to, const void *from)
+{
+	kernel_neon_begin();
+	copy_page_neon(to, from);
+	kernel_neon_end();
+}
+
+static void __init neon_clear(void *page, const void *unused)
+{
+	kernel_neon_begin();
+	clear_page_neon(page);
+	kernel_neon_end();
+}
+
+static void __init std_clear(void *page, const void *unused)
+{
+	memset(page, 0, PAGE_SIZE);
+}
+
+/*
+ * Cache hot throughput of one page operation in MB/s, in the same
+ * spirit as the xor and raid6 calibration at boot.
+ */
+static unsigned long __init page_op_speed(void (*op)(void *, const void *),
+					  void *to, const void *from)
+{
+	ktime_t start;
+	s64 ns;
+	int i;
+
+	op(to, from);
+	preempt_disable();
+	start = ktime_get();
+	for (i = 0; i < NEON_PAGE_LOOPS; i++)
+		op(to, from);
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	preempt_enable();
+
+	if (ns <= 0)
+		ns = 1;
+	return div64_u64((u64)NEON_PAGE_LOOPS * PAGE_SIZE * NSEC_PER_SEC,
+			 ns) >> 20;
+}
+
+static int __init neon_page_selftest(u32 *to, u32 *from)
+{
+	int i;
+
+	for (i = 0; i < PAGE_SIZE / sizeof(u32); i++)
+		from[i] = i * 0x9e3779b9;
+	memset(to, 0xa5, PAGE_SIZE);
+
+	neon_copy(to, from);
+	if (memcmp(to, from, PAGE_SIZE))
+		return -EIO;
+
+	neon_clear(to, NULL);
+	for (i = 0; i < PAGE_SIZE / sizeof(u32); i++)
+		if (to[i])
+			return -EIO;
+	return 0;
+}
+
+/*
+ * Runs after vfp_init() has set HWCAP_NEON: arch/arm/vfp is linked
+ * ahead of arch/arm/lib, so its late_initcall comes first.
+ */
+static int __init neon_page_ops_init(void)
+{
+	unsigned long copy_std, copy_neon, clear_std, clear_neon;
+	struct page *pages;
+	void *to, *from;
+
+	if (!cpu_has_neon())
+		return 0;
+
+	pages = alloc_pages(GFP_KERNEL, 1);
+	if (!pages)
+		return -ENOMEM;
+	to = page_address(pages);
+	from = to + PAGE_SIZE;
+
+	if (neon_page_selftest(to, from)) {
+		printk(KERN_ERR "NEON page ops: self-test failed, "
+		       "using ldm/stm\n");
+		goto out;
+	}
+
+	copy_std = page_op_speed(__copy_page_std, to, from);
+	copy_neon = page_op_speed(neon_copy, to, from);
+	clear_std = page_op_speed(std_clear, to, NULL);
+	clear_neon = page_op_speed(neon_clear, to, NULL);
+
+	printk(KERN_INFO "NEON page ops: copy_page %lu MB/s (ldm/stm %lu MB/s), "
+	       "clear_page %lu MB/s (memset %lu MB/s)\n",
+	       copy_neon, copy_std, clear_neon, clear_std);
+
+	neon_copy_page = copy_neon > copy_std;
+	neon_clear_page = clear_neon > clear_std;
+out:
+	__free_pages(pages, 1);
+	return 0;
+}
+late_initcall(neon_page_ops_init);
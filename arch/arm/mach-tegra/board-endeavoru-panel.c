@@ -2557,6 +2557,7 @@ struct tegra_dsi_out enterprise_dsi = {
 	.virtual_channel = TEGRA_DSI_VIRTUAL_CHANNEL_0,
 
 	.panel_has_frame_buffer = true,
+	.partial_update_supported = true,
 	.dsi_instance = 0,
 
 	.panel_reset = DSI_PANEL_RESET,
@@ -2819,6 +2820,7 @@ int __init enterprise_panel_init(void)
 
 	enterprise_carveouts[1].base = tegra_carveout_start;
 	enterprise_carveouts[1].size = tegra_carveout_size;
+	enterprise_carveouts[1].cma = tegra_carveout_cma;
 
 	err = gpio_request_array(panel_init_gpios, ARRAY_SIZE(panel_init_gpios));
 	if(err) {
@@ -36,6 +36,7 @@
 	}
 
 struct memory_accessor;
+struct cma;
 
 void tegra_assert_system_reset(char mode, const char *cmd);
 void get_mac_addr(struct memory_accessor *, void *);
@@ -73,6 +74,7 @@ extern unsigned long tegra_fb2_start;
 extern unsigned long tegra_fb2_size;
 extern unsigned long tegra_carveout_start;
 extern unsigned long tegra_carveout_size;
+extern struct cma *tegra_carveout_cma;
 extern unsigned long tegra_vpr_start;
 extern unsigned long tegra_vpr_size;
 extern unsigned long tegra_lp0_vec_start;
@@ -28,6 +28,7 @@
 #include <linux/memblock.h>
 #include <linux/bitops.h>
 #include <linux/sched.h>
+#include <linux/cma.h>
 
 #include <asm/hardware/cache-l2x0.h>
 #include <asm/system.h>
@@ -92,6 +93,7 @@ unsigned long tegra_fb2_start;
 unsigned long tegra_fb2_size;
 unsigned long tegra_carveout_start;
 unsigned long tegra_carveout_size;
+struct cma *tegra_carveout_cma;
 unsigned long tegra_vpr_start;
 unsigned long tegra_vpr_size;
 unsigned long tegra_lp0_vec_start;
@@ -975,6 +977,31 @@ out:
 #define SUPPORT_SMMU_BASE_FOR_TEGRA3_A01
 #endif
 
+#ifdef CONFIG_CMA
+/*
+ * The carveout stays part of the memory map as a CMA area, lent to
+ * movable pages until nvmap claims ranges of it.  It has to be placed
+ * after all the fixed reservations so that memblock keeps it clear of
+ * them; it still ends up at the top of DRAM, which is highmem on these
+ * boards, so there is no cacheable linear mapping of the carveout to
+ * alias nvmap's uncached and writecombined mappings.
+ */
+static void __init tegra_reserve_carveout_cma(unsigned long carveout_size)
+{
+	if (cma_declare_contiguous(carveout_size, 0, 0, &tegra_carveout_cma)) {
+		pr_err("Failed to reserve carveout %08lx as CMA area\n",
+			carveout_size);
+		return;
+	}
+
+	tegra_carveout_start = cma_get_base(tegra_carveout_cma);
+	tegra_carveout_size = cma_get_size(tegra_carveout_cma);
+
+	if (tegra_carveout_start < tegra_grhost_aperture)
+		tegra_grhost_aperture = tegra_carveout_start;
+}
+#endif
+
 void __init tegra_reserve(unsigned long carveout_size, unsigned long fb_size,
 	unsigned long fb2_size)
 {
@@ -983,6 +1010,7 @@ void __init tegra_reserve(unsigned long carveout_size, unsigned long fb_size,
 	struct tegra_smmu_window *smmu_window = tegra_smmu_window(0);
 #endif
 
+#ifndef CONFIG_CMA
 	if (carveout_size) {
 		tegra_carveout_start = memblock_end_of_DRAM() - carveout_size;
 		if (memblock_remove(tegra_carveout_start, carveout_size)) {
@@ -994,6 +1022,7 @@ void __init tegra_reserve(unsigned long carveout_size, unsigned long fb_size,
 		} else
 			tegra_carveout_size = carveout_size;
 	}
+#endif
 
 	if (fb2_size) {
 		tegra_fb2_start = memblock_end_of_DRAM() - fb2_size;
@@ -1091,6 +1120,11 @@ void __init tegra_reserve(unsigned long carveout_size, unsigned long fb_size,
 		}
 	}
 
+#ifdef CONFIG_CMA
+	if (carveout_size)
+		tegra_reserve_carveout_cma(carveout_size);
+#endif
+
 	pr_info("Tegra reserved memory:\n"
 		"LP0:                    %08lx - %08lx\n"
 		"Bootloader framebuffer: %08lx - %08lx\n"
@@ -174,6 +174,9 @@ struct tegra_dsi_out {
 					 * most panels. */
 	bool		te_polarity_low;
 	bool		power_saving_suspend;
+	bool		partial_update_supported; /* command mode only; panel
+						   * honours column/page
+						   * address windows */
 
 	u32		max_panel_freq_khz;
 	u32		lp_cmd_mode_freq_khz;
@@ -524,10 +527,24 @@ u32 tegra_dc_get_syncpt_id(const struct tegra_dc *dc, int i);
 u32 tegra_dc_incr_syncpt_max(struct tegra_dc *dc, int i);
 void tegra_dc_incr_syncpt_min(struct tegra_dc *dc, int i, u32 val);
 
+/* rectangle in output (panel) coordinates */
+struct tegra_dc_rect {
+	unsigned	x;
+	unsigned	y;
+	unsigned	w;
+	unsigned	h;
+};
+
 /* tegra_dc_update_windows and tegra_dc_sync_windows do not support windows
  * with differenct dcs in one call
  */
 int tegra_dc_update_windows(struct tegra_dc_win *windows[], int n);
+/* Same as tegra_dc_update_windows, but only the damaged rectangle is sent to
+ * the panel when the output supports partial updates (one-shot DSI command
+ * mode).  A NULL or empty rectangle means a full frame update.
+ */
+int tegra_dc_update_windows_region(struct tegra_dc_win *windows[], int n,
+				   const struct tegra_dc_rect *damage);
 int tegra_dc_sync_windows(struct tegra_dc_win *windows[], int n);
 
 int tegra_dc_set_mode(struct tegra_dc *dc, const struct tegra_dc_mode *mode);
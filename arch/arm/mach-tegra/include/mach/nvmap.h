@@ -138,12 +138,15 @@ int nvmap_patch_word(struct nvmap_client *client,
 		     struct nvmap_handle *patch,
 		     u32 patch_offset, u32 patch_value);
 
+struct cma;
+
 struct nvmap_platform_carveout {
 	const char *name;
 	unsigned int usage_mask;
 	phys_addr_t base;
 	size_t size;
 	size_t buddy_size;
+	struct cma *cma;	/* carveout is backed by this CMA area */
 };
 
 struct nvmap_platform_data {
@@ -38,6 +38,31 @@ static void inner_flush_cache_all(void)
 	on_each_cpu(v7_flush_kern_cache_all, NULL, 1);
 }
 
+/*
+ * Flush the outer cache for a page array, merging physically contiguous
+ * pages into a single range operation.
+ */
+static void outer_flush_pages(struct page **pages, int numpages)
+{
+	phys_addr_t start = 0, end = 0;
+	int i;
+
+	for (i = 0; i < numpages; i++) {
+		phys_addr_t base = page_to_phys(pages[i]);
+
+		if (end != start && base != end) {
+			outer_flush_range(start, end);
+			start = base;
+		} else if (end == start) {
+			start = base;
+		}
+		end = base + PAGE_SIZE;
+	}
+
+	if (end != start)
+		outer_flush_range(start, end);
+}
+
 #if defined(CONFIG_CPA)
 /*
  * The current flushing context - we pass it instead of 5 arguments:
@@ -140,14 +165,19 @@ static void cpa_flush_array(unsigned long *start, int numpages, int cache,
 {
 	unsigned int i, level;
 	bool flush_inner = true;
-	unsigned long base;
+	bool flush_tlb_each = true;
 
 	BUG_ON(irqs_disabled());
 
-	if (numpages >= FLUSH_CLEAN_BY_SET_WAY_PAGE_THRESHOLD &&
-		cache && in_flags & CPA_PAGES_ARRAY) {
-		inner_flush_cache_all();
-		flush_inner = false;
+	if (numpages >= FLUSH_CLEAN_BY_SET_WAY_PAGE_THRESHOLD) {
+		/* one broadcast TLB invalidate for the whole batch */
+		flush_tlb_all();
+		flush_tlb_each = false;
+
+		if (cache && in_flags & CPA_PAGES_ARRAY) {
+			inner_flush_cache_all();
+			flush_inner = false;
+		}
 	}
 
 	for (i = 0; i < numpages; i++) {
@@ -159,15 +189,14 @@ static void cpa_flush_array(unsigned long *start, int numpages, int cache,
 		else
 			addr = start[i];
 
-		flush_tlb_kernel_range(addr, addr + PAGE_SIZE);
+		if (flush_tlb_each)
+			flush_tlb_kernel_range(addr, addr + PAGE_SIZE);
 
 		if (cache && in_flags & CPA_PAGES_ARRAY) {
 			/* cache flush all pages including high mem pages. */
 			if (flush_inner)
 				__flush_dcache_page(
 					page_mapping(pages[i]), pages[i]);
-			base = page_to_phys(pages[i]);
-			outer_flush_range(base, base + PAGE_SIZE);
 		} else if (cache) {
 			pte = lookup_address(addr, &level);
 
@@ -182,6 +211,9 @@ static void cpa_flush_array(unsigned long *start, int numpages, int cache,
 			}
 		}
 	}
+
+	if (cache && in_flags & CPA_PAGES_ARRAY)
+		outer_flush_pages(pages, numpages);
 }
 
 /*
@@ -1030,20 +1062,14 @@ void update_page_count(int level, unsigned long pages)
 static void flush_cache(struct page **pages, int numpages)
 {
 	unsigned int i;
-	bool flush_inner = true;
-	unsigned long base;
 
-	if (numpages >= FLUSH_CLEAN_BY_SET_WAY_PAGE_THRESHOLD) {
+	if (numpages >= FLUSH_CLEAN_BY_SET_WAY_PAGE_THRESHOLD)
 		inner_flush_cache_all();
-		flush_inner = false;
-	}
-
-	for (i = 0; i < numpages; i++) {
-		if (flush_inner)
+	else
+		for (i = 0; i < numpages; i++)
 			__flush_dcache_page(page_mapping(pages[i]), pages[i]);
-		base = page_to_phys(pages[i]);
-		outer_flush_range(base, base + PAGE_SIZE);
-	}
+
+	outer_flush_pages(pages, numpages);
 }
 
 int set_pages_array_uc(struct page **pages, int addrinarray)
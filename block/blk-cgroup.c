@@ -19,6 +19,7 @@
 #include <linux/slab.h>
 #include "blk-cgroup.h"
 #include <linux/genhd.h>
+#include <linux/math64.h>
 
 #define MAX_KEY_LEN 100
 
@@ -134,6 +135,22 @@ blkio_update_group_weight(struct blkio_group *blkg, unsigned int weight)
 	}
 }
 
+static inline void
+blkio_update_group_latency_target(struct blkio_group *blkg,
+				  unsigned int latency_target)
+{
+	struct blkio_policy_type *blkiop;
+
+	list_for_each_entry(blkiop, &blkio_list, list) {
+		/* If this policy does not own the blkg, do not send updates */
+		if (blkiop->plid != blkg->plid)
+			continue;
+		if (blkiop->ops.blkio_update_group_latency_target_fn)
+			blkiop->ops.blkio_update_group_latency_target_fn(
+					blkg->key, blkg, latency_target);
+	}
+}
+
 static inline void blkio_update_group_bps(struct blkio_group *blkg, u64 bps,
 				int fileid)
 {
@@ -439,6 +456,48 @@ void blkiocg_update_completion_stats(struct blkio_group *blkg,
 }
 EXPORT_SYMBOL_GPL(blkiocg_update_completion_stats);
 
+/*
+ * Account the submission to completion latency of an IO and return true
+ * if it missed latency_target (in us). A zero target is never missed.
+ */
+bool blkiocg_update_latency_stats(struct blkio_group *blkg,
+			uint64_t start_time, unsigned int latency_target)
+{
+	struct blkio_group_stats *stats;
+	unsigned long flags;
+	unsigned long long now = sched_clock();
+	uint64_t latency;
+	bool missed;
+
+	if (!time_after64(now, start_time))
+		return false;
+
+	latency = now - start_time;
+	missed = latency_target &&
+		 latency > (uint64_t)latency_target * NSEC_PER_USEC;
+
+	spin_lock_irqsave(&blkg->stats_lock, flags);
+	stats = &blkg->stats;
+	stats->latency_sum += latency;
+	stats->latency_samples++;
+	if (missed)
+		stats->latency_missed++;
+	spin_unlock_irqrestore(&blkg->stats_lock, flags);
+
+	return missed;
+}
+EXPORT_SYMBOL_GPL(blkiocg_update_latency_stats);
+
+void blkiocg_update_latency_throttled_stats(struct blkio_group *blkg)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&blkg->stats_lock, flags);
+	blkg->stats.latency_throttled++;
+	spin_unlock_irqrestore(&blkg->stats_lock, flags);
+}
+EXPORT_SYMBOL_GPL(blkiocg_update_latency_throttled_stats);
+
 /*  Merged stats are per cpu.  */
 void blkiocg_update_io_merged_stats(struct blkio_group *blkg, bool direction,
 					bool sync)
@@ -729,6 +788,23 @@ static uint64_t blkio_get_stat(struct blkio_group *blkg,
 	if (type == BLKIO_STAT_TIME)
 		return blkio_fill_stat(key_str, MAX_KEY_LEN - 1,
 					blkg->stats.time, cb, dev);
+	if (type == BLKIO_STAT_LATENCY_AVG) {
+		uint64_t sum = blkg->stats.latency_sum;
+		uint64_t samples = blkg->stats.latency_samples;
+		if (samples) {
+			/* do_div() would truncate the 64 bit divisor */
+			sum = div64_u64(sum, samples);
+			do_div(sum, NSEC_PER_USEC);
+		} else
+			sum = 0;
+		return blkio_fill_stat(key_str, MAX_KEY_LEN - 1, sum, cb, dev);
+	}
+	if (type == BLKIO_STAT_LATENCY_MISSED)
+		return blkio_fill_stat(key_str, MAX_KEY_LEN - 1,
+					blkg->stats.latency_missed, cb, dev);
+	if (type == BLKIO_STAT_LATENCY_THROTTLED)
+		return blkio_fill_stat(key_str, MAX_KEY_LEN - 1,
+					blkg->stats.latency_throttled, cb, dev);
 #ifdef CONFIG_DEBUG_BLK_CGROUP
 	if (type == BLKIO_STAT_UNACCOUNTED_TIME)
 		return blkio_fill_stat(key_str, MAX_KEY_LEN - 1,
@@ -1253,6 +1329,15 @@ static int blkiocg_file_read_map(struct cgroup *cgrp, struct cftype *cft,
 		case BLKIO_PROP_io_queued:
 			return blkio_read_blkg_stats(blkcg, cft, cb,
 						BLKIO_STAT_QUEUED, 1, 0);
+		case BLKIO_PROP_latency_avg:
+			return blkio_read_blkg_stats(blkcg, cft, cb,
+						BLKIO_STAT_LATENCY_AVG, 0, 0);
+		case BLKIO_PROP_latency_missed:
+			return blkio_read_blkg_stats(blkcg, cft, cb,
+						BLKIO_STAT_LATENCY_MISSED, 0, 0);
+		case BLKIO_PROP_latency_throttled:
+			return blkio_read_blkg_stats(blkcg, cft, cb,
+					BLKIO_STAT_LATENCY_THROTTLED, 0, 0);
 #ifdef CONFIG_DEBUG_BLK_CGROUP
 		case BLKIO_PROP_unaccounted_time:
 			return blkio_read_blkg_stats(blkcg, cft, cb,
@@ -1322,6 +1407,25 @@ static int blkio_weight_write(struct blkio_cgroup *blkcg, u64 val)
 	return 0;
 }
 
+static int blkio_latency_target_write(struct blkio_cgroup *blkcg, u64 val)
+{
+	struct blkio_group *blkg;
+	struct hlist_node *n;
+
+	if (val > UINT_MAX)
+		return -EINVAL;
+
+	spin_lock(&blkio_list_lock);
+	spin_lock_irq(&blkcg->lock);
+	blkcg->latency_target = (unsigned int)val;
+
+	hlist_for_each_entry(blkg, n, &blkcg->blkg_list, blkcg_node)
+		blkio_update_group_latency_target(blkg, blkcg->latency_target);
+	spin_unlock_irq(&blkcg->lock);
+	spin_unlock(&blkio_list_lock);
+	return 0;
+}
+
 static u64 blkiocg_file_read_u64 (struct cgroup *cgrp, struct cftype *cft) {
 	struct blkio_cgroup *blkcg;
 	enum blkio_policy_id plid = BLKIOFILE_POLICY(cft->private);
@@ -1334,6 +1438,8 @@ static u64 blkiocg_file_read_u64 (struct cgroup *cgrp, struct cftype *cft) {
 		switch(name) {
 		case BLKIO_PROP_weight:
 			return (u64)blkcg->weight;
+		case BLKIO_PROP_latency_target:
+			return (u64)blkcg->latency_target;
 		}
 		break;
 	default:
@@ -1356,6 +1462,8 @@ blkiocg_file_write_u64(struct cgroup *cgrp, struct cftype *cft, u64 val)
 		switch(name) {
 		case BLKIO_PROP_weight:
 			return blkio_weight_write(blkcg, val);
+		case BLKIO_PROP_latency_target:
+			return blkio_latency_target_write(blkcg, val);
 		}
 		break;
 	default:
@@ -1429,6 +1537,31 @@ struct cftype blkio_files[] = {
 				BLKIO_PROP_io_queued),
 		.read_map = blkiocg_file_read_map,
 	},
+	{
+		.name = "latency_target",
+		.private = BLKIOFILE_PRIVATE(BLKIO_POLICY_PROP,
+				BLKIO_PROP_latency_target),
+		.read_u64 = blkiocg_file_read_u64,
+		.write_u64 = blkiocg_file_write_u64,
+	},
+	{
+		.name = "latency_avg",
+		.private = BLKIOFILE_PRIVATE(BLKIO_POLICY_PROP,
+				BLKIO_PROP_latency_avg),
+		.read_map = blkiocg_file_read_map,
+	},
+	{
+		.name = "latency_missed",
+		.private = BLKIOFILE_PRIVATE(BLKIO_POLICY_PROP,
+				BLKIO_PROP_latency_missed),
+		.read_map = blkiocg_file_read_map,
+	},
+	{
+		.name = "latency_throttled",
+		.private = BLKIOFILE_PRIVATE(BLKIO_POLICY_PROP,
+				BLKIO_PROP_latency_throttled),
+		.read_map = blkiocg_file_read_map,
+	},
 	{
 		.name = "reset_stats",
 		.write_u64 = blkiocg_reset_stats,
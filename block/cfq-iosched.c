@@ -33,6 +33,8 @@ static int cfq_slice_idle = HZ / 125;
 static int cfq_group_idle = HZ / 125;
 static const int cfq_target_latency = HZ * 3/10; /* 300 ms */
 static const int cfq_hist_divisor = 4;
+/* how long other groups are held back after a latency target miss */
+static const int cfq_latency_window = HZ / 10;
 
 /*
  * offset from end of service tree
@@ -181,6 +183,8 @@ struct cfq_group {
 	unsigned int weight;
 	unsigned int new_weight;
 	bool needs_update;
+	/* target completion latency in us, 0 if none */
+	unsigned int latency_target;
 
 	/* number of cfqq currently on this group */
 	int nr_cfqq;
@@ -305,6 +309,14 @@ struct cfq_data {
 
 	/* Number of groups which are on blkcg->blkg_list */
 	unsigned int nr_blkcg_linked_grps;
+
+	/*
+	 * After a group misses its latency target, groups with a looser
+	 * (or no) target than lat_target are held back until
+	 * lat_throttle_end.
+	 */
+	unsigned int lat_target;
+	unsigned long lat_throttle_end;
 };
 
 static struct cfq_group *cfq_get_next_cfqg(struct cfq_data *cfqd);
@@ -1027,6 +1039,21 @@ static void cfq_update_blkio_group_weight(void *key, struct blkio_group *blkg,
 	cfqg->needs_update = true;
 }
 
+static void cfq_update_blkio_group_latency_target(void *key,
+			struct blkio_group *blkg, unsigned int latency_target)
+{
+	cfqg_of_blkg(blkg)->latency_target = latency_target;
+}
+
+static inline bool cfqg_lat_throttled(struct cfq_data *cfqd,
+				      struct cfq_group *cfqg)
+{
+	if (!cfqd->lat_target || time_after_eq(jiffies, cfqd->lat_throttle_end))
+		return false;
+
+	return !cfqg->latency_target || cfqg->latency_target > cfqd->lat_target;
+}
+
 static void cfq_init_add_cfqg_lists(struct cfq_data *cfqd,
 			struct cfq_group *cfqg, struct blkio_cgroup *blkcg)
 {
@@ -1049,6 +1076,7 @@ static void cfq_init_add_cfqg_lists(struct cfq_data *cfqd,
 
 	cfqd->nr_blkcg_linked_grps++;
 	cfqg->weight = blkcg_get_weight(blkcg, cfqg->blkg.dev);
+	cfqg->latency_target = blkcg->latency_target;
 
 	/* Add group on cfqd list */
 	hlist_add_head(&cfqg->cfqd_node, &cfqd->cfqg_list);
@@ -1283,6 +1311,12 @@ cfq_link_cfqq_cfqg(struct cfq_queue *cfqq, struct cfq_group *cfqg) {
 static void cfq_release_cfq_groups(struct cfq_data *cfqd) {}
 static inline void cfq_put_cfqg(struct cfq_group *cfqg) {}
 
+static inline bool cfqg_lat_throttled(struct cfq_data *cfqd,
+				      struct cfq_group *cfqg)
+{
+	return false;
+}
+
 #endif /* GROUP_IOSCHED */
 
 /*
@@ -2283,6 +2317,24 @@ static struct cfq_group *cfq_get_next_cfqg(struct cfq_data *cfqd)
 		return NULL;
 	cfqg = cfq_rb_first_group(st);
 	update_min_vdisktime(st);
+
+	/*
+	 * Pass over groups held back for another group's latency target,
+	 * unless nothing else is ready to run.
+	 */
+	if (cfqg_lat_throttled(cfqd, cfqg)) {
+		struct rb_node *n;
+
+		for (n = rb_next(&cfqg->rb_node); n; n = rb_next(n)) {
+			struct cfq_group *__cfqg = rb_entry_cfqg(n);
+
+			if (!cfqg_lat_throttled(cfqd, __cfqg)) {
+				cfq_blkiocg_update_latency_throttled_stats(
+								&cfqg->blkg);
+				return __cfqg;
+			}
+		}
+	}
 	return cfqg;
 }
 
@@ -2485,6 +2537,13 @@ static bool cfq_may_dispatch(struct cfq_data *cfqd, struct cfq_queue *cfqq)
 	if (cfqd->rq_in_flight[BLK_RW_SYNC] && !cfq_cfqq_sync(cfqq))
 		return false;
 
+	/*
+	 * A group held back for another group's latency target gets a
+	 * single request in flight at a time, over all of its queues
+	 */
+	if (cfqq->cfqg->dispatched && cfqg_lat_throttled(cfqd, cfqq->cfqg))
+		return false;
+
 	max_dispatch = max_t(unsigned int, cfqd->cfq_quantum / 2, 1);
 	if (cfq_class_idle(cfqq))
 		max_dispatch = 1;
@@ -3581,6 +3640,39 @@ static bool cfq_should_wait_busy(struct cfq_data *cfqd, struct cfq_queue *cfqq)
 	return false;
 }
 
+#ifdef CONFIG_CFQ_GROUP_IOSCHED
+/*
+ * Check a completed request against its group's latency target. On a
+ * miss, hold back groups with a looser target for cfq_latency_window and
+ * take the disk away from one of them if it is being served.
+ */
+static void cfq_group_latency_check(struct cfq_data *cfqd,
+				    struct cfq_group *cfqg, struct request *rq)
+{
+	if (!cfq_blkiocg_update_latency_stats(&cfqg->blkg,
+			rq_start_time_ns(rq), cfqg->latency_target))
+		return;
+
+	if (!cfqd->lat_target ||
+	    time_after_eq(jiffies, cfqd->lat_throttle_end) ||
+	    cfqg->latency_target <= cfqd->lat_target) {
+		cfqd->lat_target = cfqg->latency_target;
+		cfqd->lat_throttle_end = jiffies + cfq_latency_window;
+	}
+	cfq_log_cfqg(cfqd, cfqg, "latency target %uus missed",
+		     cfqg->latency_target);
+
+	if (cfqd->active_queue &&
+	    cfqg_lat_throttled(cfqd, cfqd->active_queue->cfqg)) {
+		cfq_slice_expired(cfqd, 0);
+		cfq_schedule_dispatch(cfqd);
+	}
+}
+#else
+static inline void cfq_group_latency_check(struct cfq_data *cfqd,
+				struct cfq_group *cfqg, struct request *rq) {}
+#endif
+
 static void cfq_completed_request(struct request_queue *q, struct request *rq)
 {
 	struct cfq_queue *cfqq = RQ_CFQQ(rq);
@@ -3602,6 +3694,7 @@ static void cfq_completed_request(struct request_queue *q, struct request *rq)
 	cfq_blkiocg_update_completion_stats(&cfqq->cfqg->blkg,
 			rq_start_time_ns(rq), rq_io_start_time_ns(rq),
 			rq_data_dir(rq), rq_is_sync(rq));
+	cfq_group_latency_check(cfqd, cfqq->cfqg, rq);
 
 	cfqd->rq_in_flight[cfq_cfqq_sync(cfqq)]--;
 
@@ -4040,6 +4133,7 @@ static void *cfq_init_queue(struct request_queue *q)
 	 * throtl_data goes away.
 	 */
 	cfqg->ref = 2;
+	cfqg->latency_target = blkio_root_cgroup.latency_target;
 
 	if (blkio_alloc_blkg_stats(&cfqg->blkg)) {
 		kfree(cfqg);
@@ -4259,6 +4353,8 @@ static struct blkio_policy_type blkio_policy_cfq = {
 	.ops = {
 		.blkio_unlink_group_fn =	cfq_unlink_blkio_group,
 		.blkio_update_group_weight_fn =	cfq_update_blkio_group_weight,
+		.blkio_update_group_latency_target_fn =
+					cfq_update_blkio_group_latency_target,
 	},
 	.plid = BLKIO_POLICY_PROP,
 };
@@ -67,6 +67,18 @@ static inline void cfq_blkiocg_update_completion_stats(struct blkio_group *blkg,
 				direction, sync);
 }
 
+static inline bool cfq_blkiocg_update_latency_stats(struct blkio_group *blkg,
+			uint64_t start_time, unsigned int latency_target)
+{
+	return blkiocg_update_latency_stats(blkg, start_time, latency_target);
+}
+
+static inline void
+cfq_blkiocg_update_latency_throttled_stats(struct blkio_group *blkg)
+{
+	blkiocg_update_latency_throttled_stats(blkg);
+}
+
 static inline void cfq_blkiocg_add_blkio_group(struct blkio_cgroup *blkcg,
 			struct blkio_group *blkg, void *key, dev_t dev) {
 	blkiocg_add_blkio_group(blkcg, blkg, key, dev, BLKIO_POLICY_PROP);
@@ -104,6 +116,14 @@ static inline void cfq_blkiocg_update_dispatch_stats(struct blkio_group *blkg,
 				uint64_t bytes, bool direction, bool sync) {}
 static inline void cfq_blkiocg_update_completion_stats(struct blkio_group *blkg, uint64_t start_time, uint64_t io_start_time, bool direction, bool sync) {}
 
+static inline bool cfq_blkiocg_update_latency_stats(struct blkio_group *blkg,
+			uint64_t start_time, unsigned int latency_target)
+{
+	return false;
+}
+static inline void
+cfq_blkiocg_update_latency_throttled_stats(struct blkio_group *blkg) {}
+
 static inline void cfq_blkiocg_add_blkio_group(struct blkio_cgroup *blkcg,
 			struct blkio_group *blkg, void *key, dev_t dev) {}
 static inline int cfq_blkiocg_del_blkio_group(struct blkio_group *blkg)
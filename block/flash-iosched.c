@@ -0,0 +1,358 @@
+/*
+ *  Flash i/o scheduler.
+ *
+ *  A deadline variant for devices without a seek penalty (eMMC, SD,
+ *  SSDs).  Requests are kept in arrival order in three FIFOs: reads,
+ *  synchronous writes and asynchronous (writeback) writes.  There is no
+ *  sector sorting and no idling; the only decisions are which FIFO to
+ *  serve next and for how many requests.
+ *
+ *  Based on the deadline i/o scheduler, Copyright (C) 2002 Jens Axboe.
+ */
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/blkdev.h>
+#include <linux/elevator.h>
+#include <linux/bio.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/init.h>
+
+/*
+ * See Documentation/block/flash-iosched.txt
+ */
+static const int read_expire = HZ / 4;		/* max time before a read is submitted */
+static const int sync_write_expire = HZ / 2;	/* ditto for sync writes */
+static const int async_write_expire = 5 * HZ;	/* ditto for writeback, these limits are SOFT! */
+static const int writes_starved = 2;		/* max times reads can starve sync writes */
+static const int async_starved = 4;		/* max times sync i/o can starve writeback */
+static const int read_batch = 16;		/* # of requests dispatched in a row */
+static const int sync_write_batch = 8;
+static const int async_write_batch = 4;
+
+enum flash_queue {
+	FLASH_READ = 0,
+	FLASH_SYNC_WRITE,
+	FLASH_ASYNC_WRITE,
+	FLASH_NR_QUEUES,
+};
+
+struct flash_data {
+	/*
+	 * run time data
+	 */
+	struct list_head fifo_list[FLASH_NR_QUEUES];
+
+	int batch_queue;		/* queue of the current batch, or -1 */
+	unsigned int batching;		/* requests dispatched in this batch */
+	unsigned int starved[FLASH_NR_QUEUES];	/* times passed over */
+
+	/*
+	 * settings that change how the i/o scheduler behaves
+	 */
+	int fifo_expire[FLASH_NR_QUEUES];
+	int fifo_batch[FLASH_NR_QUEUES];
+	int writes_starved;
+	int async_starved;
+};
+
+static inline enum flash_queue flash_rq_queue(struct request *rq)
+{
+	if (rq_data_dir(rq) == READ)
+		return FLASH_READ;
+
+	return rq_is_sync(rq) ? FLASH_SYNC_WRITE : FLASH_ASYNC_WRITE;
+}
+
+/*
+ * add rq to the tail of its fifo
+ */
+static void
+flash_add_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	const enum flash_queue fq = flash_rq_queue(rq);
+
+	rq_set_fifo_time(rq, jiffies + fd->fifo_expire[fq]);
+	list_add_tail(&rq->queuelist, &fd->fifo_list[fq]);
+}
+
+/*
+ * Don't let a sync bio get stuck behind writeback by merging into an
+ * async request; it would inherit that request's much later deadline.
+ */
+static int flash_allow_merge(struct request_queue *q, struct request *rq,
+			     struct bio *bio)
+{
+	if (bio_data_dir(bio) == READ)
+		return 1;
+
+	return !!(bio->bi_rw & REQ_SYNC) == rq_is_sync(rq);
+}
+
+static void
+flash_merged_requests(struct request_queue *q, struct request *req,
+		      struct request *next)
+{
+	/*
+	 * if next expires before rq, assign its expire time to rq
+	 * and move into next position (next will be deleted) in fifo,
+	 * as long as that fifo is rq's own
+	 */
+	if (!list_empty(&req->queuelist) && !list_empty(&next->queuelist) &&
+	    flash_rq_queue(req) == flash_rq_queue(next)) {
+		if (time_before(rq_fifo_time(next), rq_fifo_time(req))) {
+			list_move(&req->queuelist, &next->queuelist);
+			rq_set_fifo_time(req, rq_fifo_time(next));
+		}
+	}
+
+	/*
+	 * kill knowledge of next, this one is a goner
+	 */
+	rq_fifo_clear(next);
+}
+
+/*
+ * flash_check_fifo returns 1 if the oldest request on the fifo has
+ * expired. Requires !list_empty(&fd->fifo_list[fq])
+ */
+static inline int flash_check_fifo(struct flash_data *fd, int fq)
+{
+	struct request *rq = rq_entry_fifo(fd->fifo_list[fq].next);
+
+	return time_after(jiffies, rq_fifo_time(rq));
+}
+
+/*
+ * Pick the fifo to start a new batch from: expired requests first,
+ * then any class that has been passed over too often, then plain
+ * priority order.
+ */
+static int flash_choose_queue(struct flash_data *fd)
+{
+	int fq;
+
+	for (fq = 0; fq < FLASH_NR_QUEUES; fq++)
+		if (!list_empty(&fd->fifo_list[fq]) && flash_check_fifo(fd, fq))
+			return fq;
+
+	if (!list_empty(&fd->fifo_list[FLASH_ASYNC_WRITE]) &&
+	    fd->starved[FLASH_ASYNC_WRITE] >= fd->async_starved)
+		return FLASH_ASYNC_WRITE;
+
+	if (!list_empty(&fd->fifo_list[FLASH_SYNC_WRITE]) &&
+	    fd->starved[FLASH_SYNC_WRITE] >= fd->writes_starved)
+		return FLASH_SYNC_WRITE;
+
+	for (fq = 0; fq < FLASH_NR_QUEUES; fq++)
+		if (!list_empty(&fd->fifo_list[fq]))
+			return fq;
+
+	return -1;
+}
+
+static int flash_dispatch_requests(struct request_queue *q, int force)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	struct request *rq;
+	int fq = fd->batch_queue;
+	int i;
+
+	if (fq < 0 || fd->batching >= fd->fifo_batch[fq] ||
+	    list_empty(&fd->fifo_list[fq])) {
+		fq = flash_choose_queue(fd);
+		if (fq < 0) {
+			fd->batch_queue = -1;
+			return 0;
+		}
+
+		/* classes behind the chosen one that had work were starved */
+		for (i = fq + 1; i < FLASH_NR_QUEUES; i++)
+			if (!list_empty(&fd->fifo_list[i]))
+				fd->starved[i]++;
+		fd->starved[fq] = 0;
+
+		fd->batch_queue = fq;
+		fd->batching = 0;
+	}
+
+	rq = rq_entry_fifo(fd->fifo_list[fq].next);
+	rq_fifo_clear(rq);
+	elv_dispatch_add_tail(q, rq);
+	fd->batching++;
+
+	return 1;
+}
+
+static struct request *
+flash_former_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	if (rq->queuelist.prev == &fd->fifo_list[flash_rq_queue(rq)])
+		return NULL;
+	return rq_entry_fifo(rq->queuelist.prev);
+}
+
+static struct request *
+flash_latter_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	if (rq->queuelist.next == &fd->fifo_list[flash_rq_queue(rq)])
+		return NULL;
+	return rq_entry_fifo(rq->queuelist.next);
+}
+
+static void flash_exit_queue(struct elevator_queue *e)
+{
+	struct flash_data *fd = e->elevator_data;
+	int fq;
+
+	for (fq = 0; fq < FLASH_NR_QUEUES; fq++)
+		BUG_ON(!list_empty(&fd->fifo_list[fq]));
+
+	kfree(fd);
+}
+
+/*
+ * initialize elevator private data (flash_data).
+ */
+static void *flash_init_queue(struct request_queue *q)
+{
+	struct flash_data *fd;
+	int fq;
+
+	fd = kmalloc_node(sizeof(*fd), GFP_KERNEL | __GFP_ZERO, q->node);
+	if (!fd)
+		return NULL;
+
+	for (fq = 0; fq < FLASH_NR_QUEUES; fq++)
+		INIT_LIST_HEAD(&fd->fifo_list[fq]);
+	fd->batch_queue = -1;
+	fd->fifo_expire[FLASH_READ] = read_expire;
+	fd->fifo_expire[FLASH_SYNC_WRITE] = sync_write_expire;
+	fd->fifo_expire[FLASH_ASYNC_WRITE] = async_write_expire;
+	fd->fifo_batch[FLASH_READ] = read_batch;
+	fd->fifo_batch[FLASH_SYNC_WRITE] = sync_write_batch;
+	fd->fifo_batch[FLASH_ASYNC_WRITE] = async_write_batch;
+	fd->writes_starved = writes_starved;
+	fd->async_starved = async_starved;
+	return fd;
+}
+
+/*
+ * sysfs parts below
+ */
+
+static ssize_t
+flash_var_show(int var, char *page)
+{
+	return sprintf(page, "%d\n", var);
+}
+
+static ssize_t
+flash_var_store(int *var, const char *page, size_t count)
+{
+	char *p = (char *) page;
+
+	*var = simple_strtol(p, &p, 10);
+	return count;
+}
+
+#define SHOW_FUNCTION(__FUNC, __VAR, __CONV)				\
+static ssize_t __FUNC(struct elevator_queue *e, char *page)		\
+{									\
+	struct flash_data *fd = e->elevator_data;			\
+	int __data = __VAR;						\
+	if (__CONV)							\
+		__data = jiffies_to_msecs(__data);			\
+	return flash_var_show(__data, (page));				\
+}
+SHOW_FUNCTION(flash_read_expire_show, fd->fifo_expire[FLASH_READ], 1);
+SHOW_FUNCTION(flash_sync_write_expire_show, fd->fifo_expire[FLASH_SYNC_WRITE], 1);
+SHOW_FUNCTION(flash_async_write_expire_show, fd->fifo_expire[FLASH_ASYNC_WRITE], 1);
+SHOW_FUNCTION(flash_read_batch_show, fd->fifo_batch[FLASH_READ], 0);
+SHOW_FUNCTION(flash_sync_write_batch_show, fd->fifo_batch[FLASH_SYNC_WRITE], 0);
+SHOW_FUNCTION(flash_async_write_batch_show, fd->fifo_batch[FLASH_ASYNC_WRITE], 0);
+SHOW_FUNCTION(flash_writes_starved_show, fd->writes_starved, 0);
+SHOW_FUNCTION(flash_async_starved_show, fd->async_starved, 0);
+#undef SHOW_FUNCTION
+
+#define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
+static ssize_t __FUNC(struct elevator_queue *e, const char *page, size_t count)	\
+{									\
+	struct flash_data *fd = e->elevator_data;			\
+	int __data;							\
+	int ret = flash_var_store(&__data, (page), count);		\
+	if (__data < (MIN))						\
+		__data = (MIN);						\
+	else if (__data > (MAX))					\
+		__data = (MAX);						\
+	if (__CONV)							\
+		*(__PTR) = msecs_to_jiffies(__data);			\
+	else								\
+		*(__PTR) = __data;					\
+	return ret;							\
+}
+STORE_FUNCTION(flash_read_expire_store, &fd->fifo_expire[FLASH_READ], 0, INT_MAX, 1);
+STORE_FUNCTION(flash_sync_write_expire_store, &fd->fifo_expire[FLASH_SYNC_WRITE], 0, INT_MAX, 1);
+STORE_FUNCTION(flash_async_write_expire_store, &fd->fifo_expire[FLASH_ASYNC_WRITE], 0, INT_MAX, 1);
+STORE_FUNCTION(flash_read_batch_store, &fd->fifo_batch[FLASH_READ], 1, INT_MAX, 0);
+STORE_FUNCTION(flash_sync_write_batch_store, &fd->fifo_batch[FLASH_SYNC_WRITE], 1, INT_MAX, 0);
+STORE_FUNCTION(flash_async_write_batch_store, &fd->fifo_batch[FLASH_ASYNC_WRITE], 1, INT_MAX, 0);
+STORE_FUNCTION(flash_writes_starved_store, &fd->writes_starved, 0, INT_MAX, 0);
+STORE_FUNCTION(flash_async_starved_store, &fd->async_starved, 0, INT_MAX, 0);
+#undef STORE_FUNCTION
+
+#define FD_ATTR(name) \
+	__ATTR(name, S_IRUGO|S_IWUSR, flash_##name##_show, \
+				      flash_##name##_store)
+
+static struct elv_fs_entry flash_attrs[] = {
+	FD_ATTR(read_expire),
+	FD_ATTR(sync_write_expire),
+	FD_ATTR(async_write_expire),
+	FD_ATTR(read_batch),
+	FD_ATTR(sync_write_batch),
+	FD_ATTR(async_write_batch),
+	FD_ATTR(writes_starved),
+	FD_ATTR(async_starved),
+	__ATTR_NULL
+};
+
+static struct elevator_type iosched_flash = {
+	.ops = {
+		.elevator_allow_merge_fn =	flash_allow_merge,
+		.elevator_merge_req_fn =	flash_merged_requests,
+		.elevator_dispatch_fn =		flash_dispatch_requests,
+		.elevator_add_req_fn =		flash_add_request,
+		.elevator_former_req_fn =	flash_former_request,
+		.elevator_latter_req_fn =	flash_latter_request,
+		.elevator_init_fn =		flash_init_queue,
+		.elevator_exit_fn =		flash_exit_queue,
+	},
+
+	.elevator_attrs = flash_attrs,
+	.elevator_name = "flash",
+	.elevator_owner = THIS_MODULE,
+};
+
+static int __init flash_init(void)
+{
+	elv_register(&iosched_flash);
+
+	return 0;
+}
+
+static void __exit flash_exit(void)
+{
+	elv_unregister(&iosched_flash);
+}
+
+module_init(flash_init);
+module_exit(flash_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Flash IO scheduler");
@@ -34,6 +34,8 @@
 #include <linux/interrupt.h>
 #include <linux/types.h>
 #include <linux/errno.h>
+#include <linux/debugfs.h>
+#include <linux/ktime.h>
 #include <crypto/scatterwalk.h>
 #include <crypto/algapi.h>
 #include <crypto/aes.h>
@@ -94,6 +96,12 @@ struct tegra_se_dev {
 	dma_addr_t ctx_save_buf_adr;	/* LP context buffer dma address*/
 	struct completion complete;	/* Tells the task completion */
 	bool work_q_busy;	/* Work queue busy status */
+	u32 cpu_crossover;	/* Shorter cbc/ecb requests run on the CPU */
+	u64 cpu_reqs;	/* Requests done by the CPU fallback */
+	u64 cpu_bytes;	/* Bytes done by the CPU fallback */
+	u64 hw_reqs;	/* Requests queued to the engine */
+	u64 hw_bytes;	/* Bytes queued to the engine */
+	struct dentry *debugfs_root;	/* Dispatch statistics */
 };
 
 static struct tegra_se_dev *sg_tegra_se_dev;
@@ -104,6 +112,7 @@ struct tegra_se_aes_context {
 	struct tegra_se_slot *slot;	/* Security Engine key slot */
 	u32 keylen;	/* key length in bits */
 	u32 op_mode;	/* AES operation mode */
+	struct crypto_blkcipher *fallback;	/* CPU version for short requests */
 };
 
 /* Security Engine random number generator context */
@@ -168,6 +177,10 @@ static void tegra_se_work_handler(struct work_struct *work);
 static DECLARE_WORK(se_work, tegra_se_work_handler);
 static struct workqueue_struct *se_work_q;
 
+/* measures where the engine starts to beat the CPU, see below */
+static void tegra_se_calibrate(struct work_struct *work);
+static DECLARE_WORK(se_calib_work, tegra_se_calibrate);
+
 #define PMC_SCRATCH43_REG_OFFSET 0x22c
 #define GET_MSB(x)  ((x) >> (8*sizeof(x)-1))
 static void tegra_se_leftshift_onebit(u8 *in_buf, u32 size, u8 *org_msb)
@@ -839,9 +852,47 @@ static void tegra_se_work_handler(struct work_struct *work)
 	pm_runtime_put(se_dev->dev);
 }
 
+/*
+ * Every engine request pays for the queue, the work item, the key slot and
+ * IV setup, the linked list DMA and the interrupt.  That is more than the
+ * CPU needs to do a 512 byte dm-crypt sector itself, so requests shorter
+ * than se_dev->cpu_crossover are done synchronously by the CPU fallback,
+ * and longer ones are queued, where the work handler drains them back to
+ * back.  Returning the result directly is allowed for an async cipher:
+ * the completion callback is only used after -EINPROGRESS or -EBUSY.
+ */
+static int tegra_se_aes_cpu_crypt(struct tegra_se_dev *se_dev,
+	struct tegra_se_aes_context *aes_ctx, struct ablkcipher_request *req)
+{
+	struct tegra_se_req_context *req_ctx = ablkcipher_request_ctx(req);
+	struct blkcipher_desc desc = {
+		.tfm = aes_ctx->fallback,
+		.info = req->info,
+		.flags = req->base.flags & CRYPTO_TFM_REQ_MAY_SLEEP,
+	};
+	unsigned long flags;
+	int ret;
+
+	if (req_ctx->encrypt)
+		ret = crypto_blkcipher_encrypt_iv(&desc, req->dst, req->src,
+			req->nbytes);
+	else
+		ret = crypto_blkcipher_decrypt_iv(&desc, req->dst, req->src,
+			req->nbytes);
+
+	spin_lock_irqsave(&se_dev->lock, flags);
+	se_dev->cpu_reqs++;
+	se_dev->cpu_bytes += req->nbytes;
+	spin_unlock_irqrestore(&se_dev->lock, flags);
+
+	return ret;
+}
+
 static int tegra_se_aes_queue_req(struct ablkcipher_request *req)
 {
 	struct tegra_se_dev *se_dev = sg_tegra_se_dev;
+	struct tegra_se_aes_context *aes_ctx =
+		crypto_ablkcipher_ctx(crypto_ablkcipher_reqtfm(req));
 	unsigned long flags;
 	bool idle = true;
 	int err = 0;
@@ -849,7 +900,14 @@ static int tegra_se_aes_queue_req(struct ablkcipher_request *req)
 	if (!req->nbytes)
 		return -EINVAL;
 
+	/* the SSK never leaves the engine */
+	if (aes_ctx->fallback && aes_ctx->slot != &ssk_slot &&
+	    req->nbytes < se_dev->cpu_crossover)
+		return tegra_se_aes_cpu_crypt(se_dev, aes_ctx, req);
+
 	spin_lock_irqsave(&se_dev->lock, flags);
+	se_dev->hw_reqs++;
+	se_dev->hw_bytes += req->nbytes;
 	err = ablkcipher_enqueue_request(&se_dev->queue, req);
 	if (se_dev->work_q_busy)
 		idle = false;
@@ -976,6 +1034,15 @@ static int tegra_se_aes_setkey(struct crypto_ablkcipher *tfm,
 			ctx->slot = pslot;
 		}
 		ctx->keylen = keylen;
+
+		if (ctx->fallback) {
+			int ret;
+
+			ret = crypto_blkcipher_setkey(ctx->fallback, key,
+				keylen);
+			if (ret)
+				return ret;
+		}
 	} else {
 		tegra_se_free_key_slot(ctx->slot);
 		ctx->slot = &ssk_slot;
@@ -1014,6 +1081,39 @@ static void tegra_se_aes_cra_exit(struct crypto_tfm *tfm)
 	ctx->slot = NULL;
 }
 
+/*
+ * cbc and ecb also get a synchronous CPU implementation of the same mode
+ * for short requests.  ctr and ofb stay on the engine: there is no
+ * generic ofb, and the engine's counter increment is only known to match
+ * the ctr template's on the test vectors.
+ */
+static int tegra_se_aes_fallback_init(struct crypto_tfm *tfm)
+{
+	struct tegra_se_aes_context *ctx = crypto_tfm_ctx(tfm);
+	const char *name = crypto_tfm_alg_name(tfm);
+
+	ctx->fallback = crypto_alloc_blkcipher(name, 0,
+		CRYPTO_ALG_ASYNC | CRYPTO_ALG_NEED_FALLBACK);
+	if (IS_ERR(ctx->fallback)) {
+		/* not fatal, everything just goes to the engine */
+		pr_debug("tegra-se: no CPU fallback for %s (%ld)\n", name,
+			PTR_ERR(ctx->fallback));
+		ctx->fallback = NULL;
+	}
+
+	return tegra_se_aes_cra_init(tfm);
+}
+
+static void tegra_se_aes_fallback_exit(struct crypto_tfm *tfm)
+{
+	struct tegra_se_aes_context *ctx = crypto_tfm_ctx(tfm);
+
+	if (ctx->fallback)
+		crypto_free_blkcipher(ctx->fallback);
+	ctx->fallback = NULL;
+	tegra_se_aes_cra_exit(tfm);
+}
+
 static int tegra_se_rng_init(struct crypto_tfm *tfm)
 {
 	struct tegra_se_rng_context *rng_ctx = crypto_tfm_ctx(tfm);
@@ -1636,8 +1736,8 @@ static struct crypto_alg aes_algs[] = {
 		.cra_alignmask = 0,
 		.cra_type = &crypto_ablkcipher_type,
 		.cra_module = THIS_MODULE,
-		.cra_init = tegra_se_aes_cra_init,
-		.cra_exit = tegra_se_aes_cra_exit,
+		.cra_init = tegra_se_aes_fallback_init,
+		.cra_exit = tegra_se_aes_fallback_exit,
 		.cra_u.ablkcipher = {
 			.min_keysize = TEGRA_SE_AES_MIN_KEY_SIZE,
 			.max_keysize = TEGRA_SE_AES_MAX_KEY_SIZE,
@@ -1656,8 +1756,8 @@ static struct crypto_alg aes_algs[] = {
 		.cra_alignmask = 0,
 		.cra_type = &crypto_ablkcipher_type,
 		.cra_module = THIS_MODULE,
-		.cra_init = tegra_se_aes_cra_init,
-		.cra_exit = tegra_se_aes_cra_exit,
+		.cra_init = tegra_se_aes_fallback_init,
+		.cra_exit = tegra_se_aes_fallback_exit,
 		.cra_u.ablkcipher = {
 			.min_keysize = TEGRA_SE_AES_MIN_KEY_SIZE,
 			.max_keysize = TEGRA_SE_AES_MAX_KEY_SIZE,
@@ -1847,6 +1947,175 @@ static struct ahash_alg hash_algs[] = {
 	}
 };
 
+/*
+ * Boot time probe in the style of tcrypt's cipher speed test: time
+ * cbc(aes) encryption of growing buffers on the engine, through the whole
+ * queue, work and interrupt path, and on the CPU fallback.  The first
+ * size at which the engine wins becomes the crossover; until this has
+ * run, cpu_crossover is 0 and everything goes to the engine.  It can be
+ * overridden in debugfs.
+ */
+#define SE_CALIB_MIN_SIZE	64
+#define SE_CALIB_MAX_SIZE	8192
+#define SE_CALIB_LOOPS		32
+
+struct tegra_se_calib_result {
+	struct completion completion;
+	int err;
+};
+
+static void tegra_se_calib_complete(struct crypto_async_request *req, int err)
+{
+	struct tegra_se_calib_result *res = req->data;
+
+	if (err == -EINPROGRESS)
+		return;
+
+	res->err = err;
+	complete(&res->completion);
+}
+
+static int tegra_se_calib_hw_op(struct ablkcipher_request *req)
+{
+	struct tegra_se_calib_result *res = req->base.data;
+	int ret;
+
+	ret = crypto_ablkcipher_encrypt(req);
+	if (ret == -EINPROGRESS || ret == -EBUSY) {
+		wait_for_completion(&res->completion);
+		INIT_COMPLETION(res->completion);
+		ret = res->err;
+	}
+	return ret;
+}
+
+/* engine if req is set, CPU fallback otherwise */
+static int tegra_se_calib_op(struct ablkcipher_request *req,
+	struct blkcipher_desc *desc, struct scatterlist *sg, unsigned int len)
+{
+	if (req)
+		return tegra_se_calib_hw_op(req);
+	return crypto_blkcipher_encrypt_iv(desc, sg, sg, len);
+}
+
+/* average ns per request, or a negative error */
+static s64 tegra_se_calib_time(struct ablkcipher_request *req,
+	struct blkcipher_desc *desc, struct scatterlist *sg, unsigned int len)
+{
+	ktime_t start;
+	int i, ret;
+
+	/* one untimed request first, to wake up clocks and warm the caches */
+	ret = tegra_se_calib_op(req, desc, sg, len);
+	if (ret)
+		return ret;
+
+	start = ktime_get();
+	for (i = 0; i < SE_CALIB_LOOPS; i++) {
+		ret = tegra_se_calib_op(req, desc, sg, len);
+		if (ret)
+			return ret;
+	}
+
+	return div_s64(ktime_to_ns(ktime_sub(ktime_get(), start)),
+		SE_CALIB_LOOPS);
+}
+
+static void tegra_se_calibrate(struct work_struct *work)
+{
+	static const u8 key[AES_KEYSIZE_128] = "tegra-se-calib!";
+	struct tegra_se_dev *se_dev = sg_tegra_se_dev;
+	struct tegra_se_calib_result res;
+	struct ablkcipher_request *req = NULL;
+	struct crypto_ablkcipher *hw;
+	struct crypto_blkcipher *sw;
+	struct blkcipher_desc desc;
+	struct scatterlist sg;
+	u8 iv[TEGRA_SE_AES_IV_SIZE];
+	unsigned int len, crossover = SE_CALIB_MAX_SIZE;
+	s64 hw_ns, sw_ns;
+	void *buf;
+
+	buf = kzalloc(SE_CALIB_MAX_SIZE, GFP_KERNEL);
+	if (!buf)
+		return;
+
+	hw = crypto_alloc_ablkcipher("cbc-aes-tegra", 0, 0);
+	if (IS_ERR(hw))
+		goto out_buf;
+
+	sw = crypto_alloc_blkcipher("cbc(aes)", 0, CRYPTO_ALG_ASYNC);
+	if (IS_ERR(sw))
+		goto out_hw;
+
+	if (crypto_ablkcipher_setkey(hw, key, sizeof(key)) ||
+	    crypto_blkcipher_setkey(sw, key, sizeof(key)))
+		goto out_sw;
+
+	req = ablkcipher_request_alloc(hw, GFP_KERNEL);
+	if (!req)
+		goto out_sw;
+
+	init_completion(&res.completion);
+	ablkcipher_request_set_callback(req, CRYPTO_TFM_REQ_MAY_BACKLOG,
+		tegra_se_calib_complete, &res);
+	desc.tfm = sw;
+	desc.info = iv;
+	desc.flags = 0;
+	memset(iv, 0, sizeof(iv));
+
+	for (len = SE_CALIB_MIN_SIZE; len <= SE_CALIB_MAX_SIZE; len <<= 1) {
+		sg_init_one(&sg, buf, len);
+		ablkcipher_request_set_crypt(req, &sg, &sg, len, iv);
+
+		hw_ns = tegra_se_calib_time(req, NULL, &sg, len);
+		sw_ns = tegra_se_calib_time(NULL, &desc, &sg, len);
+		if (hw_ns < 0 || sw_ns < 0) {
+			dev_err(se_dev->dev, "calibration failed at %u bytes\n",
+				len);
+			goto out_req;
+		}
+
+		dev_dbg(se_dev->dev, "%u bytes: engine %lld ns, %s %lld ns\n",
+			len, hw_ns, crypto_tfm_alg_driver_name(
+			crypto_blkcipher_tfm(sw)), sw_ns);
+		if (hw_ns < sw_ns) {
+			crossover = len;
+			break;
+		}
+	}
+
+	se_dev->cpu_crossover = crossover;
+	dev_info(se_dev->dev, "cbc/ecb(aes) requests below %u bytes run on %s\n",
+		crossover, crypto_tfm_alg_driver_name(crypto_blkcipher_tfm(sw)));
+
+out_req:
+	ablkcipher_request_free(req);
+out_sw:
+	crypto_free_blkcipher(sw);
+out_hw:
+	crypto_free_ablkcipher(hw);
+out_buf:
+	kfree(buf);
+}
+
+static void tegra_se_debugfs_init(struct tegra_se_dev *se_dev)
+{
+	struct dentry *root;
+
+	root = debugfs_create_dir(DRIVER_NAME, NULL);
+	if (IS_ERR_OR_NULL(root))
+		return;
+
+	debugfs_create_u32("cpu_crossover", S_IRUGO | S_IWUSR, root,
+		&se_dev->cpu_crossover);
+	debugfs_create_u64("cpu_requests", S_IRUGO, root, &se_dev->cpu_reqs);
+	debugfs_create_u64("cpu_bytes", S_IRUGO, root, &se_dev->cpu_bytes);
+	debugfs_create_u64("hw_requests", S_IRUGO, root, &se_dev->hw_reqs);
+	debugfs_create_u64("hw_bytes", S_IRUGO, root, &se_dev->hw_bytes);
+	se_dev->debugfs_root = root;
+}
+
 static int tegra_se_probe(struct platform_device *pdev)
 {
 	struct tegra_se_dev *se_dev = NULL;
@@ -1974,6 +2243,9 @@ static int tegra_se_probe(struct platform_device *pdev)
 	}
 #endif
 
+	tegra_se_debugfs_init(se_dev);
+	schedule_work(&se_calib_work);
+
 	dev_info(se_dev->dev, "%s: complete", __func__);
 	return 0;
 
@@ -2016,6 +2288,8 @@ static int __devexit tegra_se_remove(struct platform_device *pdev)
 	if (!se_dev)
 		return -ENODEV;
 
+	cancel_work_sync(&se_calib_work);
+	debugfs_remove_recursive(se_dev->debugfs_root);
 	pm_runtime_disable(se_dev->dev);
 
 	cancel_work_sync(&se_work);
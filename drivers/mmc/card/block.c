@@ -61,6 +61,11 @@ MODULE_ALIAS("mmc:block");
 
 #define MMC_CMD_RETRIES 	10
 
+#define MMC_PACKED_CMD_VER	0x01
+#define MMC_PACKED_CMD_WR	0x02
+#define MMC_CMD23_ARG_PACKED	(1 << 30)
+#define MMC_PACKED_MAX_ERRORS	5	/* then give up on packing */
+
 static DEFINE_MUTEX(block_mutex);
 
 /*
@@ -104,6 +109,7 @@ struct mmc_blk_data {
 	 */
 	unsigned int	part_curr;
 	struct device_attribute force_ro;
+	struct device_attribute packed_stats;
 };
 
 static DEFINE_MUTEX(open_lock);
@@ -190,6 +196,39 @@ out:
 	return ret;
 }
 
+static const char *packed_stop_names[MMC_PACKED_STOP_MAX] = {
+	[MMC_PACKED_STOP_EMPTY]	= "empty",
+	[MMC_PACKED_STOP_DEPTH]	= "depth",
+	[MMC_PACKED_STOP_SIZE]	= "size",
+	[MMC_PACKED_STOP_TYPE]	= "type",
+};
+
+static ssize_t packed_stats_show(struct device *dev,
+				 struct device_attribute *attr, char *buf)
+{
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+	struct mmc_packed_stats *stats = &md->queue.packed_stats;
+	int i, len;
+
+	len = snprintf(buf, PAGE_SIZE,
+		       "max_depth: %u\npacked: %lu\nfailed: %lu\n"
+		       "fallback: %lu\ndepth:",
+		       md->queue.packed_max, stats->packed, stats->failed,
+		       stats->fallback);
+	/* depth[0] is never used, a packing attempt has at least one entry */
+	for (i = 1; i < MMC_PACKED_DEPTH_BUCKETS; i++)
+		len += snprintf(buf + len, PAGE_SIZE - len, " %lu",
+				stats->depth[i]);
+	len += snprintf(buf + len, PAGE_SIZE - len, "\nstop:");
+	for (i = 0; i < MMC_PACKED_STOP_MAX; i++)
+		len += snprintf(buf + len, PAGE_SIZE - len, " %s=%lu",
+				packed_stop_names[i], stats->stop[i]);
+	len += snprintf(buf + len, PAGE_SIZE - len, "\n");
+
+	mmc_blk_put(md);
+	return len;
+}
+
 static int mmc_blk_open(struct block_device *bdev, fmode_t mode)
 {
 	struct mmc_blk_data *md = mmc_blk_get(bdev->bd_disk);
@@ -781,16 +820,20 @@ out:
 static int mmc_blk_issue_flush(struct mmc_queue *mq, struct request *req)
 {
 	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = md->queue.card;
+	int ret;
 
 	/*
-	 * No-op, only service this because we need REQ_FUA for reliable
-	 * writes.
+	 * Write back the volatile cache. Without one this is a no-op,
+	 * only serviced because we need REQ_FUA for reliable writes.
 	 */
+	ret = mmc_flush_cache(card) ? -EIO : 0;
+
 	spin_lock_irq(&md->lock);
-	__blk_end_request_all(req, 0);
+	__blk_end_request_all(req, ret);
 	spin_unlock_irq(&md->lock);
 
-	return 1;
+	return ret ? 0 : 1;
 }
 
 /*
@@ -832,6 +875,7 @@ static int mmc_blk_err_check(struct mmc_card *card,
 						    mmc_active);
 	struct mmc_blk_request *brq = &mq_mrq->brq;
 	struct request *req = mq_mrq->req;
+	unsigned int bytes;
 
 	/*
 	 * sbc.error indicates a problem with the set block count
@@ -908,8 +952,13 @@ static int mmc_blk_err_check(struct mmc_card *card,
 		}
 	}
 
-	if (ret == MMC_BLK_SUCCESS &&
-	    blk_rq_bytes(req) != brq->data.bytes_xfered)
+	/* A packed write also carries its header block */
+	if (mq_mrq->cmd_type == MMC_PACKED_WRITE)
+		bytes = (mq_mrq->packed_blocks + 1) << 9;
+	else
+		bytes = blk_rq_bytes(req);
+
+	if (ret == MMC_BLK_SUCCESS && bytes != brq->data.bytes_xfered)
 		ret = MMC_BLK_PARTIAL;
 
 	return ret;
@@ -1052,6 +1101,280 @@ static void mmc_blk_rw_rq_prep(struct mmc_queue_req *mqrq,
 	mmc_queue_bounce_pre(mqrq);
 }
 
+/*
+ * A packed write failure is reported through the exception event
+ * status; when the card names the failing entry, everything before it
+ * has been programmed.
+ */
+static int mmc_blk_packed_err_check(struct mmc_card *card,
+				    struct mmc_async_req *areq)
+{
+	struct mmc_queue_req *mq_rq = container_of(areq, struct mmc_queue_req,
+						   mmc_active);
+	struct request *req = mq_rq->req;
+	int check, err;
+	u32 status;
+	u8 *ext_csd;
+
+	check = mmc_blk_err_check(card, areq);
+
+	err = get_card_status(card, &status, 0);
+	if (err) {
+		pr_err("%s: error %d sending status command\n",
+		       req->rq_disk->disk_name, err);
+		return MMC_BLK_ABORT;
+	}
+
+	if (!(status & R1_EXCEPTION_EVENT))
+		return check;
+
+	ext_csd = kmalloc(512, GFP_KERNEL);
+	if (!ext_csd)
+		return MMC_BLK_ABORT;
+
+	err = mmc_send_ext_csd(card, ext_csd);
+	if (err) {
+		pr_err("%s: error %d sending ext_csd\n",
+		       req->rq_disk->disk_name, err);
+		check = MMC_BLK_ABORT;
+		goto out;
+	}
+
+	if ((ext_csd[EXT_CSD_EXP_EVENTS_STATUS] & EXT_CSD_PACKED_FAILURE) &&
+	    (ext_csd[EXT_CSD_PACKED_CMD_STATUS] &
+	     EXT_CSD_PACKED_GENERIC_ERROR)) {
+		if (ext_csd[EXT_CSD_PACKED_CMD_STATUS] &
+		    EXT_CSD_PACKED_INDEXED_ERROR) {
+			/* The card counts entries from 1 */
+			mq_rq->packed_fail_idx =
+				ext_csd[EXT_CSD_PACKED_FAILURE_INDEX] - 1;
+			check = MMC_BLK_PARTIAL;
+		}
+		pr_err("%s: packed cmd failed, nr %u, sectors %u, "
+		       "failure index: %d\n", req->rq_disk->disk_name,
+		       mq_rq->packed_num, mq_rq->packed_blocks,
+		       mq_rq->packed_fail_idx);
+	}
+ out:
+	kfree(ext_csd);
+	return check;
+}
+
+static inline bool mmc_blk_packable(struct request *req)
+{
+	/* Reliable writes and anything that is not a plain write stay alone */
+	return req->cmd_type == REQ_TYPE_FS &&
+		rq_data_dir(req) == WRITE &&
+		!(req->cmd_flags & (REQ_DISCARD | REQ_FLUSH | REQ_FUA |
+				    REQ_META));
+}
+
+/*
+ * Pull further writes off the request queue to go out with req in one
+ * packed command. Returns true if at least one more request was found,
+ * with the whole group, req first, on mq->mqrq_cur->packed_list.
+ */
+static bool mmc_blk_prep_packed_list(struct mmc_queue *mq,
+				     struct request *req)
+{
+	struct request_queue *q = mq->queue;
+	struct mmc_queue_req *mqrq = mq->mqrq_cur;
+	struct mmc_host *host = mq->card->host;
+	struct mmc_packed_stats *stats = &mq->packed_stats;
+	unsigned int max_blocks, blocks, segs, num = 1;
+	enum mmc_packed_stop stop;
+	struct request *next;
+
+	mqrq->cmd_type = MMC_PACKED_NONE;
+
+	if (!mq->packed_max || !mmc_blk_packable(req))
+		return false;
+
+	if (mq->packed_no_pack) {
+		mq->packed_no_pack--;
+		return false;
+	}
+
+	/* One block and one segment go to the packed header */
+	max_blocks = min(host->max_blk_count, host->max_req_size >> 9);
+	blocks = 1 + blk_rq_sectors(req);
+	segs = 1 + blk_rq_nr_phys_segments(req);
+	if (blocks > max_blocks || segs > host->max_segs)
+		return false;
+
+	INIT_LIST_HEAD(&mqrq->packed_list);
+	list_add_tail(&req->queuelist, &mqrq->packed_list);
+
+	spin_lock_irq(q->queue_lock);
+	for (;;) {
+		if (num >= mq->packed_max) {
+			stop = MMC_PACKED_STOP_DEPTH;
+			break;
+		}
+
+		next = blk_peek_request(q);
+		if (!next) {
+			stop = MMC_PACKED_STOP_EMPTY;
+			break;
+		}
+
+		if (!mmc_blk_packable(next)) {
+			stop = MMC_PACKED_STOP_TYPE;
+			break;
+		}
+
+		if (blocks + blk_rq_sectors(next) > max_blocks ||
+		    segs + blk_rq_nr_phys_segments(next) > host->max_segs) {
+			stop = MMC_PACKED_STOP_SIZE;
+			break;
+		}
+
+		blk_start_request(next);
+		list_add_tail(&next->queuelist, &mqrq->packed_list);
+		blocks += blk_rq_sectors(next);
+		segs += blk_rq_nr_phys_segments(next);
+		num++;
+	}
+	spin_unlock_irq(q->queue_lock);
+
+	stats->stop[stop]++;
+	stats->depth[min_t(unsigned int, num,
+			   MMC_PACKED_DEPTH_BUCKETS - 1)]++;
+
+	if (num < 2) {
+		list_del_init(&req->queuelist);
+		return false;
+	}
+
+	mqrq->cmd_type = MMC_PACKED_WRITE;
+	mqrq->packed_num = num;
+	stats->packed++;
+
+	return true;
+}
+
+static void mmc_blk_packed_hdr_wrq_prep(struct mmc_queue_req *mqrq,
+					struct mmc_card *card,
+					struct mmc_queue *mq)
+{
+	struct mmc_blk_request *brq = &mqrq->brq;
+	struct request *req = mqrq->req;
+	__le32 *hdr = mqrq->packed_cmd_hdr;
+	struct request *prq;
+	unsigned int i = 1;
+
+	memset(hdr, 0, MMC_PACKED_HDR_SIZE);
+	hdr[0] = cpu_to_le32((mqrq->packed_num << 16) |
+			     (MMC_PACKED_CMD_WR << 8) | MMC_PACKED_CMD_VER);
+	mqrq->packed_blocks = 0;
+	mqrq->packed_fail_idx = -1;
+
+	/* Each entry: the CMD23 and CMD25 arguments it would have used */
+	list_for_each_entry(prq, &mqrq->packed_list, queuelist) {
+		hdr[i * 2] = cpu_to_le32(blk_rq_sectors(prq));
+		hdr[i * 2 + 1] = cpu_to_le32(mmc_card_blockaddr(card) ?
+					     blk_rq_pos(prq) :
+					     blk_rq_pos(prq) << 9);
+		mqrq->packed_blocks += blk_rq_sectors(prq);
+		i++;
+	}
+
+	memset(brq, 0, sizeof(struct mmc_blk_request));
+	brq->mrq.cmd = &brq->cmd;
+	brq->mrq.data = &brq->data;
+	brq->mrq.sbc = &brq->sbc;
+	brq->mrq.stop = &brq->stop;
+
+	brq->sbc.opcode = MMC_SET_BLOCK_COUNT;
+	brq->sbc.arg = MMC_CMD23_ARG_PACKED | (mqrq->packed_blocks + 1);
+	brq->sbc.flags = MMC_RSP_R1 | MMC_CMD_AC;
+
+	brq->cmd.opcode = MMC_WRITE_MULTIPLE_BLOCK;
+	brq->cmd.arg = blk_rq_pos(req);
+	if (!mmc_card_blockaddr(card))
+		brq->cmd.arg <<= 9;
+	brq->cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_ADTC;
+
+	brq->data.blksz = 512;
+	brq->data.blocks = mqrq->packed_blocks + 1;
+	brq->data.flags |= MMC_DATA_WRITE;
+
+	brq->stop.opcode = MMC_STOP_TRANSMISSION;
+	brq->stop.arg = 0;
+	brq->stop.flags = MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC;
+
+	mmc_set_data_timeout(&brq->data, card);
+
+	brq->data.sg = mqrq->sg;
+	brq->data.sg_len = mmc_queue_map_sg(mq, mqrq);
+
+	mqrq->mmc_active.mrq = &brq->mrq;
+	mqrq->mmc_active.err_check = mmc_blk_packed_err_check;
+}
+
+/*
+ * Complete the entries of a packed group that the card programmed and
+ * put the rest back at the head of the queue, where they are picked up
+ * again and issued one by one.  Returns the number of requeued requests.
+ */
+static int mmc_blk_end_packed_req(struct mmc_queue *mq,
+				  struct mmc_queue_req *mq_rq,
+				  enum mmc_blk_status status)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct request *prq, *tmp;
+	int idx = 0, done = 0, requeued = 0;
+
+	if (status == MMC_BLK_SUCCESS)
+		done = mq_rq->packed_num;
+	else if (status == MMC_BLK_PARTIAL &&
+		 mq_rq->packed_fail_idx < (int)mq_rq->packed_num)
+		done = max(mq_rq->packed_fail_idx, 0);
+
+	spin_lock_irq(&md->lock);
+	list_for_each_entry_safe(prq, tmp, &mq_rq->packed_list, queuelist) {
+		if (idx++ >= done)
+			break;
+		list_del_init(&prq->queuelist);
+		__blk_end_request(prq, 0, blk_rq_bytes(prq));
+	}
+	/* Requeue back to front so the queue keeps the original order */
+	list_for_each_entry_safe_reverse(prq, tmp, &mq_rq->packed_list,
+					 queuelist) {
+		list_del_init(&prq->queuelist);
+		blk_requeue_request(mq->queue, prq);
+		requeued++;
+	}
+	spin_unlock_irq(&md->lock);
+
+	mq_rq->cmd_type = MMC_PACKED_NONE;
+
+	if (!requeued) {
+		mq->packed_errors = 0;
+		return 0;
+	}
+
+	mq->packed_stats.failed++;
+	mq->packed_stats.fallback += requeued;
+	mq->packed_no_pack = requeued;
+	if (++mq->packed_errors >= MMC_PACKED_MAX_ERRORS && mq->packed_max) {
+		pr_warning("%s: %d packed command failures in a row, "
+			   "packing disabled\n", md->disk->disk_name,
+			   mq->packed_errors);
+		mq->packed_max = 0;
+	}
+
+	return requeued;
+}
+
+static void mmc_blk_prep_cur(struct mmc_queue *mq, struct mmc_card *card)
+{
+	if (mq->mqrq_cur->cmd_type == MMC_PACKED_WRITE)
+		mmc_blk_packed_hdr_wrq_prep(mq->mqrq_cur, card, mq);
+	else
+		mmc_blk_rw_rq_prep(mq->mqrq_cur, card, 0, mq);
+}
+
 static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 {
 	struct mmc_blk_data *md = mq->data;
@@ -1066,9 +1389,12 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 	if (!rqc && !mq->mqrq_prev->req)
 		return 0;
 
+	if (rqc)
+		mmc_blk_prep_packed_list(mq, rqc);
+
 	do {
 		if (rqc) {
-			mmc_blk_rw_rq_prep(mq->mqrq_cur, card, 0, mq);
+			mmc_blk_prep_cur(mq, card);
 			areq = &mq->mqrq_cur->mmc_active;
 		} else
 			areq = NULL;
@@ -1081,6 +1407,18 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 		req = mq_rq->req;
 		mmc_queue_bounce_post(mq_rq);
 
+		if (mq_rq->cmd_type == MMC_PACKED_WRITE) {
+			/*
+			 * Unless the group went through cleanly, rqc has
+			 * not been started yet.
+			 */
+			mmc_blk_end_packed_req(mq, mq_rq, status);
+			if (status != MMC_BLK_SUCCESS)
+				goto start_new_req;
+			ret = 0;
+			break;
+		}
+
 		switch (status) {
 		case MMC_BLK_SUCCESS:
 		case MMC_BLK_PARTIAL:
@@ -1177,7 +1515,7 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 
  start_new_req:
 	if (rqc) {
-		mmc_blk_rw_rq_prep(mq->mqrq_cur, card, 0, mq);
+		mmc_blk_prep_cur(mq, card);
 		mmc_start_req(card->host, &mq->mqrq_cur->mmc_active, NULL);
 	}
 
@@ -1204,6 +1542,13 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 		/* claim host only for the first request */
 		mmc_claim_host(card->host);
 
+	/*
+	 * Abort any current bk ops of eMMC card by issuing HPI, before the
+	 * partition switch, discard or flush sends it a command.
+	 */
+	if (req && mmc_card_mmc(card) && mmc_card_doing_bkops(card))
+		mmc_interrupt_hpi(card);
+
 	ret = mmc_blk_part_switch(card, md);
 	if (ret) {
 		ret = 0;
@@ -1224,10 +1569,6 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 			mmc_blk_issue_rw_rq(mq, NULL);
 		ret = mmc_blk_issue_flush(mq, req);
 	} else {
-		/* Abort any current bk ops of eMMC card by issuing HPI */
-		if (mmc_card_mmc(mq->card) && mmc_card_doing_bkops(mq->card))
-			mmc_interrupt_hpi(mq->card);
-
 		ret = mmc_blk_issue_rw_rq(mq, req);
 	}
 
@@ -1335,12 +1676,19 @@ static struct mmc_blk_data *mmc_blk_alloc_req(struct mmc_card *card,
 			md->flags |= MMC_BLK_CMD23;
 	}
 
+	/* The packed header is announced with CMD23 */
+	if (!(md->flags & MMC_BLK_CMD23))
+		md->queue.packed_max = 0;
+
 	if (mmc_card_mmc(card) &&
 	    md->flags & MMC_BLK_CMD23 &&
 	    ((card->ext_csd.rel_param & EXT_CSD_WR_REL_PARAM_EN) ||
 	     card->ext_csd.rel_sectors)) {
 		md->flags |= MMC_BLK_REL_WR;
 		blk_queue_flush(md->queue.queue, REQ_FLUSH | REQ_FUA);
+	} else if (mmc_card_mmc(card) && card->ext_csd.cache_ctrl) {
+		/* FUA is emulated by the block layer with a post-flush */
+		blk_queue_flush(md->queue.queue, REQ_FLUSH);
 	}
 
 	return md;
@@ -1449,6 +1797,8 @@ static void mmc_blk_remove_req(struct mmc_blk_data *md)
 	if (md) {
 		if (md->disk->flags & GENHD_FL_UP) {
 			device_remove_file(disk_to_dev(md->disk), &md->force_ro);
+			device_remove_file(disk_to_dev(md->disk),
+					   &md->packed_stats);
 
 			/* Stop new requests from getting into the queue */
 			del_gendisk(md->disk);
@@ -1486,8 +1836,22 @@ static int mmc_add_disk(struct mmc_blk_data *md)
 	md->force_ro.attr.mode = S_IRUGO | S_IWUSR;
 	ret = device_create_file(disk_to_dev(md->disk), &md->force_ro);
 	if (ret)
-		del_gendisk(md->disk);
+		goto force_ro_fail;
+
+	md->packed_stats.show = packed_stats_show;
+	sysfs_attr_init(&md->packed_stats.attr);
+	md->packed_stats.attr.name = "packed_stats";
+	md->packed_stats.attr.mode = S_IRUGO;
+	ret = device_create_file(disk_to_dev(md->disk), &md->packed_stats);
+	if (ret)
+		goto packed_stats_fail;
+
+	return 0;
 
+ packed_stats_fail:
+	device_remove_file(disk_to_dev(md->disk), &md->force_ro);
+ force_ro_fail:
+	del_gendisk(md->disk);
 	return ret;
 }
 
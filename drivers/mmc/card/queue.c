@@ -15,15 +15,34 @@
 #include <linux/freezer.h>
 #include <linux/kthread.h>
 #include <linux/scatterlist.h>
+#include <linux/jiffies.h>
+#include <linux/moduleparam.h>
 
 #include <linux/mmc/card.h>
 #include <linux/mmc/host.h>
+#include <linux/mmc/mmc.h>
 #include "queue.h"
 
 #define MMC_QUEUE_BOUNCESZ	65536
 
 #define MMC_QUEUE_SUSPENDED	(1 << 0)
 
+#define MMC_BKOPS_POLL_MS	100
+
+#ifdef MODULE_PARAM_PREFIX
+#undef MODULE_PARAM_PREFIX
+#endif
+#define MODULE_PARAM_PREFIX "mmcblk."
+
+/*
+ * Start background operations once the queue has been idle this long,
+ * if the card reports any outstanding work.  0 leaves bkops to the
+ * card's urgent requests only.
+ */
+static unsigned int bkops_idle_ms = 2000;
+module_param(bkops_idle_ms, uint, 0644);
+MODULE_PARM_DESC(bkops_idle_ms, "Idle time before starting eMMC bkops");
+
 /*
  * Prepare a MMC request. This just filters out odd stuff.
  */
@@ -42,6 +61,72 @@ static int mmc_prep_request(struct request_queue *q, struct request *req)
 	return BLKPREP_OK;
 }
 
+/*
+ * Called by the queue thread whenever the request queue is empty.
+ * Starts non-blocking bkops after the idle period, or right away if
+ * the card flagged them as urgent, and keeps track of them until the
+ * card is done.  The next request interrupts them with HPI from
+ * mmc_blk_issue_rq().  Returns how long the thread may sleep.
+ */
+static long mmc_queue_bkops_idle(struct mmc_queue *mq)
+{
+	struct mmc_card *card = mq->card;
+	unsigned long idle_end;
+	int level;
+
+	if (!mmc_card_mmc(card) || !card->ext_csd.bk_ops_en)
+		return MAX_SCHEDULE_TIMEOUT;
+
+	/* Without HPI, bkops can't be cut short; run them blocking */
+	if (!card->ext_csd.hpi_en) {
+		if (mmc_card_need_bkops(card)) {
+			card->bkops_stats.urgent++;
+			mmc_bkops_start(card, true);
+		}
+		return MAX_SCHEDULE_TIMEOUT;
+	}
+
+	if (mmc_card_doing_bkops(card)) {
+		if (mmc_bkops_poll(card) > 0)
+			return msecs_to_jiffies(MMC_BKOPS_POLL_MS);
+		return MAX_SCHEDULE_TIMEOUT;
+	}
+
+	if (mmc_card_need_bkops(card)) {
+		card->bkops_stats.urgent++;
+		goto start;
+	}
+
+	if (!bkops_idle_ms || mq->bkops_checked)
+		return MAX_SCHEDULE_TIMEOUT;
+
+	idle_end = mq->last_io + msecs_to_jiffies(bkops_idle_ms);
+	if (time_before(jiffies, idle_end))
+		return idle_end - jiffies;
+
+	mq->bkops_checked = true;
+	level = mmc_bkops_level(card);
+	if (level <= 0)
+		return MAX_SCHEDULE_TIMEOUT;
+
+ start:
+	if (mmc_bkops_start(card, false))
+		return MAX_SCHEDULE_TIMEOUT;
+
+	return msecs_to_jiffies(MMC_BKOPS_POLL_MS);
+}
+
+static bool mmc_queue_empty(struct request_queue *q)
+{
+	bool empty;
+
+	spin_lock_irq(q->queue_lock);
+	empty = !blk_peek_request(q);
+	spin_unlock_irq(q->queue_lock);
+
+	return empty;
+}
+
 static int mmc_queue_thread(void *d)
 {
 	struct mmc_queue *mq = d;
@@ -62,20 +147,32 @@ static int mmc_queue_thread(void *d)
 
 		if (req || mq->mqrq_prev->req) {
 			set_current_state(TASK_RUNNING);
+			if (req) {
+				mq->last_io = jiffies;
+				mq->bkops_checked = false;
+			}
 			mq->issue_fn(mq, req);
 		} else {
-			/*
-			 * Since the queue is empty, start synchronous
-			 * background ops if there is a request for it.
-			 */
-			if (mmc_card_need_bkops(mq->card))
-				mmc_bkops_start(mq->card, true);
+			long timeout;
+
 			if (kthread_should_stop()) {
 				set_current_state(TASK_RUNNING);
 				break;
 			}
+			/*
+			 * The bkops commands may sleep; only go back to
+			 * TASK_INTERRUPTIBLE once they are issued, and
+			 * recheck for wakeups that came in meanwhile.
+			 */
+			set_current_state(TASK_RUNNING);
+			timeout = mmc_queue_bkops_idle(mq);
+			set_current_state(TASK_INTERRUPTIBLE);
+			if (kthread_should_stop() || !mmc_queue_empty(q)) {
+				set_current_state(TASK_RUNNING);
+				continue;
+			}
 			up(&mq->thread_sem);
-			schedule();
+			schedule_timeout(timeout);
 			down(&mq->thread_sem);
 		}
 
@@ -259,8 +356,33 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card,
 		mqrq_prev->sg = mmc_alloc_sg(host->max_segs, &ret);
 		if (ret)
 			goto cleanup_queue;
+
+		/*
+		 * Packed writes need a scatterlist entry for the header
+		 * and at least two requests behind it, so bounce-buffered
+		 * hosts never get here.
+		 */
+		if (mmc_card_mmc(card) && card->ext_csd.packed_event_en &&
+		    (host->caps2 & MMC_CAP2_PACKED_WR) && host->max_segs > 2) {
+			mqrq_cur->packed_cmd_hdr =
+				kzalloc(MMC_PACKED_HDR_SIZE, GFP_KERNEL);
+			mqrq_prev->packed_cmd_hdr =
+				kzalloc(MMC_PACKED_HDR_SIZE, GFP_KERNEL);
+			if (mqrq_cur->packed_cmd_hdr &&
+			    mqrq_prev->packed_cmd_hdr)
+				mq->packed_max =
+					min_t(unsigned int, MMC_PACKED_MAX_ENTRIES,
+					      card->ext_csd.max_packed_writes);
+			else
+				printk(KERN_WARNING "%s: unable to allocate "
+					"packed command header, packing "
+					"disabled\n", mmc_card_name(card));
+		}
 	}
 
+	INIT_LIST_HEAD(&mqrq_cur->packed_list);
+	INIT_LIST_HEAD(&mqrq_prev->packed_list);
+
 	sema_init(&mq->thread_sem, 1);
 
 	mq->thread = kthread_run(mmc_queue_thread, mq, "mmcqd/%d%s",
@@ -289,6 +411,12 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card,
 	kfree(mqrq_prev->bounce_buf);
 	mqrq_prev->bounce_buf = NULL;
 
+	kfree(mqrq_cur->packed_cmd_hdr);
+	mqrq_cur->packed_cmd_hdr = NULL;
+	kfree(mqrq_prev->packed_cmd_hdr);
+	mqrq_prev->packed_cmd_hdr = NULL;
+	mq->packed_max = 0;
+
 	blk_cleanup_queue(mq->queue);
 	return ret;
 }
@@ -330,6 +458,12 @@ void mmc_cleanup_queue(struct mmc_queue *mq)
 	kfree(mqrq_prev->bounce_buf);
 	mqrq_prev->bounce_buf = NULL;
 
+	kfree(mqrq_cur->packed_cmd_hdr);
+	mqrq_cur->packed_cmd_hdr = NULL;
+
+	kfree(mqrq_prev->packed_cmd_hdr);
+	mqrq_prev->packed_cmd_hdr = NULL;
+
 	mq->card = NULL;
 }
 EXPORT_SYMBOL(mmc_cleanup_queue);
@@ -378,6 +512,30 @@ void mmc_queue_resume(struct mmc_queue *mq)
 	}
 }
 
+/*
+ * Map a packed write: the header block first, then the data of every
+ * request in the group, back to back in one scatterlist.
+ */
+static unsigned int mmc_queue_packed_map_sg(struct mmc_queue *mq,
+					    struct mmc_queue_req *mqrq)
+{
+	struct scatterlist *sg = mqrq->sg;
+	struct request *req;
+	unsigned int sg_len = 1;
+
+	sg_set_buf(sg, mqrq->packed_cmd_hdr, MMC_PACKED_HDR_SIZE);
+	sg_unmark_end(sg);
+
+	list_for_each_entry(req, &mqrq->packed_list, queuelist) {
+		sg_len += blk_rq_map_sg(mq->queue, req, mqrq->sg + sg_len);
+		/* blk_rq_map_sg() terminates the list after each request */
+		sg_unmark_end(mqrq->sg + sg_len - 1);
+	}
+	sg_mark_end(mqrq->sg + sg_len - 1);
+
+	return sg_len;
+}
+
 /*
  * Prepare the sg list(s) to be handed of to the host driver
  */
@@ -388,6 +546,9 @@ unsigned int mmc_queue_map_sg(struct mmc_queue *mq, struct mmc_queue_req *mqrq)
 	struct scatterlist *sg;
 	int i;
 
+	if (mqrq->cmd_type == MMC_PACKED_WRITE)
+		return mmc_queue_packed_map_sg(mq, mqrq);
+
 	if (!mqrq->bounce_buf)
 		return blk_rq_map_sg(mq->queue, mqrq->req, mqrq->sg);
 
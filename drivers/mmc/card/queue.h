@@ -12,6 +12,38 @@ struct mmc_blk_request {
 	struct mmc_data		data;
 };
 
+enum mmc_packed_cmd {
+	MMC_PACKED_NONE = 0,
+	MMC_PACKED_WRITE,
+};
+
+/*
+ * The packed command header is a single 512 byte block; word 0 holds
+ * the version, direction and entry count, and each entry takes two
+ * words (CMD23 argument, CMD25 argument) starting at word 2.
+ */
+#define MMC_PACKED_HDR_SIZE	512
+#define MMC_PACKED_MAX_ENTRIES	63
+
+/* Reasons for closing a packed group, see mmc_blk_prep_packed_list() */
+enum mmc_packed_stop {
+	MMC_PACKED_STOP_EMPTY = 0,	/* no more requests queued */
+	MMC_PACKED_STOP_DEPTH,		/* max_packed_writes reached */
+	MMC_PACKED_STOP_SIZE,		/* host block/segment limit */
+	MMC_PACKED_STOP_TYPE,		/* read, flush, discard, FUA/META */
+	MMC_PACKED_STOP_MAX,
+};
+
+#define MMC_PACKED_DEPTH_BUCKETS	17	/* last bucket is 16 or more */
+
+struct mmc_packed_stats {
+	unsigned long		depth[MMC_PACKED_DEPTH_BUCKETS];
+	unsigned long		stop[MMC_PACKED_STOP_MAX];
+	unsigned long		packed;		/* packed commands issued */
+	unsigned long		failed;		/* packed commands failed */
+	unsigned long		fallback;	/* requests reissued unpacked */
+};
+
 struct mmc_queue_req {
 	struct request		*req;
 	struct mmc_blk_request	brq;
@@ -20,6 +52,12 @@ struct mmc_queue_req {
 	struct scatterlist	*bounce_sg;
 	unsigned int		bounce_sg_len;
 	struct mmc_async_req	mmc_active;
+	enum mmc_packed_cmd	cmd_type;
+	struct list_head	packed_list;	/* requests, via queuelist */
+	__le32			*packed_cmd_hdr;
+	unsigned int		packed_blocks;	/* data blocks, no header */
+	unsigned int		packed_num;
+	int			packed_fail_idx;
 };
 
 struct mmc_queue {
@@ -33,6 +71,12 @@ struct mmc_queue {
 	struct mmc_queue_req	mqrq[2];
 	struct mmc_queue_req	*mqrq_cur;
 	struct mmc_queue_req	*mqrq_prev;
+	unsigned long		last_io;	/* jiffies of the last request */
+	bool			bkops_checked;	/* idle bkops already considered */
+	unsigned int		packed_max;	/* 0 if packing is disabled */
+	unsigned int		packed_no_pack;	/* issue unpacked after error */
+	unsigned int		packed_errors;	/* consecutive failures */
+	struct mmc_packed_stats	packed_stats;
 };
 
 extern int mmc_init_queue(struct mmc_queue *, struct mmc_card *, spinlock_t *,
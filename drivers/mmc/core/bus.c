@@ -131,6 +131,18 @@ static int mmc_bus_remove(struct device *dev)
 	return 0;
 }
 
+static void mmc_bus_shutdown(struct device *dev)
+{
+	struct mmc_card *card = mmc_dev_to_card(dev);
+
+	/* don't leave data in the eMMC cache across a power off */
+	mmc_claim_host(card->host);
+	if (mmc_card_mmc(card) && mmc_card_doing_bkops(card))
+		mmc_interrupt_hpi(card);
+	mmc_flush_cache(card);
+	mmc_release_host(card->host);
+}
+
 static int mmc_bus_pm_suspend(struct device *dev)
 {
 	struct mmc_driver *drv = to_mmc_driver(dev->driver);
@@ -187,6 +199,7 @@ static struct bus_type mmc_bus_type = {
 	.uevent		= mmc_bus_uevent,
 	.probe		= mmc_bus_probe,
 	.remove		= mmc_bus_remove,
+	.shutdown	= mmc_bus_shutdown,
 	.pm		= &mmc_bus_pm_ops,
 };
 
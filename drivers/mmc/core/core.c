@@ -26,6 +26,8 @@
 #include <linux/pm_runtime.h>
 #include <linux/suspend.h>
 #include <linux/wakelock.h>
+#include <linux/slab.h>
+#include <linux/ktime.h>
 
 #include <linux/mmc/card.h>
 #include <linux/mmc/host.h>
@@ -325,6 +327,16 @@ void mmc_wait_for_req(struct mmc_host *host, struct mmc_request *mrq)
 }
 EXPORT_SYMBOL(mmc_wait_for_req);
 
+static void mmc_bkops_account(struct mmc_card *card, bool preempted)
+{
+	card->bkops_stats.time_us +=
+		ktime_us_delta(ktime_get(), card->bkops_start);
+	if (preempted)
+		card->bkops_stats.preempted++;
+	else
+		card->bkops_stats.completed++;
+}
+
 /**
  *	mmc_bkops_start - Issue start for mmc background ops
  *	@card: the MMC card associated with bkops
@@ -336,6 +348,7 @@ int mmc_bkops_start(struct mmc_card *card, bool is_synchronous)
 {
 	int err;
 	unsigned long flags;
+	ktime_t start;
 
 	BUG_ON(!card);
 
@@ -343,6 +356,7 @@ int mmc_bkops_start(struct mmc_card *card, bool is_synchronous)
 		return 1;
 
 	mmc_claim_host(card->host);
+	start = ktime_get();
 	err = mmc_send_bk_ops_cmd(card, is_synchronous);
 	if (err)
 		pr_err("%s: abort bk ops (%d error)\n",
@@ -355,16 +369,89 @@ int mmc_bkops_start(struct mmc_card *card, bool is_synchronous)
 	 */
 		spin_lock_irqsave(&card->host->lock, flags);
 		mmc_card_clr_need_bkops(card);
-		if (!is_synchronous)
+		if (!is_synchronous && !err)
 			mmc_card_set_doing_bkops(card);
 		spin_unlock_irqrestore(&card->host->lock, flags);
 
+	if (!err) {
+		card->bkops_stats.started++;
+		card->bkops_start = start;
+		if (is_synchronous)
+			mmc_bkops_account(card, false);
+	}
+
 	mmc_release_host(card->host);
 
 	return err;
 }
 EXPORT_SYMBOL(mmc_bkops_start);
 
+/**
+ *	mmc_bkops_poll - check on non-blocking background ops
+ *	@card: the MMC card doing bk ops
+ *
+ *	Returns 1 while the card is still busy with the background
+ *	operations started by mmc_bkops_start(), 0 once it is done
+ *	with them, or a negative error if the status can't be read.
+ */
+int mmc_bkops_poll(struct mmc_card *card)
+{
+	int err;
+	u32 status;
+	unsigned long flags;
+
+	BUG_ON(!card);
+
+	if (!mmc_card_doing_bkops(card))
+		return 0;
+
+	mmc_claim_host(card->host);
+	err = mmc_send_status(card, &status);
+	mmc_release_host(card->host);
+	if (err)
+		return err;
+
+	if (R1_CURRENT_STATE(status) == R1_STATE_PRG)
+		return 1;
+
+	spin_lock_irqsave(&card->host->lock, flags);
+	mmc_card_clr_doing_bkops(card);
+	spin_unlock_irqrestore(&card->host->lock, flags);
+	mmc_bkops_account(card, false);
+
+	return 0;
+}
+EXPORT_SYMBOL(mmc_bkops_poll);
+
+/**
+ *	mmc_bkops_level - read the pending background work of a card
+ *	@card: the MMC card to query
+ *
+ *	Returns the EXT_CSD BKOPS_STATUS level, from 0 (nothing pending)
+ *	to 3 (critical), or a negative error.
+ */
+int mmc_bkops_level(struct mmc_card *card)
+{
+	int err;
+	u8 *ext_csd;
+
+	BUG_ON(!card);
+
+	ext_csd = kmalloc(512, GFP_KERNEL);
+	if (!ext_csd)
+		return -ENOMEM;
+
+	mmc_claim_host(card->host);
+	err = mmc_send_ext_csd(card, ext_csd);
+	mmc_release_host(card->host);
+	if (!err)
+		err = ext_csd[EXT_CSD_BKOPS_STATUS] & 0x3;
+
+	kfree(ext_csd);
+	return err;
+}
+EXPORT_SYMBOL(mmc_bkops_level);
+
 /**
  *	mmc_interrupt_hpi - Issue for High priority Interrupt
  *	@card: the MMC card associated with the HPI transfer
@@ -377,6 +464,7 @@ int mmc_interrupt_hpi(struct mmc_card *card)
 	int err;
 	u32 status;
 	unsigned long flags;
+	bool preempted = false, was_doing;
 
 	BUG_ON(!card);
 
@@ -399,6 +487,7 @@ int mmc_interrupt_hpi(struct mmc_card *card)
 	 * If the card status is in PRG-state, we can send the HPI command.
 	 */
 	if (R1_CURRENT_STATE(status) == R1_STATE_PRG) {
+		preempted = true;
 		do {
 			/*
 			 * We don't know when the HPI command will finish
@@ -422,13 +511,73 @@ int mmc_interrupt_hpi(struct mmc_card *card)
 
 out:
 	spin_lock_irqsave(&card->host->lock, flags);
+	was_doing = mmc_card_doing_bkops(card);
 	mmc_card_clr_doing_bkops(card);
 	spin_unlock_irqrestore(&card->host->lock, flags);
+	if (was_doing)
+		mmc_bkops_account(card, preempted);
 	mmc_release_host(card->host);
 	return err;
 }
 EXPORT_SYMBOL(mmc_interrupt_hpi);
 
+/**
+ *	mmc_flush_cache - write back the eMMC volatile cache
+ *	@card: the MMC card to flush
+ *
+ *	The host must be claimed. Returns 0 when there is no enabled
+ *	cache to flush.
+ */
+int mmc_flush_cache(struct mmc_card *card)
+{
+	int err = 0;
+
+	if (!mmc_card_mmc(card) || !card->ext_csd.cache_ctrl)
+		return 0;
+
+	err = mmc_switch(card, EXT_CSD_CMD_SET_NORMAL,
+			EXT_CSD_FLUSH_CACHE, 1, 0);
+	if (err)
+		pr_err("%s: cache flush error %d\n",
+			mmc_hostname(card->host), err);
+
+	return err;
+}
+EXPORT_SYMBOL(mmc_flush_cache);
+
+/**
+ *	mmc_cache_ctrl - turn the eMMC volatile cache on or off
+ *	@host: the host of the MMC card
+ *	@enable: 1 to turn the cache on, 0 to flush it and turn it off
+ *
+ *	The host must be claimed.
+ */
+int mmc_cache_ctrl(struct mmc_host *host, u8 enable)
+{
+	struct mmc_card *card = host->card;
+	int err = 0;
+
+	if (!(host->caps2 & MMC_CAP2_CACHE_CTRL) ||
+	    !card || !mmc_card_mmc(card) || !card->ext_csd.cache_size)
+		return 0;
+
+	enable = !!enable;
+	if (card->ext_csd.cache_ctrl == enable)
+		return 0;
+
+	/* the card writes the cache back before turning it off */
+	err = mmc_switch(card, EXT_CSD_CMD_SET_NORMAL,
+			EXT_CSD_CACHE_CTRL, enable, 0);
+	if (err)
+		pr_err("%s: cache %s error %d\n", mmc_hostname(host),
+			enable ? "on" : "off", err);
+	else
+		card->ext_csd.cache_ctrl = enable;
+
+	return err;
+}
+EXPORT_SYMBOL(mmc_cache_ctrl);
+
 /**
  *	mmc_wait_for_cmd - start a command and wait for completion
  *	@host: MMC host to start command
@@ -2027,6 +2176,10 @@ int mmc_power_save_host(struct mmc_host *host)
 		return -EINVAL;
 	}
 
+	if (host->card && mmc_card_mmc(host->card) &&
+	    mmc_card_doing_bkops(host->card))
+		mmc_interrupt_hpi(host->card);
+
 	if (host->bus_ops->power_save)
 		ret = host->bus_ops->power_save(host);
 
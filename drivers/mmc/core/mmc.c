@@ -13,6 +13,7 @@
 
 #include <linux/err.h>
 #include <linux/slab.h>
+#include <linux/math64.h>
 
 #include <linux/mmc/host.h>
 #include <linux/mmc/card.h>
@@ -427,6 +428,18 @@ static int mmc_read_ext_csd(struct mmc_card *card, u8 *ext_csd)
 			card->ext_csd.bk_ops = 1;
 	}
 
+	if (card->ext_csd.rev >= 6) {
+		card->ext_csd.cache_size =
+			ext_csd[EXT_CSD_CACHE_SIZE + 0] << 0 |
+			ext_csd[EXT_CSD_CACHE_SIZE + 1] << 8 |
+			ext_csd[EXT_CSD_CACHE_SIZE + 2] << 16 |
+			ext_csd[EXT_CSD_CACHE_SIZE + 3] << 24;
+		card->ext_csd.max_packed_writes =
+			ext_csd[EXT_CSD_MAX_PACKED_WRITES];
+		card->ext_csd.max_packed_reads =
+			ext_csd[EXT_CSD_MAX_PACKED_READS];
+	}
+
 	if (ext_csd[EXT_CSD_ERASED_MEM_CONT])
 		card->erased_byte = 0xFF;
 	else
@@ -520,6 +533,14 @@ MMC_DEV_ATTR(serial, "0x%08x\n", card->cid.serial);
 MMC_DEV_ATTR(enhanced_area_offset, "%llu\n",
 		card->ext_csd.enhanced_area_offset);
 MMC_DEV_ATTR(enhanced_area_size, "%u\n", card->ext_csd.enhanced_area_size);
+MMC_DEV_ATTR(cache_size, "%u\n", card->ext_csd.cache_size);
+MMC_DEV_ATTR(cache_enabled, "%d\n", card->ext_csd.cache_ctrl);
+MMC_DEV_ATTR(bkops_started, "%u\n", card->bkops_stats.started);
+MMC_DEV_ATTR(bkops_urgent, "%u\n", card->bkops_stats.urgent);
+MMC_DEV_ATTR(bkops_preempted, "%u\n", card->bkops_stats.preempted);
+MMC_DEV_ATTR(bkops_completed, "%u\n", card->bkops_stats.completed);
+MMC_DEV_ATTR(bkops_time_ms, "%llu\n",
+		div_u64(card->bkops_stats.time_us, 1000));
 
 static struct attribute *mmc_std_attrs[] = {
 	&dev_attr_cid.attr,
@@ -535,6 +556,13 @@ static struct attribute *mmc_std_attrs[] = {
 	&dev_attr_serial.attr,
 	&dev_attr_enhanced_area_offset.attr,
 	&dev_attr_enhanced_area_size.attr,
+	&dev_attr_cache_size.attr,
+	&dev_attr_cache_enabled.attr,
+	&dev_attr_bkops_started.attr,
+	&dev_attr_bkops_urgent.attr,
+	&dev_attr_bkops_preempted.attr,
+	&dev_attr_bkops_completed.attr,
+	&dev_attr_bkops_time_ms.attr,
 	NULL,
 };
 
@@ -781,6 +809,46 @@ static int mmc_init_card(struct mmc_host *host, u32 ocr,
 		}
 	}
 
+	/*
+	 * Enable the volatile cache (if present). Writes then complete
+	 * once they reach the cache; REQ_FLUSH and suspend write it back.
+	 */
+	card->ext_csd.cache_ctrl = 0;
+	if (card->ext_csd.cache_size &&
+	    (card->host->caps2 & MMC_CAP2_CACHE_CTRL)) {
+		err = mmc_switch(card, EXT_CSD_CMD_SET_NORMAL,
+			EXT_CSD_CACHE_CTRL, 1, 0);
+		if (err && err != -EBADMSG)
+			goto free_card;
+		if (err) {
+			pr_warning("%s: Enabling cache failed\n",
+				   mmc_hostname(card->host));
+			err = 0;
+		} else {
+			card->ext_csd.cache_ctrl = 1;
+		}
+	}
+
+	/*
+	 * Packed writes report per-entry failures through the exception
+	 * event mechanism, so only use them when that can be enabled.
+	 */
+	card->ext_csd.packed_event_en = 0;
+	if (card->ext_csd.max_packed_writes &&
+	    (card->host->caps2 & MMC_CAP2_PACKED_WR)) {
+		err = mmc_switch(card, EXT_CSD_CMD_SET_NORMAL,
+			EXT_CSD_EXP_EVENTS_CTRL, EXT_CSD_PACKED_EVENT_EN, 0);
+		if (err && err != -EBADMSG)
+			goto free_card;
+		if (err) {
+			pr_warning("%s: Enabling packed event failed\n",
+				   mmc_hostname(card->host));
+			err = 0;
+		} else {
+			card->ext_csd.packed_event_en = 1;
+		}
+	}
+
 	/*
 	 * Compute bus speed.
 	 */
@@ -919,6 +987,11 @@ static void mmc_remove(struct mmc_host *host)
 	BUG_ON(!host);
 	BUG_ON(!host->card);
 
+	/* the card may lose power right after this */
+	mmc_claim_host(host);
+	mmc_flush_cache(host->card);
+	mmc_release_host(host);
+
 	mmc_remove_card(host->card);
 	host->card = NULL;
 }
@@ -961,6 +1034,7 @@ static int mmc_suspend(struct mmc_host *host)
 	BUG_ON(!host->card);
 
 	mmc_claim_host(host);
+	mmc_cache_ctrl(host, 0);
 	if (!mmc_host_is_spi(host))
 		mmc_deselect_cards(host);
 	host->card->state &= ~MMC_STATE_HIGHSPEED;
@@ -989,6 +1063,17 @@ static int mmc_resume(struct mmc_host *host)
 	return err;
 }
 
+static int mmc_power_save(struct mmc_host *host)
+{
+	int err;
+
+	mmc_claim_host(host);
+	err = mmc_flush_cache(host->card);
+	mmc_release_host(host);
+
+	return err;
+}
+
 static int mmc_power_restore(struct mmc_host *host)
 {
 	int ret;
@@ -1038,6 +1123,7 @@ static const struct mmc_bus_ops mmc_ops = {
 	.detect = mmc_detect,
 	.suspend = NULL,
 	.resume = NULL,
+	.power_save = mmc_power_save,
 	.power_restore = mmc_power_restore,
 };
 
@@ -1048,6 +1134,7 @@ static const struct mmc_bus_ops mmc_ops_unsafe = {
 	.detect = mmc_detect,
 	.suspend = mmc_suspend,
 	.resume = mmc_resume,
+	.power_save = mmc_power_save,
 	.power_restore = mmc_power_restore,
 };
 
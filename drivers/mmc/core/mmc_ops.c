@@ -334,6 +334,7 @@ int mmc_send_ext_csd(struct mmc_card *card, u8 *ext_csd)
 	return mmc_send_cxd_data(card, card->host, MMC_SEND_EXT_CSD,
 			ext_csd, 512);
 }
+EXPORT_SYMBOL_GPL(mmc_send_ext_csd);
 
 int mmc_spi_read_ocr(struct mmc_host *host, int highcap, u32 *ocrp)
 {
@@ -600,12 +601,16 @@ int mmc_send_bk_ops_cmd(struct mmc_card *card, bool is_synchronous)
 	if (err)
 		return err;
 
-	/* Must check status to be sure of no errors */
+	/*
+	 * Must check status to be sure of no errors. Non-blocking bkops
+	 * leave the card in PRG state, so don't wait for that here.
+	 */
 	do {
 		err = mmc_send_status(card, &status);
 		if (err)
 			return err;
-		if (card->host->caps & MMC_CAP_WAIT_WHILE_BUSY)
+		if (!is_synchronous ||
+		    (card->host->caps & MMC_CAP_WAIT_WHILE_BUSY))
 			break;
 	} while (R1_CURRENT_STATE(status) == 7);
 
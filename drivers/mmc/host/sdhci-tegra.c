@@ -1077,6 +1077,7 @@ static int __devinit sdhci_tegra_probe(struct platform_device *pdev)
 	host->mmc->pm_caps |= MMC_PM_KEEP_POWER | MMC_PM_IGNORE_PM_NOTIFY;
 	if (plat->mmc_data.built_in) {
 		host->mmc->caps |= MMC_CAP_NONREMOVABLE;
+		host->mmc->caps2 |= MMC_CAP2_CACHE_CTRL | MMC_CAP2_PACKED_WR;
 		host->mmc->pm_flags |= MMC_PM_IGNORE_PM_NOTIFY;
 	}
 	/* Do not turn OFF embedded sdio cards as it support Wake on Wireless */
@@ -425,7 +425,7 @@ static void sdhci_set_adma_desc(u8 *desc, u32 addr, int len, unsigned cmd)
 }
 
 static int sdhci_adma_table_pre(struct sdhci_host *host,
-	struct mmc_data *data)
+	struct mmc_data *data, struct sdhci_dma_map *map)
 {
 	int direction;
 
@@ -455,23 +455,23 @@ static int sdhci_adma_table_pre(struct sdhci_host *host,
 	 * need to fill it with data first.
 	 */
 
-	host->align_addr = dma_map_single(mmc_dev(host->mmc),
-		host->align_buffer, 128 * 4, direction);
-	if (dma_mapping_error(mmc_dev(host->mmc), host->align_addr))
+	map->align_addr = dma_map_single(mmc_dev(host->mmc),
+		map->align_buffer, 128 * 4, direction);
+	if (dma_mapping_error(mmc_dev(host->mmc), map->align_addr))
 		goto fail;
-	BUG_ON(host->align_addr & 0x3);
+	BUG_ON(map->align_addr & 0x3);
 
-	host->sg_count = dma_map_sg(mmc_dev(host->mmc),
+	map->sg_count = dma_map_sg(mmc_dev(host->mmc),
 		data->sg, data->sg_len, direction);
-	if (host->sg_count == 0)
+	if (map->sg_count == 0)
 		goto unmap_align;
 
-	desc = host->adma_desc;
-	align = host->align_buffer;
+	desc = map->adma_desc;
+	align = map->align_buffer;
 
-	align_addr = host->align_addr;
+	align_addr = map->align_addr;
 
-	for_each_sg(data->sg, sg, host->sg_count, i) {
+	for_each_sg(data->sg, sg, map->sg_count, i) {
 		addr = sg_dma_address(sg);
 		len = sg_dma_len(sg);
 
@@ -515,14 +515,14 @@ static int sdhci_adma_table_pre(struct sdhci_host *host,
 		 * If this triggers then we have a calculation bug
 		 * somewhere. :/
 		 */
-		WARN_ON((desc - host->adma_desc) > (128 * 2 + 1) * 4);
+		WARN_ON((desc - map->adma_desc) > (128 * 2 + 1) * 4);
 	}
 
 	if (host->quirks & SDHCI_QUIRK_NO_ENDATTR_IN_NOPDESC) {
 		/*
 		* Mark the last descriptor as the terminating descriptor
 		*/
-		if (desc != host->adma_desc) {
+		if (desc != map->adma_desc) {
 			desc -= 8;
 			desc[0] |= 0x2; /* end */
 		}
@@ -540,14 +540,14 @@ static int sdhci_adma_table_pre(struct sdhci_host *host,
 	 */
 	if (data->flags & MMC_DATA_WRITE) {
 		dma_sync_single_for_device(mmc_dev(host->mmc),
-			host->align_addr, 128 * 4, direction);
+			map->align_addr, 128 * 4, direction);
 	}
 
-	host->adma_addr = dma_map_single(mmc_dev(host->mmc),
-		host->adma_desc, (128 * 2 + 1) * 4, DMA_TO_DEVICE);
-	if (dma_mapping_error(mmc_dev(host->mmc), host->adma_addr))
+	map->adma_addr = dma_map_single(mmc_dev(host->mmc),
+		map->adma_desc, (128 * 2 + 1) * 4, DMA_TO_DEVICE);
+	if (dma_mapping_error(mmc_dev(host->mmc), map->adma_addr))
 		goto unmap_entries;
-	BUG_ON(host->adma_addr & 0x3);
+	BUG_ON(map->adma_addr & 0x3);
 
 	return 0;
 
@@ -555,14 +555,14 @@ unmap_entries:
 	dma_unmap_sg(mmc_dev(host->mmc), data->sg,
 		data->sg_len, direction);
 unmap_align:
-	dma_unmap_single(mmc_dev(host->mmc), host->align_addr,
+	dma_unmap_single(mmc_dev(host->mmc), map->align_addr,
 		128 * 4, direction);
 fail:
 	return -EINVAL;
 }
 
 static void sdhci_adma_table_post(struct sdhci_host *host,
-	struct mmc_data *data)
+	struct mmc_data *data, struct sdhci_dma_map *map)
 {
 	int direction;
 
@@ -577,19 +577,19 @@ static void sdhci_adma_table_post(struct sdhci_host *host,
 	else
 		direction = DMA_TO_DEVICE;
 
-	dma_unmap_single(mmc_dev(host->mmc), host->adma_addr,
+	dma_unmap_single(mmc_dev(host->mmc), map->adma_addr,
 		(128 * 2 + 1) * 4, DMA_TO_DEVICE);
 
-	dma_unmap_single(mmc_dev(host->mmc), host->align_addr,
+	dma_unmap_single(mmc_dev(host->mmc), map->align_addr,
 		128 * 4, direction);
 
 	if (data->flags & MMC_DATA_READ) {
 		dma_sync_sg_for_cpu(mmc_dev(host->mmc), data->sg,
 			data->sg_len, direction);
 
-		align = host->align_buffer;
+		align = map->align_buffer;
 
-		for_each_sg(data->sg, sg, host->sg_count, i) {
+		for_each_sg(data->sg, sg, map->sg_count, i) {
 			if (sg_dma_address(sg) & 0x3) {
 				size = 4 - (sg_dma_address(sg) & 0x3);
 
@@ -607,6 +607,70 @@ static void sdhci_adma_table_post(struct sdhci_host *host,
 		data->sg_len, direction);
 }
 
+/*
+ * Map data for DMA into one of the two mapping slots: either the
+ * ADMA descriptor table and bounce buffer, or a plain SDMA mapping.
+ */
+static int sdhci_map_data(struct sdhci_host *host, struct mmc_data *data,
+	struct sdhci_dma_map *map)
+{
+	if (host->flags & SDHCI_USE_ADMA)
+		return sdhci_adma_table_pre(host, data, map);
+
+	map->sg_count = dma_map_sg(mmc_dev(host->mmc),
+			data->sg, data->sg_len,
+			(data->flags & MMC_DATA_READ) ?
+				DMA_FROM_DEVICE : DMA_TO_DEVICE);
+	return map->sg_count ? 0 : -EINVAL;
+}
+
+static void sdhci_unmap_data(struct sdhci_host *host, struct mmc_data *data,
+	struct sdhci_dma_map *map)
+{
+	if (host->flags & SDHCI_USE_ADMA)
+		sdhci_adma_table_post(host, data, map);
+	else
+		dma_unmap_sg(mmc_dev(host->mmc), data->sg,
+			data->sg_len, (data->flags & MMC_DATA_READ) ?
+				DMA_FROM_DEVICE : DMA_TO_DEVICE);
+}
+
+/*
+ * Called with host->lock held. pre_req cookies may not take the last slot,
+ * so a request that was not pre-mapped always finds one.
+ */
+static struct sdhci_dma_map *sdhci_get_dma_map(struct sdhci_host *host,
+	s32 cookie)
+{
+	int n = ARRAY_SIZE(host->dma_map);
+	int i;
+
+	if (cookie != SDHCI_MAP_REQ)
+		n--;
+
+	for (i = 0; i < n; i++) {
+		if (!host->dma_map[i].cookie) {
+			host->dma_map[i].cookie = cookie;
+			return &host->dma_map[i];
+		}
+	}
+
+	return NULL;
+}
+
+/* Called with host->lock held */
+static struct sdhci_dma_map *sdhci_find_dma_map(struct sdhci_host *host,
+	s32 cookie)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(host->dma_map); i++)
+		if (host->dma_map[i].cookie == cookie)
+			return &host->dma_map[i];
+
+	return NULL;
+}
+
 static u8 sdhci_calc_timeout(struct sdhci_host *host, struct mmc_command *cmd)
 {
 	u8 count;
@@ -768,36 +832,38 @@ static void sdhci_prepare_data(struct sdhci_host *host, struct mmc_command *cmd)
 	}
 
 	if (host->flags & SDHCI_REQ_USE_DMA) {
-		if (host->flags & SDHCI_USE_ADMA) {
-			ret = sdhci_adma_table_pre(host, data);
-			if (ret) {
-				/*
-				 * This only happens when someone fed
-				 * us an invalid request.
-				 */
-				WARN_ON(1);
-				host->flags &= ~SDHCI_REQ_USE_DMA;
-			} else {
-				sdhci_writel(host, host->adma_addr,
-					SDHCI_ADMA_ADDRESS);
+		struct sdhci_dma_map *map = NULL;
+
+		/* Use the mapping sdhci_pre_req() made, if any */
+		if (data->host_cookie > 0)
+			map = sdhci_find_dma_map(host, data->host_cookie);
+
+		if (!map) {
+			data->host_cookie = 0;
+			map = sdhci_get_dma_map(host, SDHCI_MAP_REQ);
+			if (map) {
+				ret = sdhci_map_data(host, data, map);
+				if (ret) {
+					/*
+					 * This only happens when someone fed
+					 * us an invalid request.
+					 */
+					WARN_ON(1);
+					map->cookie = 0;
+					map = NULL;
+				}
 			}
+		}
+
+		if (!map) {
+			host->flags &= ~SDHCI_REQ_USE_DMA;
 		} else {
-			int sg_cnt;
-
-			sg_cnt = dma_map_sg(mmc_dev(host->mmc),
-					data->sg, data->sg_len,
-					(data->flags & MMC_DATA_READ) ?
-						DMA_FROM_DEVICE :
-						DMA_TO_DEVICE);
-			if (sg_cnt == 0) {
-				/*
-				 * This only happens when someone fed
-				 * us an invalid request.
-				 */
-				WARN_ON(1);
-				host->flags &= ~SDHCI_REQ_USE_DMA;
+			host->dma_cur = map;
+			if (host->flags & SDHCI_USE_ADMA) {
+				sdhci_writel(host, map->adma_addr,
+					SDHCI_ADMA_ADDRESS);
 			} else {
-				WARN_ON(sg_cnt != 1);
+				WARN_ON(map->sg_count != 1);
 				sdhci_writel(host, sg_dma_address(data->sg),
 					SDHCI_DMA_ADDRESS);
 			}
@@ -883,14 +949,10 @@ static void sdhci_finish_data(struct sdhci_host *host)
 	data = host->data;
 	host->data = NULL;
 
-	if (host->flags & SDHCI_REQ_USE_DMA) {
-		if (host->flags & SDHCI_USE_ADMA)
-			sdhci_adma_table_post(host, data);
-		else {
-			dma_unmap_sg(mmc_dev(host->mmc), data->sg,
-				data->sg_len, (data->flags & MMC_DATA_READ) ?
-					DMA_FROM_DEVICE : DMA_TO_DEVICE);
-		}
+	/* Mappings made by sdhci_pre_req() are undone in sdhci_post_req() */
+	if ((host->flags & SDHCI_REQ_USE_DMA) && !data->host_cookie) {
+		sdhci_unmap_data(host, data, host->dma_cur);
+		host->dma_cur->cookie = 0;
 	}
 
 	/*
@@ -1271,6 +1333,82 @@ static void sdhci_request(struct mmc_host *mmc, struct mmc_request *mrq)
 	spin_unlock_irqrestore(&host->lock, flags);
 }
 
+/*
+ * Hosts that may fall back to PIO for a given sg list decide that in
+ * sdhci_prepare_data(), so they keep mapping on the request path.
+ */
+static bool sdhci_can_pre_map(struct sdhci_host *host)
+{
+	if (!(host->flags & (SDHCI_USE_SDMA | SDHCI_USE_ADMA)))
+		return false;
+
+	return !(host->quirks & (SDHCI_QUIRK_32BIT_DMA_ADDR |
+				 SDHCI_QUIRK_32BIT_DMA_SIZE |
+				 SDHCI_QUIRK_32BIT_ADMA_SIZE));
+}
+
+static void sdhci_pre_req(struct mmc_host *mmc, struct mmc_request *mrq,
+	bool is_first_req)
+{
+	struct sdhci_host *host = mmc_priv(mmc);
+	struct mmc_data *data = mrq->data;
+	struct sdhci_dma_map *map;
+	unsigned long flags;
+	s32 cookie;
+
+	if (!data)
+		return;
+
+	data->host_cookie = 0;
+	if (!sdhci_can_pre_map(host))
+		return;
+
+	spin_lock_irqsave(&host->lock, flags);
+	if (++host->dma_cookie <= 0)
+		host->dma_cookie = 1;
+	cookie = host->dma_cookie;
+	map = sdhci_get_dma_map(host, cookie);
+	spin_unlock_irqrestore(&host->lock, flags);
+
+	if (!map)
+		return;
+
+	if (sdhci_map_data(host, data, map)) {
+		spin_lock_irqsave(&host->lock, flags);
+		map->cookie = 0;
+		spin_unlock_irqrestore(&host->lock, flags);
+		return;
+	}
+
+	data->host_cookie = cookie;
+}
+
+static void sdhci_post_req(struct mmc_host *mmc, struct mmc_request *mrq,
+	int err)
+{
+	struct sdhci_host *host = mmc_priv(mmc);
+	struct mmc_data *data = mrq->data;
+	struct sdhci_dma_map *map;
+	unsigned long flags;
+
+	if (!data || data->host_cookie <= 0)
+		return;
+
+	spin_lock_irqsave(&host->lock, flags);
+	map = sdhci_find_dma_map(host, data->host_cookie);
+	spin_unlock_irqrestore(&host->lock, flags);
+
+	if (map) {
+		sdhci_unmap_data(host, data, map);
+
+		spin_lock_irqsave(&host->lock, flags);
+		map->cookie = 0;
+		spin_unlock_irqrestore(&host->lock, flags);
+	}
+
+	data->host_cookie = 0;
+}
+
 static void sdhci_set_ios(struct mmc_host *mmc, struct mmc_ios *ios)
 {
 	struct sdhci_host *host;
@@ -1877,6 +2015,8 @@ int sdhci_disable(struct mmc_host *mmc, int lazy)
 }
 
 static const struct mmc_host_ops sdhci_ops = {
+	.pre_req	= sdhci_pre_req,
+	.post_req	= sdhci_post_req,
 	.request	= sdhci_request,
 	.set_ios	= sdhci_set_ios,
 	.get_ro		= sdhci_get_ro,
@@ -2090,7 +2230,7 @@ static void sdhci_cmd_irq(struct sdhci_host *host, u32 intmask)
 static void sdhci_show_adma_error(struct sdhci_host *host)
 {
 	const char *name = mmc_hostname(host->mmc);
-	u8 *desc = host->adma_desc;
+	u8 *desc = host->dma_cur->adma_desc;
 	__le32 *dma;
 	__le16 *len;
 	u8 attr;
@@ -2439,7 +2579,7 @@ int sdhci_add_host(struct sdhci_host *host)
 	u32 caps[2];
 	u32 max_current_caps;
 	unsigned int ocr_avail;
-	int ret;
+	int ret, i;
 
 	WARN_ON(host == NULL);
 	if (host == NULL)
@@ -2508,11 +2648,22 @@ int sdhci_add_host(struct sdhci_host *host)
 		 * (128) and potentially one alignment transfer for
 		 * each of those entries.
 		 */
-		host->adma_desc = kmalloc((128 * 2 + 1) * 4, GFP_KERNEL);
-		host->align_buffer = kmalloc(128 * 4, GFP_KERNEL);
-		if (!host->adma_desc || !host->align_buffer) {
-			kfree(host->adma_desc);
-			kfree(host->align_buffer);
+		for (i = 0; i < ARRAY_SIZE(host->dma_map); i++) {
+			host->dma_map[i].adma_desc =
+				kmalloc((128 * 2 + 1) * 4, GFP_KERNEL);
+			host->dma_map[i].align_buffer =
+				kmalloc(128 * 4, GFP_KERNEL);
+			if (!host->dma_map[i].adma_desc ||
+			    !host->dma_map[i].align_buffer)
+				break;
+		}
+		if (i < ARRAY_SIZE(host->dma_map)) {
+			for (i = 0; i < ARRAY_SIZE(host->dma_map); i++) {
+				kfree(host->dma_map[i].adma_desc);
+				kfree(host->dma_map[i].align_buffer);
+				host->dma_map[i].adma_desc = NULL;
+				host->dma_map[i].align_buffer = NULL;
+			}
 			printk(KERN_WARNING "%s: Unable to allocate ADMA "
 				"buffers. Falling back to standard DMA.\n",
 				mmc_hostname(mmc));
@@ -2903,6 +3054,7 @@ EXPORT_SYMBOL_GPL(sdhci_add_host);
 void sdhci_remove_host(struct sdhci_host *host, int dead)
 {
 	unsigned long flags;
+	int i;
 
 	if (dead) {
 		spin_lock_irqsave(&host->lock, flags);
@@ -2945,11 +3097,13 @@ void sdhci_remove_host(struct sdhci_host *host, int dead)
 		regulator_put(host->vmmc);
 	}
 
-	kfree(host->adma_desc);
-	kfree(host->align_buffer);
+	for (i = 0; i < ARRAY_SIZE(host->dma_map); i++) {
+		kfree(host->dma_map[i].adma_desc);
+		kfree(host->dma_map[i].align_buffer);
 
-	host->adma_desc = NULL;
-	host->align_buffer = NULL;
+		host->dma_map[i].adma_desc = NULL;
+		host->dma_map[i].align_buffer = NULL;
+	}
 }
 
 EXPORT_SYMBOL_GPL(sdhci_remove_host);
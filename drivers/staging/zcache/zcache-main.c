@@ -29,6 +29,7 @@
 #include <linux/types.h>
 #include <linux/atomic.h>
 #include <linux/math64.h>
+#include <linux/workqueue.h>
 #include "tmem.h"
 
 #include "../zram/xvmalloc.h" /* if built in drivers/staging */
@@ -1146,9 +1147,18 @@ static atomic_t zcache_curr_eph_pampd_count = ATOMIC_INIT(0);
 static unsigned long zcache_curr_eph_pampd_count_max;
 static atomic_t zcache_curr_pers_pampd_count = ATOMIC_INIT(0);
 static unsigned long zcache_curr_pers_pampd_count_max;
+static unsigned long zcache_pers_pool_full;
+static unsigned long zcache_pers_written_back;
 
-/* forward reference */
+/* forward references */
 static int zcache_compress(struct page *from, void **out_va, size_t *out_len);
+#ifdef CONFIG_FRONTSWAP
+static void zcache_frontswap_pool_full(void);
+#else
+static inline void zcache_frontswap_pool_full(void)
+{
+}
+#endif
 
 static void *zcache_pampd_create(char *data, size_t size, bool raw, int eph,
 				struct tmem_pool *pool, struct tmem_oid *oid,
@@ -1184,8 +1194,10 @@ static void *zcache_pampd_create(char *data, size_t size, bool raw, int eph,
 		curr_pers_pampd_count =
 			atomic_read(&zcache_curr_pers_pampd_count);
 		if (curr_pers_pampd_count >
-		    (zv_page_count_policy_percent * totalram_pages) / 100)
+		    (zv_page_count_policy_percent * totalram_pages) / 100) {
+			zcache_frontswap_pool_full();
 			goto out;
+		}
 		ret = zcache_compress(page, &cdata, &clen);
 		if (ret == 0)
 			goto out;
@@ -1427,6 +1439,8 @@ ZCACHE_SYSFS_RO(aborted_preload);
 ZCACHE_SYSFS_RO(aborted_shrink);
 ZCACHE_SYSFS_RO(compress_poor);
 ZCACHE_SYSFS_RO(mean_compress_poor);
+ZCACHE_SYSFS_RO(pers_pool_full);
+ZCACHE_SYSFS_RO(pers_written_back);
 ZCACHE_SYSFS_RO_ATOMIC(zbud_curr_raw_pages);
 ZCACHE_SYSFS_RO_ATOMIC(zbud_curr_zpages);
 ZCACHE_SYSFS_RO_ATOMIC(curr_obj_count);
@@ -1453,6 +1467,8 @@ static struct attribute *zcache_attrs[] = {
 	&zcache_failed_pers_puts_attr.attr,
 	&zcache_compress_poor_attr.attr,
 	&zcache_mean_compress_poor_attr.attr,
+	&zcache_pers_pool_full_attr.attr,
+	&zcache_pers_written_back_attr.attr,
 	&zcache_zbud_curr_raw_pages_attr.attr,
 	&zcache_zbud_curr_zpages_attr.attr,
 	&zcache_zbud_curr_zbytes_attr.attr,
@@ -1872,6 +1888,36 @@ static void zcache_frontswap_flush_area(unsigned type)
 	}
 }
 
+/*
+ * Once the persistent pool reaches zv_page_count_policy_percent of RAM,
+ * every new swap page is turned away and goes to the swap device, while
+ * the pages already in the pool stay there until they are swapped in.
+ * Rather than let the pool silt up with the oldest pages, push a slice of
+ * it out to the swap device so that newer, hotter pages can be kept
+ * compressed.  This is done from a work item since bringing the pages
+ * back in needs to allocate and sleep, and the put path can do neither.
+ */
+#define ZCACHE_WRITEBACK_SLICE	16	/* write back 1/16th of the pool */
+
+static void zcache_frontswap_writeback(struct work_struct *work)
+{
+	unsigned long limit, target, count;
+
+	limit = (zv_page_count_policy_percent * totalram_pages) / 100;
+	target = limit - limit / ZCACHE_WRITEBACK_SLICE;
+	count = atomic_read(&zcache_curr_pers_pampd_count);
+	if (count > target)
+		zcache_pers_written_back += frontswap_writeback(count - target);
+}
+static DECLARE_WORK(zcache_frontswap_writeback_work,
+		    zcache_frontswap_writeback);
+
+static void zcache_frontswap_pool_full(void)
+{
+	zcache_pers_pool_full++;
+	schedule_work(&zcache_frontswap_writeback_work);
+}
+
 static void zcache_frontswap_init(unsigned ignored)
 {
 	/* a single tmem poolid is used for all frontswap "types" (swapfiles) */
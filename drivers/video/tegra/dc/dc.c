@@ -435,11 +435,19 @@ static int dbg_dc_stats_show(struct seq_file *s, void *unused)
 		"underflows: %llu\n"
 		"underflows_a: %llu\n"
 		"underflows_b: %llu\n"
-		"underflows_c: %llu\n",
+		"underflows_c: %llu\n"
+		"flips: %llu\n"
+		"partial_flips: %llu\n"
+		"bytes_last_flip: %llu\n"
+		"bytes_total: %llu\n",
 		dc->stats.underflows,
 		dc->stats.underflows_a,
 		dc->stats.underflows_b,
-		dc->stats.underflows_c);
+		dc->stats.underflows_c,
+		dc->stats.flips,
+		dc->stats.partial_flips,
+		dc->stats.bytes_last,
+		dc->stats.bytes_total);
 	mutex_unlock(&dc->lock);
 
 	return 0;
@@ -1082,13 +1090,172 @@ static inline u32 compute_initial_dda(fixed20_12 in)
 	return dfixed_frac(in);
 }
 
+static inline unsigned tegra_dc_out_bytes_per_pixel(struct tegra_dc *dc)
+{
+	/* outputs that do not specify a depth are 24bpp */
+	return dc->out->depth ? DIV_ROUND_UP(dc->out->depth, 8) : 3;
+}
+
+static inline bool tegra_dc_rect_equal(const struct tegra_dc_rect *a,
+				       const struct tegra_dc_rect *b)
+{
+	return a->x == b->x && a->y == b->y && a->w == b->w && a->h == b->h;
+}
+
+/* Only unscaled, linear, non-inverted RGB windows can be clipped to a
+ * partial update region without recomputing the DDA state. */
+static bool tegra_dc_win_can_clip(const struct tegra_dc_win *win)
+{
+	if (!WIN_IS_ENABLED(win))
+		return true;
+
+	return dfixed_trunc(win->w) == win->out_w &&
+		dfixed_trunc(win->h) == win->out_h &&
+		!WIN_IS_TILED(win) &&
+		!tegra_dc_is_yuv_planar(win->fmt) &&
+		!(win->flags & (TEGRA_WIN_FLAG_INVERT_H |
+				TEGRA_WIN_FLAG_INVERT_V));
+}
+
+/*
+ * Work out the region to send to the panel for this update.  The damage
+ * rectangle is clipped to the active area, aligned to even pixels and grown
+ * to satisfy the DISP_ACTIVE >= 16 constraint.  Returns true if the result
+ * is smaller than the full frame.
+ */
+static bool tegra_dc_calc_update_region(struct tegra_dc *dc,
+					struct tegra_dc_win *windows[], int n,
+					const struct tegra_dc_rect *damage,
+					struct tegra_dc_rect *region)
+{
+	unsigned h_active = dc->mode.h_active;
+	unsigned v_active = dc->mode.v_active;
+	unsigned long in_list = 0;
+	unsigned x0, y0, x1, y1;
+	int i;
+
+	region->x = 0;
+	region->y = 0;
+	region->w = h_active;
+	region->h = v_active;
+
+	if (!damage || !damage->w || !damage->h)
+		return false;
+
+	if (!(dc->out->flags & TEGRA_DC_OUT_ONE_SHOT_MODE) ||
+	    !dc->out_ops || !dc->out_ops->set_update_region || no_vsync)
+		return false;
+
+	for (i = 0; i < n; i++) {
+		if (!tegra_dc_win_can_clip(windows[i]))
+			return false;
+		if (WIN_IS_ENABLED(windows[i]))
+			in_list |= BIT(windows[i]->idx);
+	}
+
+	/* an enabled window that is not being updated would keep its full
+	 * frame position inside the smaller active area */
+	for (i = 0; i < dc->n_windows; i++)
+		if (WIN_IS_ENABLED(&dc->windows[i]) && !(in_list & BIT(i)))
+			return false;
+
+	/* x + w and y + h may wrap */
+	if (damage->x >= h_active || damage->w > h_active - damage->x ||
+	    damage->y >= v_active || damage->h > v_active - damage->y)
+		return false;
+
+	x0 = damage->x & ~1;
+	y0 = damage->y;
+	x1 = ALIGN(damage->x + damage->w, 2);
+	y1 = damage->y + damage->h;
+
+	if (x1 - x0 < 16) {
+		x1 = min(x0 + 16, h_active);
+		x0 = x1 - 16;
+	}
+	if (y1 - y0 < 16) {
+		y1 = min(y0 + 16, v_active);
+		y0 = y1 - 16;
+	}
+
+	if (x1 - x0 >= h_active && y1 - y0 >= v_active)
+		return false;
+
+	region->x = x0;
+	region->y = y0;
+	region->w = x1 - x0;
+	region->h = y1 - y0;
+
+	return true;
+}
+
+/* Program the output and DISP_ACTIVE for region, falling back to the full
+ * frame if the output refuses.  Must be called with dc->lock held. */
+static bool tegra_dc_program_update_region(struct tegra_dc *dc,
+					   struct tegra_dc_rect *region,
+					   bool partial)
+{
+	if (tegra_dc_rect_equal(region, &dc->update_region))
+		return partial;
+
+	if (dc->out_ops && dc->out_ops->set_update_region &&
+	    dc->out_ops->set_update_region(dc, region) < 0 && partial) {
+		region->x = 0;
+		region->y = 0;
+		region->w = dc->mode.h_active;
+		region->h = dc->mode.v_active;
+		partial = false;
+
+		if (tegra_dc_rect_equal(region, &dc->update_region))
+			return false;
+		dc->out_ops->set_update_region(dc, region);
+	}
+
+	tegra_dc_writel(dc, region->w | (region->h << 16),
+			DC_DISP_DISP_ACTIVE);
+	dc->update_region = *region;
+
+	return partial;
+}
+
 /* does not support updating windows on multiple dcs in one call */
 int tegra_dc_update_windows(struct tegra_dc_win *windows[], int n)
+{
+	return tegra_dc_update_windows_region(windows, n, NULL);
+}
+EXPORT_SYMBOL(tegra_dc_update_windows);
+
+/* Add the enabled windows that an earlier partial update left programmed
+ * relative to its region, so a full frame update puts them back. */
+static int tegra_dc_add_clipped_windows(struct tegra_dc *dc,
+					struct tegra_dc_win *windows[], int n,
+					struct tegra_dc_win *all[])
+{
+	unsigned long clipped = dc->clipped_wins;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		all[i] = windows[i];
+		clipped &= ~BIT(windows[i]->idx);
+	}
+
+	for_each_set_bit(i, &clipped, DC_N_WINDOWS)
+		if (WIN_IS_ENABLED(&dc->windows[i]))
+			all[n++] = &dc->windows[i];
+
+	return n;
+}
+
+int tegra_dc_update_windows_region(struct tegra_dc_win *windows[], int n,
+				   const struct tegra_dc_rect *damage)
 {
 	struct tegra_dc *dc;
+	struct tegra_dc_win *all[DC_N_WINDOWS];
+	struct tegra_dc_rect region;
 	unsigned long update_mask = GENERAL_ACT_REQ;
 	unsigned long val;
 	bool update_blend = false;
+	bool partial;
 	int i;
 
 	dc = windows[0]->dc;
@@ -1114,6 +1281,15 @@ int tegra_dc_update_windows(struct tegra_dc_win *windows[], int n)
 	else
 		tegra_dc_writel(dc, WRITE_MUX_ASSEMBLY | READ_MUX_ASSEMBLY, DC_CMD_STATE_ACCESS);
 
+	partial = tegra_dc_calc_update_region(dc, windows, n, damage, &region);
+	partial = tegra_dc_program_update_region(dc, &region, partial);
+
+	if (!partial && dc->clipped_wins) {
+		n = tegra_dc_add_clipped_windows(dc, windows, n, all);
+		windows = all;
+	}
+	dc->clipped_wins = 0;
+
 	for (i = 0; i < DC_N_WINDOWS; i++) {
 		tegra_dc_writel(dc, WINDOW_A_SELECT << i,
 					DC_CMD_DISPLAY_WINDOW_HEADER);
@@ -1135,6 +1311,9 @@ int tegra_dc_update_windows(struct tegra_dc_win *windows[], int n)
 		unsigned Bpp_bw = Bpp * (yuvp ? 2 : 1);
 		const bool filter_h = win_use_h_filter(win);
 		const bool filter_v = win_use_v_filter(win);
+		fixed20_12 x = win->x, y = win->y, w = win->w, h = win->h;
+		int out_x = win->out_x, out_y = win->out_y;
+		int out_w = win->out_w, out_h = win->out_h;
 
 		if (win->z != dc->blend.z[win->idx]) {
 			dc->blend.z[win->idx] = win->z;
@@ -1158,26 +1337,54 @@ int tegra_dc_update_windows(struct tegra_dc_win *windows[], int n)
 			continue;
 		}
 
+		if (partial) {
+			/* windows are unscaled here, so source and output
+			 * move together; positions become region relative */
+			int x0 = max_t(int, out_x, region.x);
+			int y0 = max_t(int, out_y, region.y);
+			int x1 = min_t(int, out_x + out_w,
+				       region.x + region.w);
+			int y1 = min_t(int, out_y + out_h,
+				       region.y + region.h);
+
+			if (x1 <= x0 || y1 <= y0) {
+				tegra_dc_writel(dc, 0, DC_WIN_WIN_OPTIONS);
+				dc->clipped_wins |= BIT(win->idx);
+				win->dirty = 1;
+				continue;
+			}
+
+			x.full += dfixed_const(x0 - out_x);
+			y.full += dfixed_const(y0 - out_y);
+			w.full = dfixed_const(x1 - x0);
+			h.full = dfixed_const(y1 - y0);
+			out_x = x0 - region.x;
+			out_y = y0 - region.y;
+			out_w = x1 - x0;
+			out_h = y1 - y0;
+			dc->clipped_wins |= BIT(win->idx);
+		}
+
 		tegra_dc_writel(dc, win->fmt, DC_WIN_COLOR_DEPTH);
 		tegra_dc_writel(dc, 0, DC_WIN_BYTE_SWAP);
 
 		tegra_dc_writel(dc,
-				V_POSITION(win->out_y) | H_POSITION(win->out_x),
+				V_POSITION(out_y) | H_POSITION(out_x),
 				DC_WIN_POSITION);
 		tegra_dc_writel(dc,
-				V_SIZE(win->out_h) | H_SIZE(win->out_w),
+				V_SIZE(out_h) | H_SIZE(out_w),
 				DC_WIN_SIZE);
 		tegra_dc_writel(dc,
-				V_PRESCALED_SIZE(dfixed_trunc(win->h)) |
-				H_PRESCALED_SIZE(dfixed_trunc(win->w) * Bpp),
+				V_PRESCALED_SIZE(dfixed_trunc(h)) |
+				H_PRESCALED_SIZE(dfixed_trunc(w) * Bpp),
 				DC_WIN_PRESCALED_SIZE);
 
-		h_dda = compute_dda_inc(win->w, win->out_w, false, Bpp_bw);
-		v_dda = compute_dda_inc(win->h, win->out_h, true, Bpp_bw);
+		h_dda = compute_dda_inc(w, out_w, false, Bpp_bw);
+		v_dda = compute_dda_inc(h, out_h, true, Bpp_bw);
 		tegra_dc_writel(dc, V_DDA_INC(v_dda) | H_DDA_INC(h_dda),
 				DC_WIN_DDA_INCREMENT);
-		h_dda = compute_initial_dda(win->x);
-		v_dda = compute_initial_dda(win->y);
+		h_dda = compute_initial_dda(x);
+		v_dda = compute_initial_dda(y);
 		tegra_dc_writel(dc, h_dda, DC_WIN_H_INITIAL_DDA);
 		tegra_dc_writel(dc, v_dda, DC_WIN_V_INITIAL_DDA);
 
@@ -1202,14 +1409,14 @@ int tegra_dc_update_windows(struct tegra_dc_win *windows[], int n)
 					DC_WIN_LINE_STRIDE);
 		}
 
-		h_offset = win->x;
+		h_offset = x;
 		if (invert_h) {
-			h_offset.full += win->w.full - dfixed_const(1);
+			h_offset.full += w.full - dfixed_const(1);
 		}
 
-		v_offset = win->y;
+		v_offset = y;
 		if (invert_v) {
-			v_offset.full += win->h.full - dfixed_const(1);
+			v_offset.full += h.full - dfixed_const(1);
 		}
 
 		tegra_dc_writel(dc, dfixed_trunc(h_offset) * Bpp,
@@ -1272,6 +1479,13 @@ int tegra_dc_update_windows(struct tegra_dc_win *windows[], int n)
 
 	tegra_dc_set_dynamic_emc(windows, n);
 
+	dc->stats.flips++;
+	if (partial)
+		dc->stats.partial_flips++;
+	dc->stats.bytes_last = (u64)region.w * region.h *
+		tegra_dc_out_bytes_per_pixel(dc);
+	dc->stats.bytes_total += dc->stats.bytes_last;
+
 	tegra_dc_writel(dc, update_mask << 8, DC_CMD_STATE_CONTROL);
 
 	tegra_dc_writel(dc, FRAME_END_INT | V_BLANK_INT, DC_CMD_INT_STATUS);
@@ -1303,7 +1517,7 @@ int tegra_dc_update_windows(struct tegra_dc_win *windows[], int n)
 
 	return 0;
 }
-EXPORT_SYMBOL(tegra_dc_update_windows);
+EXPORT_SYMBOL(tegra_dc_update_windows_region);
 
 u32 tegra_dc_get_syncpt_id(const struct tegra_dc *dc, int i)
 {
@@ -1683,6 +1897,10 @@ static int tegra_dc_program_mode(struct tegra_dc *dc, struct tegra_dc_mode *mode
 			DC_DISP_BACK_PORCH);
 	tegra_dc_writel(dc, mode->h_active | (mode->v_active << 16),
 			DC_DISP_DISP_ACTIVE);
+	dc->update_region.x = 0;
+	dc->update_region.y = 0;
+	dc->update_region.w = mode->h_active;
+	dc->update_region.h = mode->v_active;
 	tegra_dc_writel(dc, mode->h_front_porch | (mode->v_front_porch << 16),
 			DC_DISP_FRONT_PORCH);
 
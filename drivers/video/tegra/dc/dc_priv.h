@@ -68,6 +68,12 @@ struct tegra_dc_out_ops {
 	void (*suspend)(struct tegra_dc *dc);
 	/* resume output.  dc clocks are on at this point */
 	void (*resume)(struct tegra_dc *dc);
+
+	/* restrict the following one-shot transfers to rect.  dc clocks are
+	 * on and dc->lock is held.  returns < 0 if the output can not do
+	 * partial updates */
+	int (*set_update_region)(struct tegra_dc *dc,
+				 const struct tegra_dc_rect *rect);
 };
 
 struct tegra_dc {
@@ -129,8 +135,17 @@ struct tegra_dc {
 		u64			underflows_a;
 		u64			underflows_b;
 		u64			underflows_c;
+		u64			flips;
+		u64			partial_flips;
+		u64			bytes_last;
+		u64			bytes_total;
 	} stats;
 
+	/* region the output is currently programmed to transfer */
+	struct tegra_dc_rect		update_region;
+	/* windows programmed relative to a partial update_region */
+	unsigned long			clipped_wins;
+
 	struct tegra_dc_ext		*ext;
 
 #ifdef CONFIG_DEBUG_FS
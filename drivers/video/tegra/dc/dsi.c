@@ -140,6 +140,9 @@ struct tegra_dc_dsi_data {
 
 	u32 dsi_control_val;
 
+	/* width of the partial update window, 0 for the full mode width */
+	u32 update_width;
+
 	bool ulpm;
 	bool enabled;
 };
@@ -1090,8 +1093,8 @@ static void tegra_dsi_setup_cmd_mode_pkt_length(struct tegra_dc *dc,
 	unsigned long	val;
 	unsigned long	act_bytes;
 
-	act_bytes = dc->mode.h_active * dsi->pixel_scaler_mul /
-			dsi->pixel_scaler_div + 1;
+	act_bytes = (dsi->update_width ? : dc->mode.h_active) *
+			dsi->pixel_scaler_mul / dsi->pixel_scaler_div + 1;
 
 	val = DSI_PKT_LEN_0_1_LENGTH_0(0) | DSI_PKT_LEN_0_1_LENGTH_1(0);
 	tegra_dsi_writel(dsi, val, DSI_PKT_LEN_0_1);
@@ -2034,6 +2037,38 @@ static int tegra_dsi_send_panel_cmd(struct tegra_dc *dc,
 	return err;
 }
 
+/* Point the panel's frame memory writes at rect and shorten the DC driven
+ * line packets to match. */
+static int tegra_dsi_set_panel_window(struct tegra_dc *dc,
+					struct tegra_dc_dsi_data *dsi,
+					const struct tegra_dc_rect *rect)
+{
+	u16 x0 = rect->x, x1 = rect->x + rect->w - 1;
+	u16 y0 = rect->y, y1 = rect->y + rect->h - 1;
+	u8 col[] = {
+		DSI_SET_COLUMN_ADDRESS, x0 >> 8, x0 & 0xff, x1 >> 8, x1 & 0xff,
+	};
+	u8 page[] = {
+		DSI_SET_PAGE_ADDRESS, y0 >> 8, y0 & 0xff, y1 >> 8, y1 & 0xff,
+	};
+	int err;
+
+	dsi->update_width = rect->w;
+
+	err = tegra_dsi_write_data(dc, dsi, col,
+				dsi_command_long_write, ARRAY_SIZE(col));
+	if (err < 0)
+		return err;
+
+	err = tegra_dsi_write_data(dc, dsi, page,
+				dsi_command_long_write, ARRAY_SIZE(page));
+	if (err < 0)
+		return err;
+
+	tegra_dsi_set_pkt_length(dc, dsi);
+	return 0;
+}
+
 static u8 get_8bit_ecc(u32 header)
 {
 	char ecc_parity[24] = {
@@ -2594,6 +2629,20 @@ static void tegra_dc_dsi_enable(struct tegra_dc *dc)
 		dsi->enabled = true;
 	}
 
+	if (dsi->update_width && dsi->update_width != dc->mode.h_active) {
+		/* dc restarts with full frames; drop the partial window the
+		 * panel may still be using */
+		struct tegra_dc_rect full = {
+			.w = dc->mode.h_active,
+			.h = dc->mode.v_active,
+		};
+
+		if (tegra_dsi_set_panel_window(dc, dsi, &full) < 0)
+			dev_err(&dc->ndev->dev,
+				"dsi: failed to reset panel window\n");
+	}
+	dsi->update_width = 0;
+
 	if (dsi->status.driven == DSI_DRIVEN_MODE_DC)
 		tegra_dsi_start_dc_stream(dc, dsi);
 fail:
@@ -3051,11 +3100,36 @@ static void tegra_dc_dsi_resume(struct tegra_dc *dc)
 }
 #endif
 
+static int tegra_dc_dsi_set_update_region(struct tegra_dc *dc,
+					const struct tegra_dc_rect *rect)
+{
+	struct tegra_dc_dsi_data *dsi = tegra_dc_get_outdata(dc);
+	int err;
+
+	if (dsi->info.video_data_type != TEGRA_DSI_VIDEO_TYPE_COMMAND_MODE ||
+		!dsi->info.partial_update_supported)
+		return -EINVAL;
+
+	mutex_lock(&dsi->lock);
+	if (!dsi->enabled || dsi->ulpm) {
+		err = -EPERM;
+		goto fail;
+	}
+
+	err = tegra_dsi_set_panel_window(dc, dsi, rect);
+	if (err < 0)
+		dev_err(&dc->ndev->dev, "dsi: failed to set update region\n");
+fail:
+	mutex_unlock(&dsi->lock);
+	return err;
+}
+
 struct tegra_dc_out_ops tegra_dc_dsi_ops = {
 	.init = tegra_dc_dsi_init,
 	.destroy = tegra_dc_dsi_destroy,
 	.enable = tegra_dc_dsi_enable,
 	.disable = tegra_dc_dsi_disable,
+	.set_update_region = tegra_dc_dsi_set_update_region,
 #ifdef CONFIG_PM
 	.suspend = tegra_dc_dsi_suspend,
 	.resume = tegra_dc_dsi_resume,
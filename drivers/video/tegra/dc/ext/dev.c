@@ -55,6 +55,7 @@ struct tegra_dc_ext_flip_data {
 	struct tegra_dc_ext		*ext;
 	struct work_struct		work;
 	struct tegra_dc_ext_flip_win	win[DC_N_WINDOWS];
+	struct tegra_dc_rect		damage;
 };
 
 int tegra_dc_ext_get_num_outputs(void)
@@ -273,7 +274,7 @@ static void tegra_dc_ext_flip_worker(struct work_struct *work)
 		wins[nr_win++] = win;
 	}
 
-	tegra_dc_update_windows(wins, nr_win);
+	tegra_dc_update_windows_region(wins, nr_win, &data->damage);
 	/* TODO: implement swapinterval here */
 	tegra_dc_sync_windows(wins, nr_win);
 
@@ -395,7 +396,8 @@ static int sanitize_flip_args(struct tegra_dc_ext_user *user,
 }
 
 static int tegra_dc_ext_flip(struct tegra_dc_ext_user *user,
-			     struct tegra_dc_ext_flip *args)
+			     struct tegra_dc_ext_flip *args,
+			     const struct tegra_dc_rect *damage)
 {
 	struct tegra_dc_ext *ext = user->ext;
 	struct tegra_dc_ext_flip_data *data;
@@ -420,6 +422,8 @@ static int tegra_dc_ext_flip(struct tegra_dc_ext_user *user,
 
 	INIT_WORK(&data->work, tegra_dc_ext_flip_worker);
 	data->ext = ext;
+	if (damage)
+		data->damage = *damage;
 
 #ifdef CONFIG_ANDROID
 	for (i = 0; i < DC_N_WINDOWS; i++) {
@@ -683,7 +687,29 @@ static long tegra_dc_ioctl(struct file *filp, unsigned int cmd,
 		if (copy_from_user(&args, user_arg, sizeof(args)))
 			return -EFAULT;
 
-		ret = tegra_dc_ext_flip(user, &args);
+		ret = tegra_dc_ext_flip(user, &args, NULL);
+
+		if (copy_to_user(user_arg, &args, sizeof(args)))
+			return -EFAULT;
+
+		return ret;
+	}
+
+	case TEGRA_DC_EXT_FLIP_DAMAGE:
+	{
+		struct tegra_dc_ext_flip_damage args;
+		struct tegra_dc_rect damage;
+		int ret;
+
+		if (copy_from_user(&args, user_arg, sizeof(args)))
+			return -EFAULT;
+
+		damage.x = args.damage_x;
+		damage.y = args.damage_y;
+		damage.w = args.damage_w;
+		damage.h = args.damage_h;
+
+		ret = tegra_dc_ext_flip(user, &args.flip, &damage);
 
 		if (copy_to_user(user_arg, &args, sizeof(args)))
 			return -EFAULT;
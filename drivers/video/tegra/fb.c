@@ -258,11 +258,33 @@ static void tegra_fb_imageblit(struct fb_info *info,
 
 static int tegra_fb_ioctl(struct fb_info *info, unsigned int cmd, unsigned long arg)
 {
+	struct tegra_fb_info *tegra_fb = info->par;
 	struct tegra_fb_modedb modedb;
+	struct tegra_fb_damage damage;
+	struct tegra_dc_rect rect;
 	struct fb_modelist *modelist;
 	int i;
 
 	switch (cmd) {
+	case FBIO_TEGRA_DAMAGE:
+		if (copy_from_user(&damage, (void __user *)arg, sizeof(damage)))
+			return -EFAULT;
+
+		/* the window belongs to a tegra_dc_ext client */
+		if (tegra_fb->win->cur_handle)
+			return -EBUSY;
+
+		rect.x = damage.x;
+		rect.y = damage.y;
+		rect.w = damage.w;
+		rect.h = damage.h;
+
+		i = tegra_dc_update_windows_region(&tegra_fb->win, 1, &rect);
+		if (i)
+			return i;
+		tegra_dc_sync_windows(&tegra_fb->win, 1);
+		break;
+
 	case FBIO_TEGRA_GET_MODEDB:
 		if (copy_from_user(&modedb, (void __user *)arg, sizeof(modedb)))
 			return -EFAULT;
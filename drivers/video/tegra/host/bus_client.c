@@ -27,6 +27,7 @@
 #include <linux/file.h>
 #include <linux/clk.h>
 #include <linux/hrtimer.h>
+#include <linux/ktime.h>
 
 #include <trace/events/nvhost.h>
 
@@ -83,8 +84,13 @@ struct nvhost_channel_userctx {
 	u32 timeout;
 	u32 priority;
 	int clientid;
+	ktime_t submit_start;
 };
 
+/* user arrays of the single-call submit are copied in batches of this many
+ * entries through the stack */
+#define SUBMIT_COPY_BATCH 16
+
 /*
  * Write cmdbuf to ftrace output. Checks if cmdbuf contents should be output
  * and mmaps the cmdbuf contents if required.
@@ -212,6 +218,7 @@ static int set_submit(struct nvhost_channel_userctx *ctx)
 	if (ctx->hdr.submit_version >= NVHOST_SUBMIT_VERSION_V2)
 		ctx->num_relocshifts = ctx->hdr.num_relocs;
 
+	ctx->submit_start = ktime_get();
 	return 0;
 }
 
@@ -372,6 +379,152 @@ static int nvhost_ioctl_channel_flush(
 	if (err)
 		nvhost_job_unpin(ctx->job);
 
+	/* CPU time from the submit header to kickoff */
+	trace_nvhost_channel_submit_cost(ctx->ch->dev->name,
+		ctx->job->num_gathers,
+		ctx->job->num_pins - ctx->job->num_gathers,
+		ctx->job->num_waitchk,
+		(u32)ktime_us_delta(ktime_get(), ctx->submit_start));
+
+	return err;
+}
+
+static int submit_copy_cmdbufs(struct nvhost_channel_userctx *ctx,
+		const struct nvhost_cmdbuf __user *ucmdbufs, u32 num)
+{
+	struct nvhost_cmdbuf cmdbufs[SUBMIT_COPY_BATCH];
+	const char *chname = ctx->ch->dev->name;
+	u32 n, i;
+
+	while (num) {
+		n = min_t(u32, num, SUBMIT_COPY_BATCH);
+		if (copy_from_user(cmdbufs, ucmdbufs, n * sizeof(*cmdbufs)))
+			return -EFAULT;
+
+		for (i = 0; i < n; i++) {
+			trace_nvhost_channel_write_cmdbuf(chname,
+				cmdbufs[i].mem, cmdbufs[i].words,
+				cmdbufs[i].offset);
+			nvhost_job_add_gather(ctx->job, cmdbufs[i].mem,
+				cmdbufs[i].words, cmdbufs[i].offset);
+		}
+		ucmdbufs += n;
+		num -= n;
+	}
+	return 0;
+}
+
+static int submit_copy_relocs(struct nvhost_channel_userctx *ctx,
+		const struct nvhost_reloc __user *urelocs,
+		const struct nvhost_reloc_shift __user *ushifts, u32 num)
+{
+	struct nvhost_reloc relocs[SUBMIT_COPY_BATCH];
+	struct nvhost_reloc_shift shifts[SUBMIT_COPY_BATCH];
+	struct nvhost_job *job = ctx->job;
+	struct nvmap_pinarray_elem *pin;
+	u32 n, i;
+
+	while (num) {
+		n = min_t(u32, num, SUBMIT_COPY_BATCH);
+		if (copy_from_user(relocs, urelocs, n * sizeof(*relocs)))
+			return -EFAULT;
+		if (ushifts &&
+		    copy_from_user(shifts, ushifts, n * sizeof(*shifts)))
+			return -EFAULT;
+
+		for (i = 0; i < n; i++) {
+			pin = &job->pinarray[job->num_pins++];
+			pin->patch_mem = relocs[i].cmdbuf_mem;
+			pin->patch_offset = relocs[i].cmdbuf_offset;
+			pin->pin_mem = relocs[i].target;
+			pin->pin_offset = relocs[i].target_offset;
+			pin->reloc_shift = ushifts ? shifts[i].shift : 0;
+		}
+		urelocs += n;
+		if (ushifts)
+			ushifts += n;
+		num -= n;
+	}
+	return 0;
+}
+
+static int nvhost_ioctl_channel_submit(struct nvhost_channel_userctx *ctx,
+		struct nvhost_submit_args *args)
+{
+	struct nvhost_submit_hdr_ext *hdr = &ctx->hdr;
+	struct nvhost_job *job;
+	struct nvhost_get_param_args fence;
+	const struct nvhost_reloc_shift __user *ushifts = NULL;
+	int err;
+
+	if (hdr->num_relocs || ctx->num_relocshifts ||
+	    hdr->num_cmdbufs || hdr->num_waitchks) {
+		reset_submit(ctx);
+		dev_err(&ctx->ch->dev->dev, "channel submit out of sync\n");
+		return -EIO;
+	}
+
+	if (args->submit_version > NVHOST_SUBMIT_VERSION_MAX_SUPPORTED) {
+		dev_err(&ctx->ch->dev->dev,
+			"submit version %d > max supported %d\n",
+			args->submit_version,
+			NVHOST_SUBMIT_VERSION_MAX_SUPPORTED);
+		return -EINVAL;
+	}
+
+	memset(hdr, 0, sizeof(*hdr));
+	hdr->syncpt_id = args->syncpt_id;
+	hdr->syncpt_incrs = args->syncpt_incrs;
+	hdr->num_cmdbufs = args->num_cmdbufs;
+	hdr->num_relocs = args->num_relocs;
+	hdr->submit_version = args->submit_version;
+	hdr->num_waitchks = args->num_waitchks;
+	hdr->waitchk_mask = args->waitchk_mask;
+
+	err = set_submit(ctx);
+	if (err)
+		goto out;
+	job = ctx->job;
+
+	trace_nvhost_ioctl_channel_submit(ctx->ch->dev->name,
+		hdr->submit_version, hdr->num_cmdbufs, hdr->num_relocs,
+		hdr->num_waitchks, hdr->syncpt_id, hdr->syncpt_incrs);
+
+	/* gathers take the first pin slots, relocs follow them */
+	err = submit_copy_cmdbufs(ctx,
+		(const struct nvhost_cmdbuf __user *)(unsigned long)args->cmdbufs,
+		hdr->num_cmdbufs);
+	if (err)
+		goto out;
+
+	if (hdr->submit_version >= NVHOST_SUBMIT_VERSION_V2)
+		ushifts = (const struct nvhost_reloc_shift __user *)
+			(unsigned long)args->reloc_shifts;
+	err = submit_copy_relocs(ctx,
+		(const struct nvhost_reloc __user *)(unsigned long)args->relocs,
+		ushifts, hdr->num_relocs);
+	if (err)
+		goto out;
+
+	if (hdr->num_waitchks) {
+		if (copy_from_user(job->waitchk,
+				(const void __user *)(unsigned long)args->waitchks,
+				hdr->num_waitchks *
+				sizeof(struct nvhost_waitchk))) {
+			err = -EFAULT;
+			goto out;
+		}
+		job->num_waitchk = hdr->num_waitchks;
+	}
+
+	/* the whole job is in; let the flush path pin and kick it off */
+	reset_submit(ctx);
+	err = nvhost_ioctl_channel_flush(ctx, &fence, 0);
+	args->fence = fence.value;
+	return err;
+
+out:
+	reset_submit(ctx);
 	return err;
 }
 
@@ -511,6 +664,9 @@ static long nvhost_channelctl(struct file *filp,
 		priv->priority =
 			(u32)((struct nvhost_set_priority_args *)buf)->priority;
 		break;
+	case NVHOST_IOCTL_CHANNEL_SUBMIT:
+		err = nvhost_ioctl_channel_submit(priv, (void *)buf);
+		break;
 	default:
 		err = -ENOTTY;
 		break;
@@ -21,6 +21,7 @@
 #include <linux/seq_file.h>
 
 #include <linux/io.h>
+#include <linux/math64.h>
 
 #include "dev.h"
 #include "debug.h"
@@ -84,6 +85,17 @@ static void show_syncpts(struct nvhost_master *m, struct output *o)
 				min, max);
 	}
 
+	for (i = 0; i < m->syncpt.nb_pts; i++) {
+		struct nvhost_intr_syncpt_stats *st = &m->intr.syncpt[i].stats;
+		if (!st->waits)
+			continue;
+		nvhost_debug_output(o, "id %d irqs %u coalesced %u waits %u "
+				"latency avg %lluus max %uus\n",
+				i, st->irqs, st->coalesced, st->waits,
+				div_u64(st->latency_total_us, st->waits),
+				st->latency_max_us);
+	}
+
 	for (i = 0; i < m->syncpt.nb_bases; i++) {
 		u32 base_val;
 		base_val = nvhost_syncpt_read_wait_base(&m->syncpt, i);
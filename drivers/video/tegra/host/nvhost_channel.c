@@ -38,6 +38,10 @@ int nvhost_channel_init(struct nvhost_channel *ch,
 	void __iomem *regs = NULL;
 	struct resource *reg_mem = NULL;
 
+	spin_lock_init(&ch->job_pool_lock);
+	INIT_LIST_HEAD(&ch->job_pool);
+	ch->job_pool_count = 0;
+
 	/* Link nvhost_device to nvhost_channel */
 	err = host_channel_op(dev).init(ch, dev, index);
 	if (err < 0) {
@@ -135,6 +139,7 @@ void nvhost_putchannel(struct nvhost_channel *ch, struct nvhost_hwctx *ctx)
 		channel_cdma_op(ch).stop(&ch->cdma);
 		nvhost_cdma_deinit(&ch->cdma);
 		nvhost_module_suspend(ch->dev, false);
+		nvhost_job_pool_drain(ch);
 	}
 	ch->refcount--;
 	mutex_unlock(&ch->reflock);
@@ -58,6 +58,11 @@ struct nvhost_channel {
 	struct cdev cdev;
 	struct nvhost_hwctx_handler *ctxhandler;
 	struct nvhost_cdma cdma;
+
+	/* completed jobs kept for reuse by the next submits */
+	spinlock_t job_pool_lock;
+	struct list_head job_pool;
+	int job_pool_count;
 };
 
 int nvhost_channel_init(
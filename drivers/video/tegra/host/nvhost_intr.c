@@ -23,6 +23,7 @@
 #include <linux/interrupt.h>
 #include <linux/slab.h>
 #include <linux/irq.h>
+#include <linux/ktime.h>
 #include <trace/events/nvhost.h>
 
 
@@ -32,13 +33,15 @@
 /*** Wait list management ***/
 
 struct nvhost_waitlist {
-	struct list_head list;
+	struct rb_node node;	/* in syncpt->wait_tree while pending */
+	struct list_head list;	/* in a completed list while handled */
 	struct kref refcount;
 	u32 thresh;
 	enum nvhost_intr_action action;
 	atomic_t state;
 	void *data;
 	int count;
+	ktime_t added;
 };
 
 enum waitlist_state {
@@ -53,40 +56,63 @@ static void waiter_release(struct kref *kref)
 	kfree(container_of(kref, struct nvhost_waitlist, refcount));
 }
 
+static inline struct nvhost_waitlist *first_waiter(struct rb_root *tree)
+{
+	struct rb_node *node = rb_first(tree);
+
+	return node ? rb_entry(node, struct nvhost_waitlist, node) : NULL;
+}
+
 /**
- * add a waiter to a waiter queue, sorted by threshold
- * returns true if it was added at the head of the queue
+ * add a waiter to a syncpt's waiter tree, sorted by threshold
+ * waiters with equal thresholds are kept in the order they were added
+ * returns true if it became the waiter with the lowest threshold
  */
 static bool add_waiter_to_queue(struct nvhost_waitlist *waiter,
-				struct list_head *queue)
+				struct rb_root *tree)
 {
+	struct rb_node **p = &tree->rb_node;
+	struct rb_node *parent = NULL;
 	struct nvhost_waitlist *pos;
 	u32 thresh = waiter->thresh;
-
-	list_for_each_entry_reverse(pos, queue, list)
-		if ((s32)(pos->thresh - thresh) <= 0) {
-			list_add(&waiter->list, &pos->list);
-			return false;
+	bool leftmost = true;
+
+	while (*p) {
+		parent = *p;
+		pos = rb_entry(parent, struct nvhost_waitlist, node);
+		/* pending thresholds are all within 2^31 of the current
+		 * syncpt value, so wrapping comparison is a total order */
+		if ((s32)(thresh - pos->thresh) < 0) {
+			p = &parent->rb_left;
+		} else {
+			p = &parent->rb_right;
+			leftmost = false;
 		}
+	}
 
-	list_add(&waiter->list, queue);
-	return true;
+	rb_link_node(&waiter->node, parent, p);
+	rb_insert_color(&waiter->node, tree);
+	return leftmost;
 }
 
 /**
- * run through a waiter queue for a single sync point ID
+ * run through a waiter tree for a single sync point ID
  * and gather all completed waiters into lists by actions
  */
-static void remove_completed_waiters(struct list_head *head, u32 sync,
+static void remove_completed_waiters(struct nvhost_intr_syncpt *syncpt,
+			u32 sync,
 			struct list_head completed[NVHOST_INTR_ACTION_COUNT])
 {
 	struct list_head *dest;
-	struct nvhost_waitlist *waiter, *next, *prev;
+	struct nvhost_waitlist *waiter, *prev;
+	ktime_t now = ktime_get();
+	u32 latency;
 
-	list_for_each_entry_safe(waiter, next, head, list) {
+	while ((waiter = first_waiter(&syncpt->wait_tree))) {
 		if ((s32)(waiter->thresh - sync) > 0)
 			break;
 
+		rb_erase(&waiter->node, &syncpt->wait_tree);
 		dest = completed + waiter->action;
 
 		/* consolidate submit cleanups */
@@ -101,21 +127,29 @@ static void remove_completed_waiters(struct list_head *head, u32 sync,
 		}
 
 		/* PENDING->REMOVED or CANCELLED->HANDLED */
-		if (atomic_inc_return(&waiter->state) == WLS_HANDLED || !dest) {
-			list_del(&waiter->list);
-			kref_put(&waiter->refcount, waiter_release);
-		} else {
-			list_move_tail(&waiter->list, dest);
+		if (atomic_inc_return(&waiter->state) == WLS_HANDLED)
+			goto put;
+
+		latency = (u32)ktime_us_delta(now, waiter->added);
+		syncpt->stats.waits++;
+		syncpt->stats.latency_total_us += latency;
+		syncpt->stats.latency_max_us =
+			max(syncpt->stats.latency_max_us, latency);
+
+		if (dest) {
+			list_add_tail(&waiter->list, dest);
+			continue;
 		}
+put:
+		kref_put(&waiter->refcount, waiter_release);
 	}
 }
 
 void reset_threshold_interrupt(struct nvhost_intr *intr,
-			       struct list_head *head,
+			       struct rb_root *tree,
 			       unsigned int id)
 {
-	u32 thresh = list_first_entry(head,
-				struct nvhost_waitlist, list)->thresh;
+	u32 thresh = first_waiter(tree)->thresh;
 	BUG_ON(!(intr_op(intr).set_syncpt_threshold &&
 		 intr_op(intr).enable_syncpt_intr));
 
@@ -194,7 +228,9 @@ static int process_wait_list(struct nvhost_intr *intr,
 			     struct nvhost_intr_syncpt *syncpt,
 			     u32 threshold)
 {
+	struct nvhost_master *dev = intr_to_dev(intr);
 	struct list_head completed[NVHOST_INTR_ACTION_COUNT];
+	struct nvhost_waitlist *first;
 	unsigned int i;
 	int empty;
 
@@ -203,11 +239,23 @@ static int process_wait_list(struct nvhost_intr *intr,
 
 	spin_lock(&syncpt->lock);
 
-	remove_completed_waiters(&syncpt->wait_head, threshold, completed);
+	syncpt->stats.irqs++;
+	remove_completed_waiters(syncpt, threshold, completed);
 
-	empty = list_empty(&syncpt->wait_head);
+	/* the syncpt may have moved past the next threshold meanwhile;
+	 * complete those waiters in this pass instead of arming the
+	 * threshold and taking another interrupt for each of them */
+	while ((first = first_waiter(&syncpt->wait_tree))) {
+		threshold = nvhost_syncpt_update_min(&dev->syncpt, syncpt->id);
+		if ((s32)(first->thresh - threshold) > 0)
+			break;
+		syncpt->stats.coalesced++;
+		remove_completed_waiters(syncpt, threshold, completed);
+	}
+
+	empty = RB_EMPTY_ROOT(&syncpt->wait_tree);
 	if (!empty)
-		reset_threshold_interrupt(intr, &syncpt->wait_head,
+		reset_threshold_interrupt(intr, &syncpt->wait_tree,
 					  syncpt->id);
 
 	spin_unlock(&syncpt->lock);
@@ -268,6 +316,7 @@ int nvhost_intr_add_action(struct nvhost_intr *intr, u32 id, u32 thresh,
 		 intr_op(intr).enable_syncpt_intr));
 
 	/* initialize a new waiter */
+	RB_CLEAR_NODE(&waiter->node);
 	INIT_LIST_HEAD(&waiter->list);
 	kref_init(&waiter->refcount);
 	if (ref)
@@ -277,6 +326,7 @@ int nvhost_intr_add_action(struct nvhost_intr *intr, u32 id, u32 thresh,
 	atomic_set(&waiter->state, WLS_PENDING);
 	waiter->data = data;
 	waiter->count = 1;
+	waiter->added = ktime_get();
 
 	BUG_ON(id >= intr_to_dev(intr)->syncpt.nb_pts);
 	syncpt = intr->syncpt + id;
@@ -300,9 +350,9 @@ int nvhost_intr_add_action(struct nvhost_intr *intr, u32 id, u32 thresh,
 		spin_lock(&syncpt->lock);
 	}
 
-	queue_was_empty = list_empty(&syncpt->wait_head);
+	queue_was_empty = RB_EMPTY_ROOT(&syncpt->wait_tree);
 
-	if (add_waiter_to_queue(waiter, &syncpt->wait_head)) {
+	if (add_waiter_to_queue(waiter, &syncpt->wait_tree)) {
 		/* added at head of list - new threshold value */
 		intr_op(intr).set_syncpt_threshold(intr, id, thresh);
 
@@ -336,6 +386,103 @@ void nvhost_intr_put_ref(struct nvhost_intr *intr, void *ref)
 }
 
 
+/*** Waiter tree self-test ***/
+
+#ifdef CONFIG_TEGRA_GRHOST_INTR_SELFTEST
+#define SELFTEST_WAITERS	64
+#define SELFTEST_THRESHOLDS	(SELFTEST_WAITERS / 2)
+
+/*
+ * Runs the waiter tree through add / remove_completed_waiters without
+ * touching host1x: thresholds straddle the 32-bit wrap, every threshold is
+ * used twice, and waiters are added in scrambled order. Checks that the
+ * tree yields them in threshold order, FIFO within a threshold, and that
+ * exactly the completed ones are removed.
+ */
+static int nvhost_intr_selftest(void)
+{
+	struct nvhost_intr_syncpt syncpt;
+	struct list_head completed[NVHOST_INTR_ACTION_COUNT];
+	struct list_head *done = &completed[NVHOST_INTR_ACTION_WAKEUP];
+	struct nvhost_waitlist *waiter, *next, *prev = NULL;
+	struct rb_node *node;
+	u32 base = 0xfffffff0;
+	u32 sync = base + SELFTEST_THRESHOLDS / 2;
+	u32 min = 0;
+	unsigned int i, nr_done = 0;
+	int err = 0;
+
+	memset(&syncpt, 0, sizeof(syncpt));
+	syncpt.wait_tree = RB_ROOT;
+	for (i = 0; i < NVHOST_INTR_ACTION_COUNT; ++i)
+		INIT_LIST_HEAD(completed + i);
+
+	for (i = 0; i < SELFTEST_WAITERS; ++i) {
+		bool leftmost;
+
+		waiter = nvhost_intr_alloc_waiter();
+		if (!waiter) {
+			err = -ENOMEM;
+			goto out;
+		}
+		RB_CLEAR_NODE(&waiter->node);
+		INIT_LIST_HEAD(&waiter->list);
+		kref_init(&waiter->refcount);
+		atomic_set(&waiter->state, WLS_PENDING);
+		waiter->action = NVHOST_INTR_ACTION_WAKEUP;
+		waiter->thresh = base + 1 + (i * 5) % SELFTEST_THRESHOLDS;
+		waiter->count = i;	/* insertion order */
+		waiter->added = ktime_get();
+
+		leftmost = add_waiter_to_queue(waiter, &syncpt.wait_tree);
+		if (leftmost != (i == 0 || (s32)(waiter->thresh - min) < 0))
+			err = -EINVAL;
+		if (leftmost)
+			min = waiter->thresh;
+	}
+
+	for (node = rb_first(&syncpt.wait_tree); node; node = rb_next(node)) {
+		waiter = rb_entry(node, struct nvhost_waitlist, node);
+		if (prev && ((s32)(waiter->thresh - prev->thresh) < 0 ||
+			     (waiter->thresh == prev->thresh &&
+			      waiter->count < prev->count)))
+			err = -EINVAL;
+		prev = waiter;
+	}
+
+	remove_completed_waiters(&syncpt, sync, completed);
+
+	list_for_each_entry(waiter, done, list) {
+		if ((s32)(waiter->thresh - sync) > 0)
+			err = -EINVAL;
+		nr_done++;
+	}
+	waiter = first_waiter(&syncpt.wait_tree);
+	if (nr_done != SELFTEST_WAITERS / 2 || syncpt.stats.waits != nr_done ||
+	    !waiter || (s32)(waiter->thresh - sync) <= 0)
+		err = -EINVAL;
+
+out:
+	/* drain everything that is left */
+	remove_completed_waiters(&syncpt, base + SELFTEST_THRESHOLDS, completed);
+	if (!RB_EMPTY_ROOT(&syncpt.wait_tree))
+		err = -EINVAL;
+
+	list_for_each_entry_safe(waiter, next, done, list) {
+		list_del(&waiter->list);
+		kref_put(&waiter->refcount, waiter_release);
+	}
+
+	return err;
+}
+#else
+static inline int nvhost_intr_selftest(void)
+{
+	return 0;
+}
+#endif
+
+
 /*** Init & shutdown ***/
 
 int nvhost_intr_init(struct nvhost_intr *intr, u32 irq_gen, u32 irq_sync)
@@ -346,6 +493,9 @@ int nvhost_intr_init(struct nvhost_intr *intr, u32 irq_gen, u32 irq_sync)
 		container_of(intr, struct nvhost_master, intr);
 	u32 nb_pts = host->syncpt.nb_pts;
 
+	if (nvhost_intr_selftest())
+		pr_err("%s: waiter tree self-test failed\n", __func__);
+
 	mutex_init(&intr->mutex);
 	intr->host_general_irq = irq_gen;
 	intr->host_general_irq_requested = false;
@@ -358,7 +508,8 @@ int nvhost_intr_init(struct nvhost_intr *intr, u32 irq_gen, u32 irq_sync)
 		syncpt->irq = irq_sync + id;
 		syncpt->irq_requested = 0;
 		spin_lock_init(&syncpt->lock);
-		INIT_LIST_HEAD(&syncpt->wait_head);
+		syncpt->wait_tree = RB_ROOT;
+		memset(&syncpt->stats, 0, sizeof(syncpt->stats));
 		snprintf(syncpt->thresh_irq_name,
 			sizeof(syncpt->thresh_irq_name),
 			"host_sp_%02d", id);
@@ -405,16 +556,19 @@ void nvhost_intr_stop(struct nvhost_intr *intr)
 	for (id = 0, syncpt = intr->syncpt;
 	     id < nb_pts;
 	     ++id, ++syncpt) {
-		struct nvhost_waitlist *waiter, *next;
-		list_for_each_entry_safe(waiter, next, &syncpt->wait_head, list) {
+		struct nvhost_waitlist *waiter;
+		struct rb_node *node, *next;
+		for (node = rb_first(&syncpt->wait_tree); node; node = next) {
+			next = rb_next(node);
+			waiter = rb_entry(node, struct nvhost_waitlist, node);
 			if (atomic_cmpxchg(&waiter->state, WLS_CANCELLED, WLS_HANDLED)
 				== WLS_CANCELLED) {
-				list_del(&waiter->list);
+				rb_erase(node, &syncpt->wait_tree);
 				kref_put(&waiter->refcount, waiter_release);
 			}
 		}
 
-		if (!list_empty(&syncpt->wait_head)) {  /* output diagnostics */
+		if (!RB_EMPTY_ROOT(&syncpt->wait_tree)) {  /* output diagnostics */
 			printk(KERN_DEBUG "%s id=%d\n", __func__, id);
 			BUG_ON(1);
 		}
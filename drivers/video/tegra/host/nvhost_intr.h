@@ -24,6 +24,7 @@
 #include <linux/kthread.h>
 #include <linux/semaphore.h>
 #include <linux/interrupt.h>
+#include <linux/rbtree.h>
 
 struct nvhost_channel;
 
@@ -57,13 +58,22 @@ enum nvhost_intr_action {
 
 struct nvhost_intr;
 
+struct nvhost_intr_syncpt_stats {
+	u32 irqs;		/* threshold interrupts serviced */
+	u32 coalesced;		/* thresholds completed without an interrupt */
+	u32 waits;		/* waiters completed */
+	u32 latency_max_us;	/* longest add_action to completion time */
+	u64 latency_total_us;
+};
+
 struct nvhost_intr_syncpt {
 	struct  nvhost_intr *intr;
 	u8 id;
 	u8 irq_requested;
 	u16 irq;
 	spinlock_t lock;
-	struct list_head wait_head;
+	struct rb_root wait_tree;	/* waiters ordered by threshold */
+	struct nvhost_intr_syncpt_stats stats;
 	char thresh_irq_name[12];
 };
 
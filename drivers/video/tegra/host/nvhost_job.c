@@ -30,6 +30,10 @@
 /* Magic to use to fill freed handle slots */
 #define BAD_MAGIC 0xdeadbeef
 
+/* Completed jobs kept per channel, and the largest job worth keeping */
+#define JOB_POOL_SIZE		4
+#define JOB_POOL_MAX_BYTES	(4 * PAGE_SIZE)
+
 static int job_size(struct nvhost_submit_hdr_ext *hdr)
 {
 	int num_pins = hdr ? (hdr->num_relocs + hdr->num_cmdbufs)*2 : 0;
@@ -41,6 +45,73 @@ static int job_size(struct nvhost_submit_hdr_ext *hdr)
 			+ num_waitchks * sizeof(struct nvhost_waitchk);
 }
 
+/*
+ * Take a job of at least size bytes from the channel's pool, or allocate a
+ * new one. Jobs are rounded up to whole pages as vmalloc allocates pages
+ * anyway, so a pooled job fits most later submits.
+ */
+static struct nvhost_job *job_pool_get(struct nvhost_channel *ch, int size)
+{
+	struct nvhost_job *job = NULL, *pos;
+	size_t alloc;
+
+	spin_lock(&ch->job_pool_lock);
+	list_for_each_entry(pos, &ch->job_pool, list) {
+		if (pos->size >= size) {
+			list_del(&pos->list);
+			ch->job_pool_count--;
+			job = pos;
+			break;
+		}
+	}
+	spin_unlock(&ch->job_pool_lock);
+
+	if (job) {
+		alloc = job->size;
+		memset(job, 0, alloc);
+	} else {
+		alloc = PAGE_ALIGN(size);
+		job = vzalloc(alloc);
+		if (!job)
+			return NULL;
+	}
+	job->size = alloc;
+	INIT_LIST_HEAD(&job->list);
+	return job;
+}
+
+static void job_pool_put(struct nvhost_job *job)
+{
+	struct nvhost_channel *ch = job->ch;
+
+	if (ch && job->size <= JOB_POOL_MAX_BYTES) {
+		spin_lock(&ch->job_pool_lock);
+		if (ch->job_pool_count < JOB_POOL_SIZE) {
+			list_add(&job->list, &ch->job_pool);
+			ch->job_pool_count++;
+			job = NULL;
+		}
+		spin_unlock(&ch->job_pool_lock);
+	}
+
+	if (job)
+		vfree(job);
+}
+
+void nvhost_job_pool_drain(struct nvhost_channel *ch)
+{
+	struct nvhost_job *job, *next;
+	LIST_HEAD(jobs);
+
+	spin_lock(&ch->job_pool_lock);
+	list_splice_init(&ch->job_pool, &jobs);
+	ch->job_pool_count = 0;
+	spin_unlock(&ch->job_pool_lock);
+
+	list_for_each_entry_safe(job, next, &jobs, list)
+		vfree(job);
+}
+
 static int gather_size(int num_cmdbufs)
 {
 	return num_cmdbufs * sizeof(struct nvhost_channel_gather);
@@ -174,7 +245,7 @@ struct nvhost_job *nvhost_job_alloc(struct nvhost_channel *ch,
 	int num_cmdbufs = hdr ? hdr->num_cmdbufs : 0;
 	int err = 0;
 
-	job = vzalloc(job_size(hdr));
+	job = job_pool_get(ch, job_size(hdr));
 	if (!job)
 		goto error;
 
@@ -210,7 +281,7 @@ struct nvhost_job *nvhost_job_realloc(
 	int num_cmdbufs = hdr ? hdr->num_cmdbufs : 0;
 	int err = 0;
 
-	newjob = vzalloc(job_size(hdr));
+	newjob = job_pool_get(oldjob->ch, job_size(hdr));
 	if (!newjob)
 		goto error;
 	kref_init(&newjob->ref);
@@ -258,7 +329,7 @@ static void job_free(struct kref *ref)
 		nvmap_free(job->nvmap, job->gather_mem);
 	if (job->nvmap)
 		nvmap_client_put(job->nvmap);
-	vfree(job);
+	job_pool_put(job);
 }
 
 /* Acquire reference to a hardware context. Used for keeping saved contexts in
@@ -86,6 +86,9 @@ struct nvhost_job {
 
 	/* Context to be freed */
 	struct nvhost_hwctx *hwctxref;
+
+	/* Bytes allocated for the job and its arrays */
+	size_t size;
 };
 
 /*
@@ -142,6 +145,11 @@ int nvhost_job_pin(struct nvhost_job *job);
  */
 void nvhost_job_unpin(struct nvhost_job *job);
 
+/*
+ * Free the jobs kept in a channel's job pool.
+ */
+void nvhost_job_pool_drain(struct nvhost_channel *ch);
+
 /*
  * Dump contents of job to debug output.
  */
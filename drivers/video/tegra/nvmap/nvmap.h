@@ -93,6 +93,16 @@ struct nvmap_handle {
 #define NVMAP_WB_POOL NVMAP_HANDLE_CACHEABLE
 #define NVMAP_NUM_POOLS (NVMAP_HANDLE_CACHEABLE + 1)
 
+/* per-cpu front cache of a page pool; pages already carry the pool's
+ * cache attribute */
+#define NVMAP_PCP_PAGES 32
+
+struct nvmap_page_pool_pcp {
+	spinlock_t lock;
+	int npages;
+	struct page *pages[NVMAP_PCP_PAGES];
+};
+
 struct nvmap_page_pool {
 	struct mutex lock;
 	int npages;
@@ -100,10 +110,15 @@ struct nvmap_page_pool {
 	struct page **shrink_array;
 	int max_pages;
 	int flags;
+	struct nvmap_page_pool_pcp __percpu *pcp;
+	atomic_t pcp_pages;	/* in the per-cpu caches, part of max_pages */
 };
 
 int nvmap_page_pool_init(struct nvmap_page_pool *pool, int flags);
 
+struct seq_file;
+int nvmap_alloc_latency_show(struct seq_file *s, void *unused);
+
 struct nvmap_share {
 	struct tegra_iovmm_client *iovmm;
 	wait_queue_head_t pin_wait;
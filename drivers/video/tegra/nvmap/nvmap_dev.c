@@ -1103,6 +1103,19 @@ static const struct file_operations debug_iovmm_clients_fops = {
 	.release = single_release,
 };
 
+static int nvmap_debug_alloc_latency_open(struct inode *inode,
+					  struct file *file)
+{
+	return single_open(file, nvmap_alloc_latency_show, inode->i_private);
+}
+
+static const struct file_operations debug_alloc_latency_fops = {
+	.open = nvmap_debug_alloc_latency_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static int nvmap_debug_iovmm_allocations_show(struct seq_file *s, void *unused)
 {
 	unsigned long flags;
@@ -1274,7 +1287,7 @@ static int nvmap_probe(struct platform_device *pdev)
 			continue;
 		node->carveout = nvmap_heap_create(dev->dev_user.this_device,
 				   co->name, co->base, co->size,
-				   co->buddy_size, node);
+				   co->buddy_size, co->cma, node);
 		if (!node->carveout) {
 			e = -ENOMEM;
 			dev_err(&pdev->dev, "couldn't create %s\n", co->name);
@@ -1311,6 +1324,8 @@ static int nvmap_probe(struct platform_device *pdev)
 				dev, &debug_iovmm_clients_fops);
 			debugfs_create_file("allocations", 0664, iovmm_root,
 				dev, &debug_iovmm_allocations_fops);
+			debugfs_create_file("alloc_latency", S_IRUGO,
+				iovmm_root, dev, &debug_alloc_latency_fops);
 			for (i = 0; i < NVMAP_NUM_POOLS; i++) {
 				char name[40];
 				char *memtype_string[] = {"uc", "wc",
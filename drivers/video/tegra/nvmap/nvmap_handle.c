@@ -42,6 +42,9 @@
 #include <linux/swap.h>
 #include <linux/shrinker.h>
 #include <linux/moduleparam.h>
+#include <linux/percpu.h>
+#include <linux/seq_file.h>
+#include <linux/ktime.h>
 
 #include "nvmap.h"
 #include "nvmap_mru.h"
@@ -70,6 +73,25 @@
 static bool enable_pp = 1;
 static int pool_size[NVMAP_NUM_POOLS];
 
+/* pages not found in the pools are taken from the buddy allocator in chunks
+ * of up to 1 << NVMAP_MAX_PAGE_ORDER pages, which keeps the number of
+ * allocator calls and the outer cache flush ranges down for big handles */
+#define NVMAP_MAX_PAGE_ORDER	4
+/* opportunistic: no reclaim, no reserves and no kswapd wakeup on a miss */
+#define GFP_NVMAP_HIGH_ORDER	((GFP_NVMAP | __GFP_NORETRY | __GFP_NOWARN | \
+				  __GFP_NOMEMALLOC | __GFP_NO_KSWAPD) & \
+				 ~__GFP_WAIT)
+static int max_page_order = NVMAP_MAX_PAGE_ORDER;
+module_param(max_page_order, int, 0644);
+
+/* handle_page_alloc() latency histogram, bucket i counts allocations that
+ * took less than 2^i us; the last bucket collects everything slower */
+#define NVMAP_ALLOC_HIST_BUCKETS	16
+static atomic_t alloc_latency_hist[NVMAP_ALLOC_HIST_BUCKETS];
+static atomic_t alloc_pages_pcp;
+static atomic_t alloc_pages_pool;
+static atomic_t alloc_pages_buddy;
+
 static char *s_memtype_str[] = {
 	"uc",
 	"wc",
@@ -96,46 +118,133 @@ static struct page *nvmap_page_pool_alloc_locked(struct nvmap_page_pool *pool)
 	return page;
 }
 
-static struct page *nvmap_page_pool_alloc(struct nvmap_page_pool *pool)
-{
-	struct page *page = NULL;
-
-	if (pool) {
-		nvmap_page_pool_lock(pool);
-		page = nvmap_page_pool_alloc_locked(pool);
-		nvmap_page_pool_unlock(pool);
-	}
-	return page;
-}
-
 static bool nvmap_page_pool_release_locked(struct nvmap_page_pool *pool,
 					    struct page *page)
 {
 	int ret = false;
 
-	if (enable_pp && pool->npages < pool->max_pages) {
+	if (enable_pp && pool->npages + atomic_read(&pool->pcp_pages) <
+	    pool->max_pages) {
 		pool->page_array[pool->npages++] = page;
 		ret = true;
 	}
 	return ret;
 }
 
-static bool nvmap_page_pool_release(struct nvmap_page_pool *pool,
-					  struct page *page)
+/* Take up to nr pages from the pool, trying this cpu's front cache before
+ * the shared array.  Returns the number of pages obtained. */
+static int nvmap_page_pool_alloc_pages(struct nvmap_page_pool *pool,
+				       struct page **pages, int nr)
 {
-	int ret = false;
+	struct nvmap_page_pool_pcp *pcp;
+	int got = 0;
+
+	if (!pool)
+		return 0;
+
+	if (pool->pcp) {
+		pcp = get_cpu_ptr(pool->pcp);
+		spin_lock(&pcp->lock);
+		while (got < nr && pcp->npages)
+			pages[got++] = pcp->pages[--pcp->npages];
+		spin_unlock(&pcp->lock);
+		put_cpu_ptr(pool->pcp);
+		atomic_sub(got, &pool->pcp_pages);
+		atomic_add(got, &alloc_pages_pcp);
+	}
+
+	if (got < nr && pool->npages) {
+		int from_pcp = got;
 
-	if (pool) {
 		nvmap_page_pool_lock(pool);
-		ret = nvmap_page_pool_release_locked(pool, page);
+		while (got < nr) {
+			pages[got] = nvmap_page_pool_alloc_locked(pool);
+			if (!pages[got])
+				break;
+			got++;
+		}
 		nvmap_page_pool_unlock(pool);
+		atomic_add(got - from_pcp, &alloc_pages_pool);
 	}
-	return ret;
+
+	return got;
+}
+
+/* Give up to nr pages back to the pool.  Returns the number of pages the
+ * pool took; the caller owns the rest. */
+static int nvmap_page_pool_release_pages(struct nvmap_page_pool *pool,
+					 struct page **pages, int nr)
+{
+	struct nvmap_page_pool_pcp *pcp;
+	int done = 0;
+
+	if (!pool || !enable_pp)
+		return 0;
+
+	if (pool->pcp) {
+		pcp = get_cpu_ptr(pool->pcp);
+		spin_lock(&pcp->lock);
+		while (done < nr && pcp->npages < NVMAP_PCP_PAGES) {
+			/* the per-cpu caches count against max_pages too */
+			if (atomic_inc_return(&pool->pcp_pages) +
+			    ACCESS_ONCE(pool->npages) > pool->max_pages) {
+				atomic_dec(&pool->pcp_pages);
+				break;
+			}
+			pcp->pages[pcp->npages++] = pages[done++];
+		}
+		spin_unlock(&pcp->lock);
+		put_cpu_ptr(pool->pcp);
+	}
+
+	if (done < nr) {
+		nvmap_page_pool_lock(pool);
+		while (done < nr &&
+		       nvmap_page_pool_release_locked(pool, pages[done]))
+			done++;
+		nvmap_page_pool_unlock(pool);
+	}
+
+	return done;
 }
 
 static int nvmap_page_pool_get_available_count(struct nvmap_page_pool *pool)
 {
-	return pool->npages;
+	return pool->npages + atomic_read(&pool->pcp_pages);
+}
+
+/* Release up to nr_free pages held in the per-cpu front caches. */
+static int nvmap_page_pool_drain_pcp(struct nvmap_page_pool *pool, int nr_free)
+{
+	struct page *batch[NVMAP_PCP_PAGES];
+	int cpu;
+
+	if (!pool->pcp)
+		return nr_free;
+
+	for_each_possible_cpu(cpu) {
+		struct nvmap_page_pool_pcp *pcp = per_cpu_ptr(pool->pcp, cpu);
+		int n = 0;
+
+		if (!nr_free)
+			break;
+
+		spin_lock(&pcp->lock);
+		while (n < nr_free && pcp->npages)
+			batch[n++] = pcp->pages[--pcp->npages];
+		spin_unlock(&pcp->lock);
+		atomic_sub(n, &pool->pcp_pages);
+
+		if (!n)
+			continue;
+
+		set_pages_array_wb(batch, n);
+		nr_free -= n;
+		while (n--)
+			__free_page(batch[n]);
+	}
+
+	return nr_free;
 }
 
 static int nvmap_page_pool_free(struct nvmap_page_pool *pool, int nr_free)
@@ -160,7 +269,8 @@ static int nvmap_page_pool_free(struct nvmap_page_pool *pool, int nr_free)
 	while (idx--)
 		__free_page(pool->shrink_array[idx]);
 	nvmap_page_pool_unlock(pool);
-	return i;
+
+	return nvmap_page_pool_drain_pcp(pool, i);
 }
 
 static int nvmap_page_pool_get_unused_pages(void)
@@ -374,7 +484,7 @@ POOL_SIZE_MOUDLE_PARAM_CB(wb, NVMAP_HANDLE_CACHEABLE);
 int nvmap_page_pool_init(struct nvmap_page_pool *pool, int flags)
 {
 	struct page *page;
-	int i;
+	int i, cpu;
 	static int reg = 1;
 	struct sysinfo info;
 	typedef int (*set_pages_array) (struct page **pages, int addrinarray);
@@ -394,6 +504,13 @@ int nvmap_page_pool_init(struct nvmap_page_pool *pool, int flags)
 	if (flags == NVMAP_HANDLE_CACHEABLE)
 		return 0;
 
+	atomic_set(&pool->pcp_pages, 0);
+	pool->pcp = alloc_percpu(struct nvmap_page_pool_pcp);
+	if (!pool->pcp)
+		goto fail;
+	for_each_possible_cpu(cpu)
+		spin_lock_init(&per_cpu_ptr(pool->pcp, cpu)->lock);
+
 	si_meminfo(&info);
 	if (!pool_size[flags]) {
 		/* Use 3/8th of total ram for page pools.
@@ -434,6 +551,8 @@ fail:
 	pool->max_pages = 0;
 	vfree(pool->shrink_array);
 	vfree(pool->page_array);
+	free_percpu(pool->pcp);
+	pool->pcp = NULL;
 	return -ENOMEM;
 }
 
@@ -484,12 +603,8 @@ void _nvmap_handle_free(struct nvmap_handle *h)
 	if (h->flags < NVMAP_NUM_POOLS)
 		pool = &share->pools[h->flags];
 
-	while (page_index < nr_page) {
-		if (!nvmap_page_pool_release(pool,
-		    h->pgalloc.pages[page_index]))
-			break;
-		page_index++;
-	}
+	page_index = nvmap_page_pool_release_pages(pool, h->pgalloc.pages,
+						   nr_page);
 
 	if (page_index == nr_page)
 		goto skip_attr_restore;
@@ -534,6 +649,69 @@ static struct page *nvmap_alloc_pages_exact(gfp_t gfp, size_t size)
 	return page;
 }
 
+/* Fill pages[] from the buddy allocator, preferring high-order chunks and
+ * falling back to smaller ones as they run out.  Returns the number of pages
+ * allocated. */
+static int nvmap_alloc_pages_batch(struct page **pages, int nr)
+{
+	int order = clamp(max_page_order, 0, MAX_ORDER - 1);
+	int i = 0;
+
+	while (i < nr) {
+		struct page *page;
+		int j;
+
+		while (order && (1 << order) > nr - i)
+			order--;
+
+		page = alloc_pages(order ? GFP_NVMAP_HIGH_ORDER : GFP_NVMAP,
+				   order);
+		if (!page) {
+			if (!order)
+				break;
+			order--;
+			continue;
+		}
+
+		if (order)
+			split_page(page, order);
+		for (j = 0; j < (1 << order); j++)
+			pages[i++] = nth_page(page, j);
+	}
+
+	atomic_add(i, &alloc_pages_buddy);
+	return i;
+}
+
+static void nvmap_alloc_latency_account(ktime_t start)
+{
+	s64 us = ktime_us_delta(ktime_get(), start);
+	int bucket = 0;
+
+	while (bucket < NVMAP_ALLOC_HIST_BUCKETS - 1 && us >= (1LL << bucket))
+		bucket++;
+	atomic_inc(&alloc_latency_hist[bucket]);
+}
+
+int nvmap_alloc_latency_show(struct seq_file *s, void *unused)
+{
+	int i;
+
+	seq_printf(s, "%-10s %10s\n", "USEC", "COUNT");
+	for (i = 0; i < NVMAP_ALLOC_HIST_BUCKETS - 1; i++)
+		seq_printf(s, "<%-9llu %10d\n", 1ULL << i,
+			   atomic_read(&alloc_latency_hist[i]));
+	seq_printf(s, ">=%-8llu %10d\n", 1ULL << (i - 1),
+		   atomic_read(&alloc_latency_hist[i]));
+	seq_printf(s, "\npages from pcp cache: %d\n",
+		   atomic_read(&alloc_pages_pcp));
+	seq_printf(s, "pages from pool:      %d\n",
+		   atomic_read(&alloc_pages_pool));
+	seq_printf(s, "pages from buddy:     %d\n",
+		   atomic_read(&alloc_pages_buddy));
+	return 0;
+}
+
 static int handle_page_alloc(struct nvmap_client *client,
 			     struct nvmap_handle *h, bool contiguous)
 {
@@ -544,6 +722,7 @@ static int handle_page_alloc(struct nvmap_client *client,
 	unsigned int i = 0, page_index = 0;
 	struct page **pages;
 	struct nvmap_page_pool *pool = NULL;
+	ktime_t start = ktime_get();
 
 	pages = altalloc(nr_page * sizeof(*pages));
 	if (!pages)
@@ -565,20 +744,12 @@ static int handle_page_alloc(struct nvmap_client *client,
 		if (h->flags < NVMAP_NUM_POOLS)
 			pool = &share->pools[h->flags];
 
-		for (i = 0; i < nr_page; i++) {
-			/* Get pages from pool, if available. */
-			pages[i] = nvmap_page_pool_alloc(pool);
-			if (!pages[i])
-				break;
-			page_index++;
-		}
-
-		for (; i < nr_page; i++) {
-			pages[i] = nvmap_alloc_pages_exact(GFP_NVMAP,
-				PAGE_SIZE);
-			if (!pages[i])
-				goto fail;
-		}
+		/* Get pages from pool, if available. */
+		page_index = nvmap_page_pool_alloc_pages(pool, pages, nr_page);
+		i = page_index + nvmap_alloc_pages_batch(&pages[page_index],
+							nr_page - page_index);
+		if (i < nr_page)
+			goto fail;
 
 #ifndef CONFIG_NVMAP_RECLAIM_UNPINNED_VM
 		h->pgalloc.area = tegra_iovmm_create_vm(client->share->iovmm,
@@ -594,7 +765,9 @@ static int handle_page_alloc(struct nvmap_client *client,
 	if (nr_page == page_index)
 		goto skip_attr_change;
 
-	/* Update the pages mapping in kernel page table. */
+	/* Update the pages mapping in kernel page table.  Pool pages already
+	 * have the right attribute, so this is one batched change (and cache
+	 * flush) for the freshly allocated tail only. */
 	if (h->flags == NVMAP_HANDLE_WRITE_COMBINE)
 		set_pages_array_wc(&pages[page_index],
 				nr_page - page_index);
@@ -610,13 +783,22 @@ skip_attr_change:
 	h->pgalloc.pages = pages;
 	h->pgalloc.contig = contiguous;
 	INIT_LIST_HEAD(&h->pgalloc.mru_list);
+	nvmap_alloc_latency_account(start);
 	return 0;
 
 fail:
-	while (i--) {
-		set_pages_array_wb(&pages[i], 1);
-		__free_page(pages[i]);
+	/* pages past page_index never had their attributes changed */
+	if (page_index) {
+		unsigned int n;
+
+		n = nvmap_page_pool_release_pages(pool, pages, page_index);
+		if (n < page_index)
+			set_pages_array_wb(&pages[n], page_index - n);
+		while (n < page_index)
+			__free_page(pages[n++]);
 	}
+	while (i-- > page_index)
+		__free_page(pages[i]);
 	altfree(pages, nr_page * sizeof(*pages));
 	wmb();
 	return -ENOMEM;
@@ -20,6 +20,8 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
+#include <linux/bitops.h>
+#include <linux/cma.h>
 #include <linux/device.h>
 #include <linux/kernel.h>
 #include <linux/list.h>
@@ -27,6 +29,10 @@
 #include <linux/mutex.h>
 #include <linux/slab.h>
 #include <linux/err.h>
+#include <linux/jiffies.h>
+#include <linux/math64.h>
+#include <linux/moduleparam.h>
+#include <linux/workqueue.h>
 
 #include <mach/nvmap.h>
 #include "nvmap.h"
@@ -68,6 +74,13 @@
  * and to ensure that the minimum free block size in the carveout (i.e., the
  * "small" threshold) is still a meaningful size.
  *
+ * a carveout may also be backed by a CMA area rather than removed from the
+ * memory map. the heap then only holds on to the parts of the area which
+ * carry blocks: whenever a block is placed, the pageblock-sized chunks
+ * under it are claimed from the page allocator, migrating out whatever
+ * movable pages were using them, and chunks which end up entirely free
+ * are given back. claims may sleep, which is fine under the heap mutex.
+ *
  */
 
 #define MAX_BUDDY_NR	128	/* maximum buddies in a buddy allocator */
@@ -94,6 +107,16 @@ struct heap_stat {
 	unsigned int compaction_count_fast;
 	/* full compaction attempt counter */
 	unsigned int compaction_count_full;
+	/* blocks relocated by the background compactor */
+	unsigned int compaction_count_bg;
+	/* bytes relocated by the background compactor */
+	unsigned long compaction_bytes_bg;
+	/* 0 (one free block) .. 1000 (free space fully splintered) */
+	unsigned int frag_index;
+	/* bytes of the backing CMA area currently claimed */
+	size_t cma_claimed;
+	/* chunk claims which failed to vacate the CMA area */
+	unsigned int cma_claim_fail;
 };
 
 struct buddy_heap;
@@ -144,11 +167,48 @@ struct nvmap_heap {
 	const char *name;
 	void *arg;
 	struct device dev;
+#ifdef CONFIG_NVMAP_CARVEOUT_COMPACTOR
+	struct delayed_work compact_work;
+	unsigned long last_activity;	/* jiffies of last alloc/free */
+	unsigned int compaction_count_fast;
+	unsigned int compaction_count_full;
+	unsigned int compaction_count_bg;
+	unsigned long compaction_bytes_bg;
+#endif
+#ifdef CONFIG_CMA
+	struct cma *cma;
+	phys_addr_t base;
+	unsigned long *cma_chunks;	/* one bit per claimed chunk */
+	size_t cma_claimed;
+	unsigned int cma_claim_fail;
+#endif
 };
 
 static struct kmem_cache *buddy_heap_cache;
 static struct kmem_cache *block_cache;
 
+#ifdef CONFIG_NVMAP_CARVEOUT_COMPACTOR
+/*
+ * the background compactor runs once a heap has seen no allocation or free
+ * for compact_idle_ms, and moves at most compact_slice_kb per heap lock hold
+ * so that a foreground allocation never waits behind a long copy. blocks
+ * larger than one slice are left to the synchronous compactor.
+ * compact_slice_kb = 0 disables background compaction.
+ */
+#define COMPACT_SLICE_INTERVAL_MS	20
+
+static unsigned int compact_idle_ms = 1000;
+module_param(compact_idle_ms, uint, 0644);
+
+static unsigned int compact_slice_kb = 1024;
+module_param(compact_slice_kb, uint, 0644);
+
+static unsigned int compact_frag_threshold = 300;
+module_param(compact_frag_threshold, uint, 0644);
+
+static struct workqueue_struct *compact_wq;
+#endif
+
 static inline struct nvmap_heap *parent_of(struct buddy_heap *heap)
 {
 	return heap->heap_base->heap;
@@ -160,6 +220,15 @@ static inline unsigned int order_of(size_t len, size_t min_shift)
 	return fls(len)-1;
 }
 
+/* share of the free space which is not usable by a single allocation of
+ * the largest free size, in units of 1/1000 */
+static inline unsigned int frag_index(size_t free, size_t free_largest)
+{
+	if (!free)
+		return 0;
+	return (unsigned int)div_u64((u64)(free - free_largest) * 1000, free);
+}
+
 /* returns the free size in bytes of the buddy heap; must be called while
  * holding the parent heap's lock. */
 static void buddy_stat(struct buddy_heap *heap, struct heap_stat *stat)
@@ -215,6 +284,17 @@ static unsigned long heap_stat(struct nvmap_heap *heap, struct heap_stat *stat)
 		stat->free_count++;
 		stat->free_largest = max(l->size, stat->free_largest);
 	}
+	stat->frag_index = frag_index(stat->free, stat->free_largest);
+#ifdef CONFIG_NVMAP_CARVEOUT_COMPACTOR
+	stat->compaction_count_fast = heap->compaction_count_fast;
+	stat->compaction_count_full = heap->compaction_count_full;
+	stat->compaction_count_bg = heap->compaction_count_bg;
+	stat->compaction_bytes_bg = heap->compaction_bytes_bg;
+#endif
+#ifdef CONFIG_CMA
+	stat->cma_claimed = heap->cma_claimed;
+	stat->cma_claim_fail = heap->cma_claim_fail;
+#endif
 	mutex_unlock(&heap->lock);
 
 	return base;
@@ -247,6 +327,27 @@ static struct device_attribute heap_stat_free_size =
 static struct device_attribute heap_stat_base =
 	__ATTR(base, S_IRUGO, heap_stat_show, NULL);
 
+static struct device_attribute heap_stat_frag_index =
+	__ATTR(frag_index, S_IRUGO, heap_stat_show, NULL);
+
+static struct device_attribute heap_stat_compact_fast =
+	__ATTR(compact_fast, S_IRUGO, heap_stat_show, NULL);
+
+static struct device_attribute heap_stat_compact_full =
+	__ATTR(compact_full, S_IRUGO, heap_stat_show, NULL);
+
+static struct device_attribute heap_stat_compact_bg_count =
+	__ATTR(compact_bg_count, S_IRUGO, heap_stat_show, NULL);
+
+static struct device_attribute heap_stat_compact_bg_size =
+	__ATTR(compact_bg_size, S_IRUGO, heap_stat_show, NULL);
+
+static struct device_attribute heap_stat_cma_claimed =
+	__ATTR(cma_claimed, S_IRUGO, heap_stat_show, NULL);
+
+static struct device_attribute heap_stat_cma_claim_fail =
+	__ATTR(cma_claim_fail, S_IRUGO, heap_stat_show, NULL);
+
 static struct device_attribute heap_attr_name =
 	__ATTR(name, S_IRUGO, heap_name_show, NULL);
 
@@ -258,6 +359,13 @@ static struct attribute *heap_stat_attrs[] = {
 	&heap_stat_free_count.attr,
 	&heap_stat_free_size.attr,
 	&heap_stat_base.attr,
+	&heap_stat_frag_index.attr,
+	&heap_stat_compact_fast.attr,
+	&heap_stat_compact_full.attr,
+	&heap_stat_compact_bg_count.attr,
+	&heap_stat_compact_bg_size.attr,
+	&heap_stat_cma_claimed.attr,
+	&heap_stat_cma_claim_fail.attr,
 	&heap_attr_name.attr,
 	NULL,
 };
@@ -297,6 +405,20 @@ static ssize_t heap_stat_show(struct device *dev,
 		return sprintf(buf, "%u\n", stat.free);
 	else if (attr == &heap_stat_base)
 		return sprintf(buf, "%08lx\n", base);
+	else if (attr == &heap_stat_frag_index)
+		return sprintf(buf, "%u\n", stat.frag_index);
+	else if (attr == &heap_stat_compact_fast)
+		return sprintf(buf, "%u\n", stat.compaction_count_fast);
+	else if (attr == &heap_stat_compact_full)
+		return sprintf(buf, "%u\n", stat.compaction_count_full);
+	else if (attr == &heap_stat_compact_bg_count)
+		return sprintf(buf, "%u\n", stat.compaction_count_bg);
+	else if (attr == &heap_stat_compact_bg_size)
+		return sprintf(buf, "%lu\n", stat.compaction_bytes_bg);
+	else if (attr == &heap_stat_cma_claimed)
+		return sprintf(buf, "%zu\n", stat.cma_claimed);
+	else if (attr == &heap_stat_cma_claim_fail)
+		return sprintf(buf, "%u\n", stat.cma_claim_fail);
 	else
 		return -EINVAL;
 }
@@ -383,6 +505,91 @@ static struct buddy_heap *do_buddy_free(struct nvmap_heap_block *block)
 	return NULL;
 }
 
+#ifdef CONFIG_CMA
+#define CMA_CHUNK_SHIFT		(pageblock_order + PAGE_SHIFT)
+#define CMA_CHUNK_PAGES		(1 << pageblock_order)
+
+static inline unsigned long cma_chunk_pfn(struct nvmap_heap *heap,
+					  unsigned long chunk)
+{
+	return __phys_to_pfn(heap->base + (chunk << CMA_CHUNK_SHIFT));
+}
+
+/* claims the chunks of the CMA area under [base, base + len) which the
+ * heap does not hold yet. chunks claimed before a failure are kept, they
+ * go back with the next trim. must be called while holding the heap's
+ * lock */
+static int heap_cma_claim(struct nvmap_heap *heap, phys_addr_t base,
+			  size_t len)
+{
+	unsigned long chunk, last;
+	phys_addr_t start;
+	bool claimed = false;
+	int err = 0;
+
+	if (!heap->cma)
+		return 0;
+
+	chunk = (base - heap->base) >> CMA_CHUNK_SHIFT;
+	last = (base + len - 1 - heap->base) >> CMA_CHUNK_SHIFT;
+
+	for (; chunk <= last; chunk++) {
+		if (test_bit(chunk, heap->cma_chunks))
+			continue;
+
+		err = cma_claim(heap->cma, cma_chunk_pfn(heap, chunk),
+				CMA_CHUNK_PAGES);
+		if (err) {
+			heap->cma_claim_fail++;
+			break;
+		}
+		__set_bit(chunk, heap->cma_chunks);
+		heap->cma_claimed += 1 << CMA_CHUNK_SHIFT;
+
+		/* the pages were cacheable while the kernel owned them, and
+		 * carveout blocks are mostly mapped uncached.  the whole
+		 * chunk is flushed: later allocations in it see it claimed
+		 * already and don't flush */
+		if (!claimed)
+			inner_flush_cache_all();
+		claimed = true;
+		start = __pfn_to_phys(cma_chunk_pfn(heap, chunk));
+		outer_flush_range(start, start + (1 << CMA_CHUNK_SHIFT));
+	}
+
+	return err;
+}
+
+/* gives back every claimed chunk which lies entirely within a free
+ * block. must be called while holding the heap's lock */
+static void heap_cma_trim(struct nvmap_heap *heap)
+{
+	struct list_block *l;
+	unsigned long chunk, end;
+
+	if (!heap->cma)
+		return;
+
+	list_for_each_entry(l, &heap->free_list, free_list) {
+		chunk = ALIGN(l->block.base - heap->base,
+			      1 << CMA_CHUNK_SHIFT) >> CMA_CHUNK_SHIFT;
+		end = (l->block.base + l->size - heap->base) >> CMA_CHUNK_SHIFT;
+
+		for (; chunk < end; chunk++) {
+			if (!test_bit(chunk, heap->cma_chunks))
+				continue;
+			cma_release(heap->cma,
+				    pfn_to_page(cma_chunk_pfn(heap, chunk)),
+				    CMA_CHUNK_PAGES);
+			__clear_bit(chunk, heap->cma_chunks);
+			heap->cma_claimed -= 1 << CMA_CHUNK_SHIFT;
+		}
+	}
+}
+#else
+#define heap_cma_claim(_heap, _base, _len)	0
+#define heap_cma_trim(_heap)			do { } while (0)
+#endif
 
 /*
  * base_max limits position of allocated chunk in memory.
@@ -427,7 +634,8 @@ static struct nvmap_heap_block *do_heap_alloc(struct nvmap_heap *heap,
 			if (base_max && fix_base > base_max)
 				break;
 
-			if (fix_size >= len) {
+			if (fix_size >= len &&
+			    !heap_cma_claim(heap, fix_base, len)) {
 				b = i;
 				break;
 			}
@@ -437,7 +645,8 @@ static struct nvmap_heap_block *do_heap_alloc(struct nvmap_heap *heap,
 			if (i->size >= len) {
 				fix_base = i->block.base + i->size - len;
 				fix_base &= ~(align-1);
-				if (fix_base >= i->block.base) {
+				if (fix_base >= i->block.base &&
+				    !heap_cma_claim(heap, fix_base, len)) {
 					b = i;
 					break;
 				}
@@ -720,6 +929,14 @@ static struct nvmap_heap_block *do_heap_relocate_listblock(
 	if (handle->usecount)
 		goto fail;
 
+#ifdef CONFIG_CMA
+	/* the full path relies on the allocation below never failing, but
+	 * it may have to claim chunks of the CMA area which cannot be
+	 * vacated right now */
+	if (heap->cma)
+		fast = true;
+#endif
+
 	if (fast) {
 		/* Fast compaction path - first allocate, then free. */
 		heap_block_new = do_heap_alloc(heap, src_size, src_align,
@@ -822,6 +1039,124 @@ static void nvmap_heap_compact(struct nvmap_heap *heap,
 	}
 	pr_err("Relocated %d chunks\n", relocation_count);
 }
+
+/* must be called while holding the heap's lock */
+static unsigned int heap_frag_index(struct nvmap_heap *heap)
+{
+	struct list_block *l;
+	size_t free = 0;
+	size_t free_largest = 0;
+
+	list_for_each_entry(l, &heap->free_list, free_list) {
+		free += l->size;
+		free_largest = max(l->size, free_largest);
+	}
+	return frag_index(free, free_largest);
+}
+
+/* moves allocated blocks down into the free hole directly below them until
+ * budget bytes have been copied. unlike nvmap_heap_compact, blocks which
+ * would not fit in the remaining budget are skipped rather than moved, so
+ * the time spent under the heap lock is bounded. returns the number of
+ * bytes relocated; must be called while holding the heap's lock. */
+static size_t nvmap_heap_compact_slice(struct nvmap_heap *heap, size_t budget)
+{
+	struct list_head *ptr = heap->all_list.next;
+	struct list_head *ptr_prev, *ptr_next;
+	struct list_block *hole, *next;
+	size_t moved = 0;
+	size_t size;
+
+	while (ptr != &heap->all_list && moved < budget) {
+		hole = list_entry(ptr, struct list_block, all_list);
+		ptr_prev = ptr->prev;
+		ptr_next = ptr->next;
+
+		if (hole->block.type != BLOCK_EMPTY ||
+		    ptr_next == &heap->all_list) {
+			ptr = ptr_next;
+			continue;
+		}
+
+		next = list_entry(ptr_next, struct list_block, all_list);
+		size = next->size;
+
+		/* the block has to end up strictly lower than it is now */
+		if (next->block.type != BLOCK_FIRST_FIT ||
+		    size > budget - moved ||
+		    ALIGN(hole->block.base, next->align) >= next->block.base) {
+			ptr = ptr_next;
+			continue;
+		}
+
+		/* pinned or mapped blocks are not movable */
+		if (!do_heap_relocate_listblock(next, false)) {
+			ptr = ptr_next;
+			continue;
+		}
+
+		heap->compaction_count_bg++;
+		heap->compaction_bytes_bg += size;
+		moved += size;
+
+		/* the hole may have been merged away; restart from the block
+		 * preceding it, which is never touched by the relocation */
+		ptr = ptr_prev->next;
+	}
+
+	return moved;
+}
+
+static void nvmap_heap_compact_work(struct work_struct *work)
+{
+	struct nvmap_heap *heap = container_of(to_delayed_work(work),
+					       struct nvmap_heap, compact_work);
+	unsigned long idle = msecs_to_jiffies(compact_idle_ms);
+	unsigned long budget = compact_slice_kb << 10;
+	size_t moved;
+	unsigned int frag;
+
+	if (!budget)
+		return;
+
+	/* the heap is still in use; look again once it has settled */
+	if (time_before(jiffies, heap->last_activity + idle)) {
+		queue_delayed_work(compact_wq, &heap->compact_work,
+				   heap->last_activity + idle - jiffies);
+		return;
+	}
+
+	/* never make a foreground allocation wait for a slice */
+	if (!mutex_trylock(&heap->lock)) {
+		queue_delayed_work(compact_wq, &heap->compact_work, idle);
+		return;
+	}
+
+	moved = 0;
+	frag = heap_frag_index(heap);
+	if (frag >= compact_frag_threshold) {
+		moved = nvmap_heap_compact_slice(heap, budget);
+		frag = heap_frag_index(heap);
+	}
+	if (moved)
+		heap_cma_trim(heap);
+	mutex_unlock(&heap->lock);
+
+	if (moved && frag >= compact_frag_threshold)
+		queue_delayed_work(compact_wq, &heap->compact_work,
+			msecs_to_jiffies(COMPACT_SLICE_INTERVAL_MS));
+}
+
+/* must be called while holding the heap's lock */
+static void nvmap_heap_kick_compactor(struct nvmap_heap *heap)
+{
+	heap->last_activity = jiffies;
+	if (compact_wq && compact_slice_kb)
+		queue_delayed_work(compact_wq, &heap->compact_work,
+				   msecs_to_jiffies(compact_idle_ms));
+}
+#else
+#define nvmap_heap_kick_compactor(_heap)	do { } while (0)
 #endif
 
 void nvmap_usecount_inc(struct nvmap_handle *h)
@@ -860,14 +1195,18 @@ struct nvmap_heap_block *nvmap_heap_alloc(struct nvmap_heap *h,
 	b = do_heap_alloc(h, len, align, prot, 0);
 	if (!b) {
 		pr_err("Compaction triggered!\n");
+		h->compaction_count_fast++;
 		nvmap_heap_compact(h, len, true);
 		b = do_heap_alloc(h, len, align, prot, 0);
 		if (!b) {
 			pr_err("Full compaction triggered!\n");
+			h->compaction_count_full++;
 			nvmap_heap_compact(h, len, false);
 			b = do_heap_alloc(h, len, align, prot, 0);
 		}
+		heap_cma_trim(h);
 	}
+	h->last_activity = jiffies;
 #else
 	if (len <= h->buddy_heap_size / 2) {
 		b = do_buddy_alloc(h, len, align, prot);
@@ -882,6 +1221,8 @@ struct nvmap_heap_block *nvmap_heap_alloc(struct nvmap_heap *h,
 	if (b) {
 		b->handle = handle;
 		handle->carveout = b;
+	} else {
+		heap_cma_trim(h);
 	}
 	mutex_unlock(&h->lock);
 	return b;
@@ -914,6 +1255,8 @@ void nvmap_heap_free(struct nvmap_heap_block *b)
 		lb = container_of(b, struct list_block, block);
 		nvmap_flush_heap_block(NULL, b, lb->size, lb->mem_prot);
 		do_heap_free(b);
+		heap_cma_trim(h);
+		nvmap_heap_kick_compactor(h);
 	}
 
 	if (bh) {
@@ -933,6 +1276,10 @@ static void heap_release(struct device *heap)
 /* nvmap_heap_create: create a heap object of len bytes, starting from
  * address base.
  *
+ * if cma is set, the heap is backed by that CMA area and only claims the
+ * parts of it which hold blocks. base and len must then be aligned to
+ * pageblocks, otherwise the whole area is claimed up front.
+ *
  * if buddy_size is >= NVMAP_HEAP_MIN_BUDDY_SIZE, then allocations <= 1/2
  * of the buddy heap size will use a buddy sub-allocator, where each buddy
  * heap is buddy_size bytes (should be a power of 2). all other allocations
@@ -940,7 +1287,8 @@ static void heap_release(struct device *heap)
  */
 struct nvmap_heap *nvmap_heap_create(struct device *parent, const char *name,
 				     phys_addr_t base, size_t len,
-				     size_t buddy_size, void *arg)
+				     size_t buddy_size, struct cma *cma,
+				     void *arg)
 {
 	struct nvmap_heap *h = NULL;
 	struct list_block *l = NULL;
@@ -985,6 +1333,27 @@ struct nvmap_heap *nvmap_heap_create(struct device *parent, const char *name,
 		goto fail_alloc;
 	}
 
+#ifdef CONFIG_CMA
+	if (cma && ((base | len) & ((1 << CMA_CHUNK_SHIFT) - 1))) {
+		dev_warn(parent, "%s: %s not aligned to pageblocks, claiming "
+			 "it whole\n", __func__, name);
+		if (cma_claim(cma, __phys_to_pfn(base), len >> PAGE_SHIFT)) {
+			dev_err(parent, "%s: failed to claim %s\n", __func__,
+				name);
+			goto fail_alloc;
+		}
+	} else if (cma) {
+		h->cma_chunks = kzalloc(BITS_TO_LONGS(len >> CMA_CHUNK_SHIFT) *
+					sizeof(long), GFP_KERNEL);
+		if (!h->cma_chunks) {
+			dev_err(parent, "%s: out of memory\n", __func__);
+			goto fail_alloc;
+		}
+		h->cma = cma;
+		h->base = base;
+	}
+#endif
+
 	dev_set_name(&h->dev, "heap-%s", name);
 	h->name = name;
 	h->arg = arg;
@@ -1008,6 +1377,10 @@ struct nvmap_heap *nvmap_heap_create(struct device *parent, const char *name,
 	INIT_LIST_HEAD(&h->buddy_list);
 	INIT_LIST_HEAD(&h->all_list);
 	mutex_init(&h->lock);
+#ifdef CONFIG_NVMAP_CARVEOUT_COMPACTOR
+	INIT_DELAYED_WORK(&h->compact_work, nvmap_heap_compact_work);
+	h->last_activity = jiffies;
+#endif
 	l->block.base = base;
 	l->block.type = BLOCK_EMPTY;
 	l->size = len;
@@ -1025,6 +1398,10 @@ fail_register:
 fail_alloc:
 	if (l)
 		kmem_cache_free(block_cache, l);
+#ifdef CONFIG_CMA
+	if (h)
+		kfree(h->cma_chunks);
+#endif
 	kfree(h);
 	return NULL;
 }
@@ -1045,6 +1422,9 @@ void nvmap_heap_destroy(struct nvmap_heap *heap)
 {
 	WARN_ON(!list_empty(&heap->buddy_list));
 
+#ifdef CONFIG_NVMAP_CARVEOUT_COMPACTOR
+	cancel_delayed_work_sync(&heap->compact_work);
+#endif
 	sysfs_remove_group(&heap->dev.kobj, &heap_stat_attr_group);
 	device_unregister(&heap->dev);
 
@@ -1057,6 +1437,11 @@ void nvmap_heap_destroy(struct nvmap_heap *heap)
 		kmem_cache_free(buddy_heap_cache, b);
 	}
 
+	heap_cma_trim(heap);
+#ifdef CONFIG_CMA
+	kfree(heap->cma_chunks);
+#endif
+
 	WARN_ON(!list_is_singular(&heap->all_list));
 	while (!list_empty(&heap->all_list)) {
 		struct list_block *l;
@@ -1098,11 +1483,25 @@ int nvmap_heap_init(void)
 		pr_err("%s: unable to create block cache\n", __func__);
 		return -ENOMEM;
 	}
+
+#ifdef CONFIG_NVMAP_CARVEOUT_COMPACTOR
+	/* not fatal: heaps still compact synchronously on allocation
+	 * failure */
+	compact_wq = create_singlethread_workqueue("nvmap_compact");
+	if (!compact_wq)
+		pr_warn("%s: unable to create compaction workqueue\n",
+			__func__);
+#endif
 	return 0;
 }
 
 void nvmap_heap_deinit(void)
 {
+#ifdef CONFIG_NVMAP_CARVEOUT_COMPACTOR
+	if (compact_wq)
+		destroy_workqueue(compact_wq);
+	compact_wq = NULL;
+#endif
 	if (buddy_heap_cache)
 		kmem_cache_destroy(buddy_heap_cache);
 	if (block_cache)
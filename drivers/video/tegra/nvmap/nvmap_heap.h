@@ -26,6 +26,7 @@
 struct device;
 struct nvmap_heap;
 struct attribute_group;
+struct cma;
 
 struct nvmap_heap_block {
 	phys_addr_t	base;
@@ -37,7 +38,8 @@ struct nvmap_heap_block {
 
 struct nvmap_heap *nvmap_heap_create(struct device *parent, const char *name,
 				     phys_addr_t base, size_t len,
-				     unsigned int buddy_size, void *arg);
+				     unsigned int buddy_size, struct cma *cma,
+				     void *arg);
 
 void nvmap_heap_destroy(struct nvmap_heap *heap);
 
@@ -866,6 +866,14 @@ struct ext4_inode_info {
 	 */
 	tid_t i_sync_tid;
 	tid_t i_datasync_tid;
+
+	/*
+	 * Range of logical blocks mapped in transaction i_fc_tid, which a
+	 * fast commit of that transaction has to log.  [i_data_sem]
+	 */
+	tid_t i_fc_tid;
+	ext4_lblk_t i_fc_lblk_start;
+	ext4_lblk_t i_fc_lblk_end;
 };
 
 /*
@@ -917,6 +925,8 @@ struct ext4_inode_info {
 #define EXT4_MOUNT_DISCARD		0x40000000 /* Issue DISCARD requests */
 #define EXT4_MOUNT_INIT_INODE_TABLE	0x80000000 /* Initialize uninitialized itables */
 
+#define EXT4_MOUNT2_FAST_COMMIT		0x00000001 /* Fast commits for fsync */
+
 #define clear_opt(sb, opt)		EXT4_SB(sb)->s_mount_opt &= \
 						~EXT4_MOUNT_##opt
 #define set_opt(sb, opt)		EXT4_SB(sb)->s_mount_opt |= \
@@ -1127,6 +1137,9 @@ struct ext4_sb_info {
 
 	/* Journaling */
 	struct journal_s *s_journal;
+	tid_t s_fc_ineligible_tid;	/* Transaction not fit for fast commits */
+	void **s_fc_replay;		/* Fast commit blocks to replay */
+	int s_fc_replay_count;
 	struct list_head s_orphan;
 	struct mutex s_orphan_lock;
 	unsigned long s_resize_flags;		/* Flags indicating if there
@@ -1769,6 +1782,16 @@ extern void ext4_htree_free_dir_info(struct dir_private_info *p);
 extern int ext4_sync_file(struct file *, loff_t, loff_t, int);
 extern int ext4_flush_completed_IO(struct inode *);
 
+/* fast_commit.c */
+extern void ext4_fc_track_range(handle_t *handle, struct inode *inode,
+				ext4_lblk_t lblk, unsigned int len);
+extern void ext4_fc_mark_ineligible(struct super_block *sb, handle_t *handle);
+extern int ext4_fc_commit(struct inode *inode, tid_t tid);
+extern int ext4_fc_replay_scan(journal_t *journal, struct buffer_head *bh,
+			       int off, tid_t tid);
+extern void ext4_fc_replay(struct super_block *sb);
+extern void ext4_fc_replay_cleanup(struct super_block *sb);
+
 /* hash.c */
 extern int ext4fs_dirhash(const char *name, int len, struct
 			  dx_hash_info *hinfo);
@@ -1804,6 +1827,8 @@ extern int ext4_mb_add_groupinfo(struct super_block *sb,
 extern int ext4_group_add_blocks(handle_t *handle, struct super_block *sb,
 				ext4_fsblk_t block, unsigned long count);
 extern int ext4_trim_fs(struct super_block *, struct fstrim_range *);
+extern int ext4_mb_mark_bb(handle_t *handle, struct super_block *sb,
+			   ext4_fsblk_t block, int len);
 
 /* inode.c */
 struct buffer_head *ext4_getblk(handle_t *, struct inode *,
@@ -2217,6 +2242,8 @@ extern int ext4_map_blocks(handle_t *handle, struct inode *inode,
 			   struct ext4_map_blocks *map, int flags);
 extern int ext4_fiemap(struct inode *inode, struct fiemap_extent_info *fieinfo,
 			__u64 start, __u64 len);
+extern int ext4_ext_hole_len(struct inode *inode, ext4_lblk_t lblk,
+			     unsigned int len);
 /* move_extent.c */
 extern int ext4_move_extents(struct file *o_filp, struct file *d_filp,
 			     __u64 start_orig, __u64 start_donor,
@@ -2018,6 +2018,42 @@ ext4_ext_put_gap_in_cache(struct inode *inode, struct ext4_ext_path *path,
 	ext4_ext_put_in_cache(inode, lblock, len, 0);
 }
 
+/*
+ * ext4_ext_hole_len:
+ * returns the number of unmapped blocks, at most @len, starting at @lblk;
+ * 0 if @lblk is mapped.
+ */
+int ext4_ext_hole_len(struct inode *inode, ext4_lblk_t lblk, unsigned int len)
+{
+	struct ext4_ext_path *path;
+	struct ext4_extent *ex;
+	ext4_lblk_t next;
+
+	down_read(&EXT4_I(inode)->i_data_sem);
+	path = ext4_ext_find_extent(inode, lblk, NULL);
+	if (IS_ERR(path)) {
+		up_read(&EXT4_I(inode)->i_data_sem);
+		return PTR_ERR(path);
+	}
+
+	ex = path[ext_depth(inode)].p_ext;
+	if (ex == NULL)
+		next = EXT_MAX_BLOCKS;
+	else if (lblk < le32_to_cpu(ex->ee_block))
+		next = le32_to_cpu(ex->ee_block);
+	else if (lblk < le32_to_cpu(ex->ee_block) +
+			ext4_ext_get_actual_len(ex))
+		next = lblk;
+	else
+		next = ext4_ext_next_allocated_block(path);
+
+	ext4_ext_drop_refs(path);
+	kfree(path);
+	up_read(&EXT4_I(inode)->i_data_sem);
+
+	return min_t(ext4_lblk_t, next - lblk, len);
+}
+
 /*
  * ext4_ext_check_cache()
  * Checks to see if the given block is in the cache.
@@ -3664,6 +3700,7 @@ void ext4_ext_truncate(struct inode *inode)
 	handle = ext4_journal_start(inode, err);
 	if (IS_ERR(handle))
 		return;
+	ext4_fc_mark_ineligible(sb, handle);
 
 	if (inode->i_size & (sb->s_blocksize - 1))
 		ext4_block_truncate_page(handle, mapping, inode->i_size);
@@ -4205,6 +4242,7 @@ int ext4_ext_punch_hole(struct file *file, loff_t offset, loff_t length)
 	handle = ext4_journal_start(inode, credits);
 	if (IS_ERR(handle))
 		return PTR_ERR(handle);
+	ext4_fc_mark_ineligible(sb, handle);
 
 	err = ext4_orphan_add(handle, inode);
 	if (err)
@@ -0,0 +1,563 @@
+/*
+ * linux/fs/ext4/fast_commit.c
+ *
+ * Fast commits: an fsync of a regular file whose only changes in the
+ * running transaction are to its size, timestamps and newly mapped blocks
+ * is made durable by writing a single, logically described block to the
+ * fast commit area of the journal, instead of committing the whole
+ * transaction.  Anything else marks the transaction ineligible and fsync
+ * falls back to a full commit.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/fs.h>
+#include <linux/jbd2.h>
+#include <linux/blkdev.h>
+#include <linux/buffer_head.h>
+#include <linux/crc16.h>
+#include <linux/quotaops.h>
+#include <linux/slab.h>
+#include "ext4.h"
+#include "ext4_jbd2.h"
+#include "ext4_extents.h"
+#include "fast_commit.h"
+
+/*
+ * Record that @len blocks at @lblk were mapped for @inode by @handle.
+ * Called from ext4_map_blocks() with i_data_sem held for writing.
+ */
+void ext4_fc_track_range(handle_t *handle, struct inode *inode,
+			 ext4_lblk_t lblk, unsigned int len)
+{
+	struct ext4_inode_info *ei = EXT4_I(inode);
+	tid_t tid;
+
+	if (!test_opt2(inode->i_sb, FAST_COMMIT) || !ext4_handle_valid(handle))
+		return;
+
+	tid = handle->h_transaction->t_tid;
+	if (ei->i_fc_tid != tid) {
+		ei->i_fc_tid = tid;
+		ei->i_fc_lblk_start = lblk;
+		ei->i_fc_lblk_end = lblk + len - 1;
+	} else {
+		ei->i_fc_lblk_start = min(ei->i_fc_lblk_start, lblk);
+		ei->i_fc_lblk_end = max(ei->i_fc_lblk_end, lblk + len - 1);
+	}
+}
+
+/*
+ * The transaction of @handle, or the running one if @handle is NULL,
+ * contains changes a fast commit cannot describe: fsyncs in it have to do
+ * a full commit.  When called without a handle, this must be done after
+ * the change.
+ */
+void ext4_fc_mark_ineligible(struct super_block *sb, handle_t *handle)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	journal_t *journal = sbi->s_journal;
+
+	if (!test_opt2(sb, FAST_COMMIT) || !journal)
+		return;
+
+	if (ext4_handle_valid(handle)) {
+		sbi->s_fc_ineligible_tid = handle->h_transaction->t_tid;
+		return;
+	}
+
+	read_lock(&journal->j_state_lock);
+	if (journal->j_running_transaction)
+		sbi->s_fc_ineligible_tid =
+			journal->j_running_transaction->t_tid;
+	read_unlock(&journal->j_state_lock);
+}
+
+static int ext4_fc_eligible(struct inode *inode, tid_t tid)
+{
+	return S_ISREG(inode->i_mode) &&
+	       ext4_test_inode_flag(inode, EXT4_INODE_EXTENTS) &&
+	       !ext4_should_journal_data(inode) &&
+	       EXT4_SB(inode->i_sb)->s_fc_ineligible_tid != tid;
+}
+
+static __le16 ext4_fc_csum(struct super_block *sb, struct ext4_fc_block *fc)
+{
+	size_t off = offsetof(struct ext4_fc_block, fc_nr_ranges);
+	__u16 crc;
+
+	crc = crc16(~0, EXT4_SB(sb)->s_es->s_uuid,
+		    sizeof(EXT4_SB(sb)->s_es->s_uuid));
+	crc = crc16(crc, (__u8 *)fc + off, sb->s_blocksize - off);
+	return cpu_to_le16(crc);
+}
+
+/*
+ * Look up @lblk in @inode.  Returns the number of blocks, at most @len,
+ * starting there which are either all unmapped (*pblk == 0), or mapped to
+ * consecutive physical blocks starting at *pblk.
+ */
+static int ext4_fc_lookup(struct inode *inode, ext4_lblk_t lblk,
+			  unsigned int len, ext4_fsblk_t *pblk,
+			  int *unwritten)
+{
+	struct ext4_map_blocks map;
+	int ret;
+
+	len = min_t(unsigned int, len, EXT_INIT_MAX_LEN);
+	*pblk = 0;
+	*unwritten = 0;
+
+	ret = ext4_ext_hole_len(inode, lblk, len);
+	if (ret)
+		return ret;
+
+	map.m_lblk = lblk;
+	map.m_len = len;
+	ret = ext4_map_blocks(NULL, inode, &map, 0);
+	if (ret <= 0)
+		return ret ? ret : -EIO;
+
+	*pblk = map.m_pblk;
+	*unwritten = !!(map.m_flags & EXT4_MAP_UNWRITTEN);
+	return ret;
+}
+
+/*
+ * Describe the blocks @inode had mapped in transaction @tid.  Returns
+ * -EAGAIN if they can't be described in one fast commit block.
+ */
+static int ext4_fc_fill_ranges(struct inode *inode, tid_t tid,
+			       struct ext4_fc_block *fc)
+{
+	struct ext4_inode_info *ei = EXT4_I(inode);
+	unsigned int max = EXT4_FC_MAX_RANGES(inode->i_sb);
+	struct ext4_fc_range *range;
+	ext4_lblk_t lblk, end;
+	ext4_fsblk_t pblk;
+	int tracked, unwritten, ret, nr = 0;
+
+	down_read(&ei->i_data_sem);
+	tracked = ei->i_fc_tid == tid;
+	lblk = ei->i_fc_lblk_start;
+	end = ei->i_fc_lblk_end;
+	up_read(&ei->i_data_sem);
+
+	while (tracked && lblk <= end) {
+		ret = ext4_fc_lookup(inode, lblk, end - lblk + 1,
+				     &pblk, &unwritten);
+		if (ret < 0)
+			return ret;
+		if (unwritten)
+			return -EAGAIN;
+		if (pblk) {
+			if (nr == max)
+				return -EAGAIN;
+			range = &fc->fc_ranges[nr++];
+			range->fc_lblk = cpu_to_le32(lblk);
+			range->fc_len = cpu_to_le32(ret);
+			range->fc_pblk = cpu_to_le64(pblk);
+		}
+		if (end - lblk < ret)
+			break;
+		lblk += ret;
+	}
+
+	fc->fc_nr_ranges = cpu_to_le16(nr);
+	return 0;
+}
+
+/*
+ * fsync only waited for the data in the range it was asked about, but the
+ * block logs everything mapped in the transaction, including blocks that
+ * writeback racing with us just mapped.  Replay must not expose any of
+ * them before their data is on disk, so write out and wait on all of it.
+ * A page that writeback is still mapping is locked and dirty until it is
+ * under IO, so the write pass waits for it and the wait pass then waits
+ * for the IO.
+ */
+static int ext4_fc_wait_data(struct inode *inode, struct ext4_fc_block *fc)
+{
+	int nr = le16_to_cpu(fc->fc_nr_ranges);
+	struct ext4_fc_range *last;
+	loff_t start, end;
+
+	if (!nr)
+		return 0;
+
+	last = &fc->fc_ranges[nr - 1];
+	start = (loff_t)le32_to_cpu(fc->fc_ranges[0].fc_lblk) <<
+		inode->i_blkbits;
+	end = ((loff_t)le32_to_cpu(last->fc_lblk) +
+	       le32_to_cpu(last->fc_len)) << inode->i_blkbits;
+	return filemap_write_and_wait_range(inode->i_mapping, start, end - 1);
+}
+
+static int ext4_fc_write(journal_t *journal, struct buffer_head *bh)
+{
+	int rw = WRITE_SYNC;
+
+	if (journal->j_flags & JBD2_BARRIER) {
+		/*
+		 * The data the block points at has been written already; make
+		 * sure it is stable before the block itself is.
+		 */
+		if (journal->j_fs_dev != journal->j_dev)
+			blkdev_issue_flush(journal->j_fs_dev, GFP_NOFS, NULL);
+		rw = WRITE_FLUSH_FUA;
+	}
+
+	lock_buffer(bh);
+	clear_buffer_dirty(bh);
+	set_buffer_uptodate(bh);
+	bh->b_end_io = end_buffer_write_sync;
+	get_bh(bh);
+	submit_bh(rw, bh);
+	wait_on_buffer(bh);
+
+	return buffer_uptodate(bh) ? 0 : -EIO;
+}
+
+/**
+ * ext4_fc_commit() - make an inode durable with a fast commit
+ * @inode: inode being fsynced, with its data written out already
+ * @tid: transaction holding the inode's metadata changes
+ *
+ * Returns 0 if @inode is now safe on disk, or a negative error if the
+ * caller has to fall back to committing @tid.
+ */
+int ext4_fc_commit(struct inode *inode, tid_t tid)
+{
+	struct super_block *sb = inode->i_sb;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_inode_info *ei = EXT4_I(inode);
+	journal_t *journal = sbi->s_journal;
+	struct ext4_fc_block *fc;
+	struct buffer_head *bh;
+	int ret, half_full;
+
+	if (!test_opt2(sb, FAST_COMMIT) || !ext4_fc_eligible(inode, tid))
+		return -EAGAIN;
+
+	/* Replay can only build upon everything before @tid */
+	ret = jbd2_log_wait_commit(journal, tid - 1);
+	if (ret)
+		return ret;
+
+	if (jbd2_fc_begin_commit(journal, tid))
+		return -EAGAIN;
+
+	if (!ext4_fc_eligible(inode, tid)) {
+		ret = -EAGAIN;
+		goto out;
+	}
+
+	ret = jbd2_fc_get_buf(journal, &bh);
+	if (ret)
+		goto out_ineligible;
+
+	/*
+	 * Sample the size before the mappings: writeback racing with us can
+	 * only map more blocks, whose data ext4_fc_wait_data() then waits for.
+	 */
+	fc = (struct ext4_fc_block *)bh->b_data;
+	fc->fc_disksize = cpu_to_le64(ei->i_disksize);
+	smp_rmb();
+	ret = ext4_fc_fill_ranges(inode, tid, fc);
+	if (!ret)
+		ret = ext4_fc_wait_data(inode, fc);
+	if (!ret) {
+		fc->fc_header.h_magic = cpu_to_be32(JBD2_MAGIC_NUMBER);
+		fc->fc_header.h_blocktype = cpu_to_be32(JBD2_FC_BLOCK);
+		fc->fc_header.h_sequence = cpu_to_be32(tid);
+		fc->fc_ino = cpu_to_le32(inode->i_ino);
+		fc->fc_mtime = cpu_to_le32(inode->i_mtime.tv_sec);
+		fc->fc_mtime_nsec = cpu_to_le32(inode->i_mtime.tv_nsec);
+		fc->fc_ctime = cpu_to_le32(inode->i_ctime.tv_sec);
+		fc->fc_ctime_nsec = cpu_to_le32(inode->i_ctime.tv_nsec);
+		fc->fc_crc = ext4_fc_csum(sb, fc);
+		ret = ext4_fc_write(journal, bh);
+	}
+	brelse(bh);
+
+out_ineligible:
+	/*
+	 * Replay stops at the first fast commit block which is not valid,
+	 * so once a block was handed out but not written no further fast
+	 * commits of @tid are any use.
+	 */
+	if (ret)
+		sbi->s_fc_ineligible_tid = tid;
+out:
+	read_lock(&journal->j_state_lock);
+	half_full = journal->j_fc_off > JBD2_FC_BLOCKS / 2;
+	read_unlock(&journal->j_state_lock);
+	jbd2_fc_end_commit(journal);
+
+	/* Don't let fast commits pile up until the area is full */
+	if (!ret && half_full)
+		jbd2_log_start_commit(journal, tid);
+	return ret ? -EAGAIN : 0;
+}
+
+/*
+ * Recovery callback: stash away a copy of each valid fast commit block of
+ * the transaction which was running when the filesystem went down.  They
+ * are applied by ext4_fc_replay() once the filesystem is set up.
+ */
+int ext4_fc_replay_scan(journal_t *journal, struct buffer_head *bh,
+			int off, tid_t tid)
+{
+	struct super_block *sb = journal->j_private;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_fc_block *fc = (struct ext4_fc_block *)bh->b_data;
+	void *copy;
+
+	/* A torn last block is expected after a crash: just stop there */
+	if (fc->fc_crc != ext4_fc_csum(sb, fc) ||
+	    le16_to_cpu(fc->fc_nr_ranges) > EXT4_FC_MAX_RANGES(sb)) {
+		ext4_msg(sb, KERN_INFO, "ignoring fast commit blocks from "
+			 "%d on in transaction %u", off, tid);
+		return 1;
+	}
+
+	if (!sbi->s_fc_replay) {
+		sbi->s_fc_replay = kcalloc(journal->j_fc_last -
+					   journal->j_fc_first,
+					   sizeof(void *), GFP_KERNEL);
+		if (!sbi->s_fc_replay)
+			return -ENOMEM;
+	}
+
+	copy = kmemdup(bh->b_data, sb->s_blocksize, GFP_KERNEL);
+	if (!copy)
+		return -ENOMEM;
+	sbi->s_fc_replay[sbi->s_fc_replay_count++] = copy;
+	return 0;
+}
+
+/* Mark @len blocks at @pblk in use, one block group at a time */
+static int ext4_fc_claim(struct super_block *sb, ext4_fsblk_t pblk,
+			 unsigned int len)
+{
+	ext4_group_t group;
+	ext4_grpblk_t off;
+	handle_t *handle;
+	int n, ret, err;
+
+	while (len) {
+		ext4_get_group_no_and_offset(sb, pblk, &group, &off);
+		n = min_t(unsigned int, len, EXT4_BLOCKS_PER_GROUP(sb) - off);
+
+		handle = ext4_journal_start_sb(sb, 3);
+		if (IS_ERR(handle))
+			return PTR_ERR(handle);
+		ret = ext4_mb_mark_bb(handle, sb, pblk, n);
+		err = ext4_journal_stop(handle);
+		if (!ret)
+			ret = err;
+		if (ret)
+			return ret;
+
+		pblk += n;
+		len -= n;
+	}
+	return 0;
+}
+
+static int ext4_fc_insert(struct inode *inode, ext4_lblk_t lblk,
+			  ext4_fsblk_t pblk, unsigned int len)
+{
+	struct ext4_ext_path *path;
+	struct ext4_extent newex;
+	handle_t *handle;
+	int ret, err;
+
+	handle = ext4_journal_start(inode, ext4_chunk_trans_blocks(inode, len));
+	if (IS_ERR(handle))
+		return PTR_ERR(handle);
+
+	down_write(&EXT4_I(inode)->i_data_sem);
+	path = ext4_ext_find_extent(inode, lblk, NULL);
+	if (IS_ERR(path)) {
+		ret = PTR_ERR(path);
+	} else {
+		newex.ee_block = cpu_to_le32(lblk);
+		ext4_ext_store_pblock(&newex, pblk);
+		newex.ee_len = cpu_to_le16(len);
+		ret = ext4_ext_insert_extent(handle, inode, path, &newex, 0);
+		ext4_ext_drop_refs(path);
+		kfree(path);
+	}
+	ext4_ext_invalidate_cache(inode);
+	up_write(&EXT4_I(inode)->i_data_sem);
+
+	if (!ret) {
+		dquot_alloc_block_nofail(inode, len);
+		ret = ext4_mark_inode_dirty(handle, inode);
+	}
+	err = ext4_journal_stop(handle);
+	return ret ? ret : err;
+}
+
+/*
+ * Replay one logged range: in pass 0 claim the blocks which are not mapped
+ * yet, in pass 1 map them.  Blocks the inode has mapped already are left
+ * alone, which makes replay idempotent.
+ */
+static int ext4_fc_replay_range(struct inode *inode,
+				struct ext4_fc_range *range, int pass)
+{
+	ext4_lblk_t lblk = le32_to_cpu(range->fc_lblk);
+	unsigned int len = le32_to_cpu(range->fc_len);
+	ext4_fsblk_t pblk = le64_to_cpu(range->fc_pblk);
+	ext4_fsblk_t mapped;
+	int unwritten, n, ret = 0;
+
+	while (len && !ret) {
+		n = ext4_fc_lookup(inode, lblk, len, &mapped, &unwritten);
+		if (n < 0)
+			return n;
+		if (mapped) {
+			if (mapped != pblk || unwritten)
+				ret = -EEXIST;
+		} else if (pass == 0) {
+			ret = ext4_fc_claim(inode->i_sb, pblk, n);
+		} else {
+			ret = ext4_fc_insert(inode, lblk, pblk, n);
+		}
+		lblk += n;
+		pblk += n;
+		len -= n;
+	}
+	return ret;
+}
+
+static int ext4_fc_replay_inode(struct inode *inode, struct ext4_fc_block *fc)
+{
+	handle_t *handle;
+	int ret, err;
+
+	handle = ext4_journal_start(inode, 2);
+	if (IS_ERR(handle))
+		return PTR_ERR(handle);
+
+	EXT4_I(inode)->i_disksize = le64_to_cpu(fc->fc_disksize);
+	i_size_write(inode, EXT4_I(inode)->i_disksize);
+	inode->i_mtime.tv_sec = (signed)le32_to_cpu(fc->fc_mtime);
+	inode->i_mtime.tv_nsec = le32_to_cpu(fc->fc_mtime_nsec);
+	inode->i_ctime.tv_sec = (signed)le32_to_cpu(fc->fc_ctime);
+	inode->i_ctime.tv_nsec = le32_to_cpu(fc->fc_ctime_nsec);
+	ret = ext4_mark_inode_dirty(handle, inode);
+
+	err = ext4_journal_stop(handle);
+	return ret ? ret : err;
+}
+
+static void ext4_fc_replay_block(struct super_block *sb,
+				 struct ext4_fc_block *fc, int pass)
+{
+	unsigned long ino = le32_to_cpu(fc->fc_ino);
+	struct ext4_fc_range *range;
+	struct inode *inode;
+	int i, ret = 0;
+
+	inode = ext4_iget(sb, ino);
+	if (IS_ERR(inode)) {
+		if (pass == 0)
+			ext4_msg(sb, KERN_WARNING, "fast commit replay: "
+				 "can't read inode %lu (%ld)", ino,
+				 PTR_ERR(inode));
+		return;
+	}
+	if (!S_ISREG(inode->i_mode) ||
+	    !ext4_test_inode_flag(inode, EXT4_INODE_EXTENTS))
+		goto out;
+
+	for (i = 0; i < le16_to_cpu(fc->fc_nr_ranges); i++) {
+		range = &fc->fc_ranges[i];
+		if (!range->fc_len)
+			continue;
+		ret = ext4_fc_replay_range(inode, range, pass);
+		if (ret) {
+			ext4_msg(sb, KERN_WARNING, "fast commit replay: "
+				 "inode %lu: can't map %u blocks at %u to "
+				 "%llu (%d)", ino, le32_to_cpu(range->fc_len),
+				 le32_to_cpu(range->fc_lblk),
+				 le64_to_cpu(range->fc_pblk), ret);
+			/* Don't try to map what couldn't be claimed */
+			range->fc_len = 0;
+		}
+	}
+	if (pass == 1)
+		ret = ext4_fc_replay_inode(inode, fc);
+	if (ret)
+		ext4_msg(sb, KERN_WARNING, "fast commit replay: inode %lu: "
+			 "error %d", ino, ret);
+out:
+	iput(inode);
+}
+
+/*
+ * Every fast commit of an inode logs all it mapped since the transaction
+ * started, along with its latest size, so only the last block logged for
+ * an inode needs to be replayed.
+ */
+static bool ext4_fc_superseded(struct ext4_sb_info *sbi, int i)
+{
+	struct ext4_fc_block *fc = sbi->s_fc_replay[i];
+	int j;
+
+	for (j = i + 1; j < sbi->s_fc_replay_count; j++)
+		if (((struct ext4_fc_block *)sbi->s_fc_replay[j])->fc_ino ==
+		    fc->fc_ino)
+			return true;
+	return false;
+}
+
+/*
+ * Apply the fast commit blocks found by recovery, and commit the result.
+ * All logged blocks are claimed before any of them is mapped, so that
+ * allocations for the extent tree can't grab blocks logged further on.
+ */
+void ext4_fc_replay(struct super_block *sb)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	unsigned long s_flags = sb->s_flags;
+	int i, pass;
+
+	if (!sbi->s_fc_replay_count)
+		goto out;
+
+	if (s_flags & MS_RDONLY) {
+		ext4_msg(sb, KERN_INFO, "fast commit replay on readonly fs");
+		sb->s_flags &= ~MS_RDONLY;
+	}
+
+	for (pass = 0; pass < 2; pass++)
+		for (i = 0; i < sbi->s_fc_replay_count; i++)
+			if (!ext4_fc_superseded(sbi, i))
+				ext4_fc_replay_block(sb, sbi->s_fc_replay[i],
+						     pass);
+
+	ext4_msg(sb, KERN_INFO, "replayed %d fast commit blocks",
+		 sbi->s_fc_replay_count);
+	ext4_force_commit(sb);
+	sb->s_flags = s_flags;
+out:
+	ext4_fc_replay_cleanup(sb);
+}
+
+void ext4_fc_replay_cleanup(struct super_block *sb)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	int i;
+
+	for (i = 0; i < sbi->s_fc_replay_count; i++)
+		kfree(sbi->s_fc_replay[i]);
+	kfree(sbi->s_fc_replay);
+	sbi->s_fc_replay = NULL;
+	sbi->s_fc_replay_count = 0;
+}
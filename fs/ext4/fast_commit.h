@@ -0,0 +1,51 @@
+/*
+ * fs/ext4/fast_commit.h
+ *
+ * On-disk format of ext4 fast commit blocks.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef _EXT4_FAST_COMMIT_H
+#define _EXT4_FAST_COMMIT_H
+
+#include <linux/jbd2.h>
+
+/*
+ * A logically described mapping of fc_len blocks of the inode, starting at
+ * logical block fc_lblk, to physical blocks starting at fc_pblk.
+ */
+struct ext4_fc_range {
+	__le32	fc_lblk;
+	__le32	fc_len;
+	__le64	fc_pblk;
+};
+
+/*
+ * Each fast commit block describes the state of one inode as of the fsync
+ * which wrote it.  It starts with a standard journal header whose blocktype
+ * is JBD2_FC_BLOCK and whose sequence is the transaction it belongs to; the
+ * checksum covers everything past fc_crc, so the header may be restamped
+ * by recovery.
+ */
+struct ext4_fc_block {
+	journal_header_t fc_header;
+	__le16	fc_crc;		/* crc16 of the rest of the block */
+	__le16	fc_nr_ranges;	/* number of entries in fc_ranges[] */
+	__le32	fc_ino;
+	__le64	fc_disksize;
+	__le32	fc_mtime;
+	__le32	fc_mtime_nsec;
+	__le32	fc_ctime;
+	__le32	fc_ctime_nsec;
+	__le32	fc_reserved;
+	struct ext4_fc_range fc_ranges[0];
+};
+
+#define EXT4_FC_MAX_RANGES(sb)						\
+	(((sb)->s_blocksize - sizeof(struct ext4_fc_block)) /		\
+	 sizeof(struct ext4_fc_range))
+
+#endif /* _EXT4_FAST_COMMIT_H */
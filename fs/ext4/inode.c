@@ -471,6 +471,12 @@ int ext4_map_blocks(handle_t *handle, struct inode *inode,
 	 * of BH_Unwritten and BH_Mapped flags being simultaneously
 	 * set on the buffer_head.
 	 */
+	/*
+	 * Fast commits only log mappings, not the conversion of
+	 * uninitialized extents.
+	 */
+	if (map->m_flags & EXT4_MAP_UNWRITTEN)
+		ext4_fc_mark_ineligible(inode->i_sb, handle);
 	map->m_flags &= ~EXT4_MAP_UNWRITTEN;
 
 	/*
@@ -495,6 +501,12 @@ int ext4_map_blocks(handle_t *handle, struct inode *inode,
 	 */
 	if (ext4_test_inode_flag(inode, EXT4_INODE_EXTENTS)) {
 		retval = ext4_ext_map_blocks(handle, inode, map, flags);
+		if (retval > 0 && (flags & (EXT4_GET_BLOCKS_UNINIT_EXT |
+					    EXT4_GET_BLOCKS_PUNCH_OUT_EXT)))
+			ext4_fc_mark_ineligible(inode->i_sb, handle);
+		else if (retval > 0 && map->m_flags & EXT4_MAP_NEW)
+			ext4_fc_track_range(handle, inode, map->m_lblk,
+					    map->m_len);
 	} else {
 		retval = ext4_ind_map_blocks(handle, inode, map, flags);
 
@@ -3939,6 +3951,7 @@ int ext4_setattr(struct dentry *dentry, struct iattr *attr)
 	if (!rc) {
 		setattr_copy(inode, attr);
 		mark_inode_dirty(inode);
+		ext4_fc_mark_ineligible(inode->i_sb, NULL);
 	}
 
 	/*
@@ -108,6 +108,7 @@ long ext4_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 		}
 		if (IS_SYNC(inode))
 			ext4_handle_sync(handle);
+		ext4_fc_mark_ineligible(inode->i_sb, handle);
 		err = ext4_reserve_inode_write(handle, inode, &iloc);
 		if (err)
 			goto flags_err;
@@ -162,6 +163,7 @@ flags_out:
 			err = PTR_ERR(handle);
 			goto setversion_out;
 		}
+		ext4_fc_mark_ineligible(inode->i_sb, handle);
 		err = ext4_reserve_inode_write(handle, inode, &iloc);
 		if (err == 0) {
 			inode->i_ctime = ext4_current_time(inode);
@@ -214,6 +216,7 @@ setversion_out:
 			return err;
 
 		err = ext4_group_extend(sb, EXT4_SB(sb)->s_es, n_blocks_count);
+		ext4_fc_mark_ineligible(sb, NULL);
 		if (EXT4_SB(sb)->s_journal) {
 			jbd2_journal_lock_updates(EXT4_SB(sb)->s_journal);
 			err2 = jbd2_journal_flush(EXT4_SB(sb)->s_journal);
@@ -256,6 +259,7 @@ setversion_out:
 
 		err = ext4_move_extents(filp, donor_filp, me.orig_start,
 					me.donor_start, me.len, &me.moved_len);
+		ext4_fc_mark_ineligible(sb, NULL);
 		mnt_drop_write(filp->f_path.mnt);
 		if (me.moved_len > 0)
 			file_remove_suid(donor_filp);
@@ -286,6 +290,7 @@ mext_out:
 			return err;
 
 		err = ext4_group_add(sb, &input);
+		ext4_fc_mark_ineligible(sb, NULL);
 		if (EXT4_SB(sb)->s_journal) {
 			jbd2_journal_lock_updates(EXT4_SB(sb)->s_journal);
 			err2 = jbd2_journal_flush(EXT4_SB(sb)->s_journal);
@@ -2858,6 +2858,106 @@ out_err:
 	return err;
 }
 
+/*
+ * Mark @len blocks starting at @block, which must not cross a group
+ * boundary, in use on behalf of fast commit replay.  Blocks already marked
+ * in the on-disk bitmap are skipped, so replaying a range twice is fine.
+ * Fails with -EBUSY, leaving everything untouched, if any of them is only
+ * in use in the buddy cache, i.e. handed out since the filesystem was
+ * mounted.
+ */
+int ext4_mb_mark_bb(handle_t *handle, struct super_block *sb,
+		    ext4_fsblk_t block, int len)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct buffer_head *bitmap_bh, *gdp_bh;
+	struct ext4_group_desc *gdp;
+	struct ext4_free_extent ex;
+	struct ext4_buddy e4b;
+	ext4_group_t group;
+	ext4_grpblk_t blkoff;
+	int i, n, marked = 0, err;
+
+	ext4_get_group_no_and_offset(sb, block, &group, &blkoff);
+	if (len <= 0 || blkoff + len > EXT4_BLOCKS_PER_GROUP(sb) ||
+	    !ext4_data_block_valid(sbi, block, len))
+		return -EINVAL;
+
+	bitmap_bh = ext4_read_block_bitmap(sb, group);
+	if (!bitmap_bh)
+		return -EIO;
+
+	err = ext4_journal_get_write_access(handle, bitmap_bh);
+	if (err)
+		goto out;
+
+	err = -EIO;
+	gdp = ext4_get_group_desc(sb, group, &gdp_bh);
+	if (!gdp)
+		goto out;
+
+	err = ext4_journal_get_write_access(handle, gdp_bh);
+	if (err)
+		goto out;
+
+	err = ext4_mb_load_buddy(sb, group, &e4b);
+	if (err)
+		goto out;
+
+	ext4_lock_group(sb, group);
+	err = 0;
+	for (i = 0; i < len; i++) {
+		if (!mb_test_bit(blkoff + i, bitmap_bh->b_data) &&
+		    mb_test_bit(blkoff + i, EXT4_MB_BITMAP(&e4b))) {
+			err = -EBUSY;
+			break;
+		}
+	}
+	for (i = 0; !err && i < len; i += n) {
+		if (mb_test_bit(blkoff + i, bitmap_bh->b_data)) {
+			n = 1;
+			continue;
+		}
+		for (n = 1; i + n < len; n++)
+			if (mb_test_bit(blkoff + i + n, bitmap_bh->b_data))
+				break;
+		ex.fe_logical = 0;
+		ex.fe_group = group;
+		ex.fe_start = blkoff + i;
+		ex.fe_len = n;
+		mb_mark_used(&e4b, &ex);
+		ext4_set_bits(bitmap_bh->b_data, blkoff + i, n);
+		marked += n;
+	}
+	if (marked) {
+		if (gdp->bg_flags & cpu_to_le16(EXT4_BG_BLOCK_UNINIT)) {
+			gdp->bg_flags &= cpu_to_le16(~EXT4_BG_BLOCK_UNINIT);
+			ext4_free_blks_set(sb, gdp,
+				ext4_free_blocks_after_init(sb, group, gdp));
+		}
+		ext4_free_blks_set(sb, gdp,
+				   ext4_free_blks_count(sb, gdp) - marked);
+		gdp->bg_checksum = ext4_group_desc_csum(sbi, group, gdp);
+	}
+	ext4_unlock_group(sb, group);
+	ext4_mb_unload_buddy(&e4b);
+	if (err || !marked)
+		goto out;
+
+	percpu_counter_sub(&sbi->s_freeblocks_counter, marked);
+	if (sbi->s_log_groups_per_flex)
+		atomic_sub(marked, &sbi->s_flex_groups[ext4_flex_group(sbi,
+							group)].free_blocks);
+
+	err = ext4_handle_dirty_metadata(handle, NULL, bitmap_bh);
+	if (!err)
+		err = ext4_handle_dirty_metadata(handle, NULL, gdp_bh);
+	ext4_mark_super_dirty(sb);
+out:
+	brelse(bitmap_bh);
+	return err;
+}
+
 /*
  * here we normalize request for locality group
  * Group request are normalized to s_mb_group_prealloc, which goes to
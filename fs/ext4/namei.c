@@ -1456,6 +1456,7 @@ static int ext4_add_entry(handle_t *handle, struct dentry *dentry,
 
 	sb = dir->i_sb;
 	blocksize = sb->s_blocksize;
+	ext4_fc_mark_ineligible(sb, handle);
 	if (!dentry->d_name.len)
 		return -EINVAL;
 	if (is_dx(dir)) {
@@ -1646,6 +1647,7 @@ static int ext4_delete_entry(handle_t *handle,
 	unsigned int blocksize = dir->i_sb->s_blocksize;
 	int i, err;
 
+	ext4_fc_mark_ineligible(dir->i_sb, handle);
 	i = 0;
 	pde = NULL;
 	de = (struct ext4_dir_entry_2 *) bh->b_data;
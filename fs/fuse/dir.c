@@ -462,6 +462,7 @@ static int fuse_create_open(struct inode *dir, struct dentry *entry, int mode,
 		fuse_sync_release(ff, flags);
 		return PTR_ERR(file);
 	}
+	fuse_passthrough_setup(fc, ff, file, &outopen);
 	file->private_data = fuse_file_get(ff);
 	fuse_finish_open(inode, file);
 	return 0;
@@ -1076,6 +1077,142 @@ static int parse_dirfile(char *buf, size_t nbytes, struct file *file,
 	return 0;
 }
 
+/*
+ * Instantiate a dentry for an entry returned by READDIRPLUS, so that a
+ * following lookup or stat of the entry is served from the dcache.
+ *
+ * The filesystem counted a lookup for every entry with a nonzero
+ * nodeid.  A nonzero return means that no inode took over that count
+ * and the caller must send a FORGET for it.
+ */
+static int fuse_direntplus_link(struct file *file,
+				struct fuse_direntplus *direntplus,
+				u64 attr_version)
+{
+	struct fuse_entry_out *o = &direntplus->entry_out;
+	struct fuse_dirent *dirent = &direntplus->dirent;
+	struct dentry *parent = file->f_path.dentry;
+	struct inode *dir = parent->d_inode;
+	struct fuse_conn *fc = get_fuse_conn(dir);
+	struct qstr name;
+	struct dentry *dentry;
+	struct dentry *newent;
+	struct inode *inode;
+
+	name.name = dirent->name;
+	name.len = dirent->namelen;
+	/* Nothing to prime for "." and "..", nor a lookup counted */
+	if (name.name[0] == '.' &&
+	    (name.len == 1 || (name.len == 2 && name.name[1] == '.')))
+		return 0;
+
+	if (invalid_nodeid(o->nodeid) || !fuse_valid_type(o->attr.mode))
+		return -EIO;
+
+	name.hash = full_name_hash(name.name, name.len);
+
+	dentry = d_lookup(parent, &name);
+	if (dentry) {
+		inode = dentry->d_inode;
+		if (!inode) {
+			d_drop(dentry);
+		} else if (get_node_id(inode) != o->nodeid ||
+			   ((o->attr.mode ^ inode->i_mode) & S_IFMT) ||
+			   is_bad_inode(inode)) {
+			/* Leave it for ->d_revalidate() to sort out */
+			dput(dentry);
+			return -ESTALE;
+		} else {
+			struct fuse_inode *fi = get_fuse_inode(inode);
+
+			spin_lock(&fc->lock);
+			fi->nlookup++;
+			spin_unlock(&fc->lock);
+
+			fuse_change_attributes(inode, &o->attr,
+					       entry_attr_timeout(o),
+					       attr_version);
+			fuse_change_entry_timeout(dentry, o);
+			dput(dentry);
+			return 0;
+		}
+		dput(dentry);
+	}
+
+	dentry = d_alloc(parent, &name);
+	if (!dentry)
+		return -ENOMEM;
+
+	inode = fuse_iget(dir->i_sb, o->nodeid, o->generation,
+			  &o->attr, entry_attr_timeout(o), attr_version);
+	if (!inode) {
+		dput(dentry);
+		return -ENOMEM;
+	}
+
+	/* From here on the lookup count belongs to the inode */
+	if (S_ISDIR(inode->i_mode)) {
+		mutex_lock(&fc->inst_mutex);
+		newent = fuse_d_add_directory(dentry, inode);
+		mutex_unlock(&fc->inst_mutex);
+	} else {
+		newent = d_splice_alias(inode, dentry);
+	}
+	if (IS_ERR(newent)) {
+		iput(inode);
+	} else {
+		fuse_change_entry_timeout(newent ? newent : dentry, o);
+		dput(newent);
+	}
+	dput(dentry);
+
+	return 0;
+}
+
+static int parse_dirplusfile(char *buf, size_t nbytes, struct file *file,
+			     void *dstbuf, filldir_t filldir, u64 attr_version)
+{
+	struct fuse_conn *fc = get_fuse_conn(file->f_path.dentry->d_inode);
+	int over = 0;
+
+	while (nbytes >= FUSE_NAME_OFFSET_DIRENTPLUS) {
+		struct fuse_direntplus *direntplus =
+			(struct fuse_direntplus *) buf;
+		struct fuse_dirent *dirent = &direntplus->dirent;
+		size_t reclen = FUSE_DIRENTPLUS_SIZE(direntplus);
+
+		if (!dirent->namelen || dirent->namelen > FUSE_NAME_MAX)
+			return -EIO;
+		if (reclen > nbytes)
+			break;
+
+		/*
+		 * Keep linking entries after the user buffer is full: the
+		 * filesystem has already counted a lookup for each of them.
+		 */
+		if (!over) {
+			over = filldir(dstbuf, dirent->name, dirent->namelen,
+				       file->f_pos, dirent->ino, dirent->type);
+			if (!over)
+				file->f_pos = dirent->off;
+		}
+
+		buf += reclen;
+		nbytes -= reclen;
+
+		if (direntplus->entry_out.nodeid &&
+		    fuse_direntplus_link(file, direntplus, attr_version)) {
+			struct fuse_forget_link *forget = fuse_alloc_forget();
+
+			if (forget)
+				fuse_queue_forget(fc, forget,
+					direntplus->entry_out.nodeid, 1);
+		}
+	}
+
+	return 0;
+}
+
 static int fuse_readdir(struct file *file, void *dstbuf, filldir_t filldir)
 {
 	int err;
@@ -1084,6 +1221,7 @@ static int fuse_readdir(struct file *file, void *dstbuf, filldir_t filldir)
 	struct inode *inode = file->f_path.dentry->d_inode;
 	struct fuse_conn *fc = get_fuse_conn(inode);
 	struct fuse_req *req;
+	u64 attr_version = 0;
 
 	if (is_bad_inode(inode))
 		return -EIO;
@@ -1100,14 +1238,27 @@ static int fuse_readdir(struct file *file, void *dstbuf, filldir_t filldir)
 	req->out.argpages = 1;
 	req->num_pages = 1;
 	req->pages[0] = page;
-	fuse_read_fill(req, file, file->f_pos, PAGE_SIZE, FUSE_READDIR);
+	if (fc->do_readdirplus) {
+		attr_version = fuse_get_attr_version(fc);
+		fuse_read_fill(req, file, file->f_pos, PAGE_SIZE,
+			       FUSE_READDIRPLUS);
+	} else {
+		fuse_read_fill(req, file, file->f_pos, PAGE_SIZE,
+			       FUSE_READDIR);
+	}
 	fuse_request_send(fc, req);
 	nbytes = req->out.args[0].size;
 	err = req->out.h.error;
 	fuse_put_request(fc, req);
-	if (!err)
-		err = parse_dirfile(page_address(page), nbytes, file, dstbuf,
-				    filldir);
+	if (!err) {
+		if (fc->do_readdirplus)
+			err = parse_dirplusfile(page_address(page), nbytes,
+						file, dstbuf, filldir,
+						attr_version);
+		else
+			err = parse_dirfile(page_address(page), nbytes, file,
+					    dstbuf, filldir);
+	}
 
 	__free_page(page);
 	fuse_invalidate_attr(inode); /* atime changed */
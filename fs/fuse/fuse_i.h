@@ -22,6 +22,9 @@
 #include <linux/rbtree.h>
 #include <linux/poll.h>
 #include <linux/workqueue.h>
+#include <linux/idr.h>
+
+#define FUSE_SUPER_MAGIC 0x65735546
 
 /** Max number of pages that can be used in a single read request */
 #define FUSE_MAX_PAGES_PER_REQ 32
@@ -104,6 +107,15 @@ struct fuse_inode {
 
 struct fuse_conn;
 
+/** Backing file of a file opened in passthrough mode */
+struct fuse_passthrough {
+	/** File opened by the daemon on the lower filesystem */
+	struct file *filp;
+
+	/** Credentials of the daemon which registered the file */
+	const struct cred *cred;
+};
+
 /** FUSE specific file data */
 struct fuse_file {
 	/** Fuse connection for this file */
@@ -138,6 +150,9 @@ struct fuse_file {
 
 	/** Has flock been performed on this file? */
 	bool flock:1;
+
+	/** Backing file if opened with FOPEN_PASSTHROUGH, else NULL */
+	struct fuse_passthrough *passthrough;
 };
 
 /** One input argument of a request */
@@ -344,14 +359,12 @@ struct fuse_conn {
 	/** Maximum write size */
 	unsigned max_write;
 
-	/** Readers of the connection are waiting on this */
-	wait_queue_head_t waitq;
-
-	/** The list of pending requests */
-	struct list_head pending;
+	/** Device instances (struct fuse_dev) attached to this
+	    connection, one per open /dev/fuse file */
+	struct list_head devices;
 
-	/** The list of requests being processed */
-	struct list_head processing;
+	/** Number of entries on the devices list */
+	unsigned num_devices;
 
 	/** The list of requests under I/O */
 	struct list_head io;
@@ -478,6 +491,12 @@ struct fuse_conn {
 	/** Are BSD file locking primitives not implemented by fs? */
 	unsigned no_flock:1;
 
+	/** Does the filesystem support readdirplus? */
+	unsigned do_readdirplus:1;
+
+	/** May files be opened in passthrough mode?  Only set in INIT */
+	unsigned passthrough:1;
+
 	/** The number of requests waiting for completion */
 	atomic_t num_waiting;
 
@@ -519,6 +538,37 @@ struct fuse_conn {
 
 	/** Read/write semaphore to hold when accessing sb. */
 	struct rw_semaphore killsb;
+
+	/** Backing files registered for passthrough, not yet claimed by
+	    an OPEN reply.  Protected by fc->lock */
+	struct idr passthrough_req;
+};
+
+/**
+ * A /dev/fuse file attached to a connection
+ *
+ * The daemon may attach further files to an existing connection with
+ * FUSE_DEV_IOC_CLONE, typically one per CPU.  Each of them has its own
+ * input and processing queue: requests are queued to the device
+ * serving the submitting CPU, and a reply must be written to the same
+ * file the request was read from.  All fields are protected by
+ * fc->lock.
+ */
+struct fuse_dev {
+	/** Connection this device belongs to */
+	struct fuse_conn *fc;
+
+	/** Entry on fc->devices */
+	struct list_head entry;
+
+	/** Readers of this device are waiting on this */
+	wait_queue_head_t waitq;
+
+	/** The list of pending requests routed to this device */
+	struct list_head pending;
+
+	/** The list of requests read from this device awaiting reply */
+	struct list_head processing;
 };
 
 static inline struct fuse_conn *get_fuse_conn_super(struct super_block *sb)
@@ -633,6 +683,21 @@ void fuse_change_attributes(struct inode *inode, struct fuse_attr *attr,
 void fuse_change_attributes_common(struct inode *inode, struct fuse_attr *attr,
 				   u64 attr_valid);
 
+/**
+ * Attach a new device instance to a connection
+ */
+struct fuse_dev *fuse_dev_alloc(struct fuse_conn *fc);
+
+/**
+ * Detach and free a device instance not yet installed in a file
+ */
+void fuse_dev_free(struct fuse_dev *fud);
+
+/**
+ * Wake up every reader of the connection.  Called with fc->lock
+ */
+void fuse_wake_readers(struct fuse_conn *fc);
+
 /**
  * Initialize the client device
  */
@@ -770,4 +835,22 @@ int fuse_dev_release(struct inode *inode, struct file *file);
 
 void fuse_write_update_size(struct inode *inode, loff_t pos);
 
+/* passthrough.c */
+int fuse_passthrough_open(struct fuse_conn *fc,
+			  struct fuse_passthrough_out *pto);
+void fuse_passthrough_setup(struct fuse_conn *fc, struct fuse_file *ff,
+			    struct file *file, struct fuse_open_out *openarg);
+void fuse_passthrough_release(struct fuse_passthrough *passthrough);
+void fuse_passthrough_cleanup(struct fuse_conn *fc);
+ssize_t fuse_passthrough_aio_read(struct kiocb *iocb, const struct iovec *iov,
+				  unsigned long nr_segs, loff_t pos);
+ssize_t fuse_passthrough_aio_write(struct kiocb *iocb,
+				   const struct iovec *iov,
+				   unsigned long nr_segs, loff_t pos);
+ssize_t fuse_passthrough_splice_read(struct file *in, loff_t *ppos,
+				     struct pipe_inode_info *pipe,
+				     size_t len, unsigned int flags);
+int fuse_passthrough_fsync(struct file *file, loff_t start, loff_t end,
+			   int datasync);
+
 #endif /* _FS_FUSE_I_H */
@@ -0,0 +1,263 @@
+/*
+  FUSE: Filesystem in Userspace
+
+  Passthrough of reads and writes to a backing file opened by the
+  filesystem daemon, bypassing the round trip to userspace and the
+  copy through the FUSE page cache.
+
+  This program can be distributed under the terms of the GNU GPL.
+  See the file COPYING.
+*/
+
+#include "fuse_i.h"
+
+#include <linux/aio.h>
+#include <linux/cred.h>
+#include <linux/file.h>
+#include <linux/fsnotify.h>
+#include <linux/slab.h>
+#include <linux/uio.h>
+
+void fuse_passthrough_release(struct fuse_passthrough *passthrough)
+{
+	fput(passthrough->filp);
+	put_cred(passthrough->cred);
+	kfree(passthrough);
+}
+
+/*
+ * Register the file behind @pto->fd as a passthrough target.  The
+ * returned id is handed back in the passthrough_fh of an OPEN or CREATE
+ * reply with FOPEN_PASSTHROUGH set, which claims the registration.
+ *
+ * I/O on the backing file is done with the credentials of the caller,
+ * i.e. the daemon, so that opening a FUSE file still goes through the
+ * daemon's access checks but no further privileges are lent to the
+ * opener.
+ */
+int fuse_passthrough_open(struct fuse_conn *fc,
+			  struct fuse_passthrough_out *pto)
+{
+	struct fuse_passthrough *passthrough;
+	struct file *filp;
+	int err;
+	int id;
+
+	if (!fc->passthrough)
+		return -EPERM;
+	if (pto->flags)
+		return -EINVAL;
+
+	filp = fget(pto->fd);
+	if (!filp)
+		return -EBADF;
+
+	err = -EINVAL;
+	if (!S_ISREG(filp->f_path.dentry->d_inode->i_mode) || !filp->f_op ||
+	    !filp->f_op->aio_read || !filp->f_op->aio_write)
+		goto out_fput;
+	/* Passing through to another FUSE file could recurse */
+	if (filp->f_path.dentry->d_sb->s_magic == FUSE_SUPER_MAGIC)
+		goto out_fput;
+
+	err = -ENOMEM;
+	passthrough = kmalloc(sizeof(*passthrough), GFP_KERNEL);
+	if (!passthrough)
+		goto out_fput;
+
+	passthrough->filp = filp;
+	passthrough->cred = get_current_cred();
+
+	do {
+		err = -ENOMEM;
+		if (!idr_pre_get(&fc->passthrough_req, GFP_KERNEL))
+			goto out_release;
+
+		spin_lock(&fc->lock);
+		err = idr_get_new_above(&fc->passthrough_req, passthrough, 1,
+					&id);
+		spin_unlock(&fc->lock);
+	} while (err == -EAGAIN);
+	if (err)
+		goto out_release;
+
+	return id;
+
+ out_release:
+	fuse_passthrough_release(passthrough);
+	return err;
+
+ out_fput:
+	fput(filp);
+	return err;
+}
+
+/*
+ * Claim the backing file named by an OPEN reply.  If it is missing or
+ * was not opened for the access mode of @file, the file silently falls
+ * back to regular FUSE I/O.
+ */
+void fuse_passthrough_setup(struct fuse_conn *fc, struct fuse_file *ff,
+			    struct file *file, struct fuse_open_out *openarg)
+{
+	struct fuse_passthrough *passthrough;
+	fmode_t mode = file->f_mode & (FMODE_READ | FMODE_WRITE);
+
+	if (!(openarg->open_flags & FOPEN_PASSTHROUGH) ||
+	    !openarg->passthrough_fh)
+		return;
+
+	spin_lock(&fc->lock);
+	passthrough = idr_find(&fc->passthrough_req, openarg->passthrough_fh);
+	if (passthrough)
+		idr_remove(&fc->passthrough_req, openarg->passthrough_fh);
+	spin_unlock(&fc->lock);
+
+	if (!passthrough)
+		return;
+
+	if ((passthrough->filp->f_mode & mode) != mode) {
+		fuse_passthrough_release(passthrough);
+		return;
+	}
+	ff->passthrough = passthrough;
+}
+
+static int fuse_passthrough_idr_free(int id, void *p, void *data)
+{
+	fuse_passthrough_release(p);
+	return 0;
+}
+
+/* Drop backing files registered but never claimed by an OPEN reply */
+void fuse_passthrough_cleanup(struct fuse_conn *fc)
+{
+	idr_for_each(&fc->passthrough_req, fuse_passthrough_idr_free, NULL);
+	idr_remove_all(&fc->passthrough_req);
+	idr_destroy(&fc->passthrough_req);
+}
+
+static ssize_t fuse_passthrough_rw(struct file *filp, const struct iovec *iov,
+				   unsigned long nr_segs, loff_t *ppos, int rw)
+{
+	struct kiocb kiocb;
+	size_t len = iov_length(iov, nr_segs);
+	ssize_t ret;
+
+	init_sync_kiocb(&kiocb, filp);
+	kiocb.ki_pos = *ppos;
+	kiocb.ki_left = len;
+	kiocb.ki_nbytes = len;
+
+	if (rw == WRITE)
+		ret = filp->f_op->aio_write(&kiocb, iov, nr_segs, kiocb.ki_pos);
+	else
+		ret = filp->f_op->aio_read(&kiocb, iov, nr_segs, kiocb.ki_pos);
+	if (ret == -EIOCBQUEUED)
+		ret = wait_on_sync_kiocb(&kiocb);
+	*ppos = kiocb.ki_pos;
+
+	return ret;
+}
+
+/* Refresh the FUSE inode from the backing inode after a write */
+static void fuse_passthrough_copyattr(struct inode *inode,
+				      struct inode *backing)
+{
+	struct fuse_conn *fc = get_fuse_conn(inode);
+	struct fuse_inode *fi = get_fuse_inode(inode);
+
+	spin_lock(&fc->lock);
+	fi->attr_version = ++fc->attr_version;
+	i_size_write(inode, i_size_read(backing));
+	inode->i_mtime = backing->i_mtime;
+	inode->i_ctime = backing->i_ctime;
+	spin_unlock(&fc->lock);
+}
+
+ssize_t fuse_passthrough_aio_read(struct kiocb *iocb, const struct iovec *iov,
+				  unsigned long nr_segs, loff_t pos)
+{
+	struct fuse_file *ff = iocb->ki_filp->private_data;
+	struct file *backing = ff->passthrough->filp;
+	const struct cred *old_cred;
+	ssize_t ret;
+
+	old_cred = override_creds(ff->passthrough->cred);
+	ret = fuse_passthrough_rw(backing, iov, nr_segs, &pos, READ);
+	revert_creds(old_cred);
+
+	if (ret > 0) {
+		iocb->ki_pos = pos;
+		fsnotify_access(backing);
+	}
+	return ret;
+}
+
+ssize_t fuse_passthrough_aio_write(struct kiocb *iocb,
+				   const struct iovec *iov,
+				   unsigned long nr_segs, loff_t pos)
+{
+	struct file *file = iocb->ki_filp;
+	struct fuse_file *ff = file->private_data;
+	struct inode *inode = file->f_mapping->host;
+	struct file *backing = ff->passthrough->filp;
+	struct inode *backing_inode = backing->f_mapping->host;
+	const struct cred *old_cred;
+	ssize_t ret;
+
+	mutex_lock(&inode->i_mutex);
+	if (file->f_flags & O_APPEND)
+		pos = i_size_read(backing_inode);
+
+	old_cred = override_creds(ff->passthrough->cred);
+	ret = fuse_passthrough_rw(backing, iov, nr_segs, &pos, WRITE);
+	revert_creds(old_cred);
+
+	if (ret > 0) {
+		iocb->ki_pos = pos;
+		fsnotify_modify(backing);
+		fuse_passthrough_copyattr(inode, backing_inode);
+		/* Pages cached through a shared mmap are stale now */
+		if (inode->i_mapping->nrpages)
+			invalidate_inode_pages2_range(inode->i_mapping,
+					(pos - ret) >> PAGE_CACHE_SHIFT,
+					(pos - 1) >> PAGE_CACHE_SHIFT);
+	}
+	mutex_unlock(&inode->i_mutex);
+
+	return ret;
+}
+
+ssize_t fuse_passthrough_splice_read(struct file *in, loff_t *ppos,
+				     struct pipe_inode_info *pipe,
+				     size_t len, unsigned int flags)
+{
+	struct fuse_file *ff = in->private_data;
+	struct file *backing = ff->passthrough->filp;
+	const struct cred *old_cred;
+	ssize_t ret;
+
+	if (!backing->f_op->splice_read)
+		return -EINVAL;
+
+	old_cred = override_creds(ff->passthrough->cred);
+	ret = backing->f_op->splice_read(backing, ppos, pipe, len, flags);
+	revert_creds(old_cred);
+
+	return ret;
+}
+
+int fuse_passthrough_fsync(struct file *file, loff_t start, loff_t end,
+			   int datasync)
+{
+	struct fuse_file *ff = file->private_data;
+	const struct cred *old_cred;
+	int err;
+
+	old_cred = override_creds(ff->passthrough->cred);
+	err = vfs_fsync_range(ff->passthrough->filp, start, end, datasync);
+	revert_creds(old_cred);
+
+	return err;
+}
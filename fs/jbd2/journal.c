@@ -662,6 +662,142 @@ int jbd2_log_wait_commit(journal_t *journal, tid_t tid)
 	return err;
 }
 
+/*
+ * Fast commits
+ *
+ * A fast commit lets the filesystem make a small, logically described
+ * change durable without committing the whole running transaction.  The
+ * filesystem encodes the change itself into one or more blocks of the
+ * fast commit area reserved at the end of the journal; on recovery those
+ * blocks are handed back to it via j_fc_replay_callback if, and only if,
+ * they belong to the transaction that was running at the time of the
+ * crash.  A full commit of that transaction makes them obsolete, so the
+ * area is simply reused from its start by the next transaction.
+ */
+
+/**
+ * int jbd2_fc_begin_commit() - start a fast commit of a running transaction
+ * @journal: Journal to act on.
+ * @tid: Transaction the caller wants to make durable.
+ *
+ * Returns 0 if the caller may go ahead writing fast commit blocks for @tid,
+ * -EALREADY if @tid is committed already, and -EINVAL if @tid is not the
+ * running transaction, is being fully committed or the log start could not
+ * be recorded in the superblock, in which case the caller should fall back
+ * to jbd2_log_wait_commit().  Only one fast commit may be in progress at a
+ * time; the caller must finish it with jbd2_fc_end_commit().
+ */
+int jbd2_fc_begin_commit(journal_t *journal, tid_t tid)
+{
+	if (!JBD2_HAS_INCOMPAT_FEATURE(journal,
+				       JBD2_FEATURE_INCOMPAT_FAST_COMMIT))
+		return -EOPNOTSUPP;
+	if (is_journal_aborted(journal))
+		return -EIO;
+
+	write_lock(&journal->j_state_lock);
+	while (1) {
+		DEFINE_WAIT(wait);
+
+		if (tid_geq(journal->j_commit_sequence, tid)) {
+			write_unlock(&journal->j_state_lock);
+			return -EALREADY;
+		}
+		if ((journal->j_flags & JBD2_FULL_COMMIT_ONGOING) ||
+		    !journal->j_running_transaction ||
+		    journal->j_running_transaction->t_tid != tid) {
+			write_unlock(&journal->j_state_lock);
+			return -EINVAL;
+		}
+		if (!(journal->j_flags & JBD2_FAST_COMMIT_ONGOING))
+			break;
+
+		prepare_to_wait(&journal->j_fc_wait, &wait,
+				TASK_UNINTERRUPTIBLE);
+		write_unlock(&journal->j_state_lock);
+		schedule();
+		finish_wait(&journal->j_fc_wait, &wait);
+		write_lock(&journal->j_state_lock);
+	}
+	journal->j_flags |= JBD2_FAST_COMMIT_ONGOING;
+	write_unlock(&journal->j_state_lock);
+
+	/*
+	 * After jbd2_journal_flush() the superblock says s_start == 0 until
+	 * the next full commit, and recovery would not look for fast commit
+	 * blocks at all.  Record the log start now, as the commit code does,
+	 * so that recovery scans for the running transaction.
+	 */
+	if (journal->j_flags & JBD2_FLUSHED) {
+		jbd2_journal_update_superblock(journal, 1);
+		if (!journal->j_superblock->s_start) {
+			jbd2_fc_end_commit(journal);
+			return -EINVAL;
+		}
+	}
+	return 0;
+}
+EXPORT_SYMBOL(jbd2_fc_begin_commit);
+
+/**
+ * int jbd2_fc_get_buf() - get the next free fast commit block
+ * @journal: Journal to act on.
+ * @bh_out: Where to return the buffer.
+ *
+ * Must be called between jbd2_fc_begin_commit() and jbd2_fc_end_commit().
+ * The returned buffer is zeroed and uptodate; the caller fills it in,
+ * writes it out and releases it.  Returns -ENOSPC once the fast commit
+ * area is full, after which only a full commit can make progress.
+ */
+int jbd2_fc_get_buf(journal_t *journal, struct buffer_head **bh_out)
+{
+	unsigned long long pblock;
+	unsigned long blocknr;
+	struct buffer_head *bh;
+	int err;
+
+	J_ASSERT(journal->j_flags & JBD2_FAST_COMMIT_ONGOING);
+
+	write_lock(&journal->j_state_lock);
+	if (journal->j_fc_first + journal->j_fc_off >= journal->j_fc_last) {
+		write_unlock(&journal->j_state_lock);
+		return -ENOSPC;
+	}
+	blocknr = journal->j_fc_first + journal->j_fc_off++;
+	write_unlock(&journal->j_state_lock);
+
+	err = jbd2_journal_bmap(journal, blocknr, &pblock);
+	if (err)
+		return err;
+
+	bh = __getblk(journal->j_dev, pblock, journal->j_blocksize);
+	if (!bh)
+		return -ENOMEM;
+	lock_buffer(bh);
+	memset(bh->b_data, 0, journal->j_blocksize);
+	set_buffer_uptodate(bh);
+	unlock_buffer(bh);
+
+	*bh_out = bh;
+	return 0;
+}
+EXPORT_SYMBOL(jbd2_fc_get_buf);
+
+/**
+ * void jbd2_fc_end_commit() - finish a fast commit
+ * @journal: Journal to act on.
+ *
+ * Let the next fast commit, or a full commit waiting for this one, go.
+ */
+void jbd2_fc_end_commit(journal_t *journal)
+{
+	write_lock(&journal->j_state_lock);
+	journal->j_flags &= ~JBD2_FAST_COMMIT_ONGOING;
+	write_unlock(&journal->j_state_lock);
+	wake_up(&journal->j_fc_wait);
+}
+EXPORT_SYMBOL(jbd2_fc_end_commit);
+
 /*
  * Log buffer allocation routines:
  */
@@ -894,6 +1030,7 @@ static journal_t * journal_init_common (void)
 	init_waitqueue_head(&journal->j_wait_checkpoint);
 	init_waitqueue_head(&journal->j_wait_commit);
 	init_waitqueue_head(&journal->j_wait_updates);
+	init_waitqueue_head(&journal->j_fc_wait);
 	mutex_init(&journal->j_barrier);
 	mutex_init(&journal->j_checkpoint_mutex);
 	spin_lock_init(&journal->j_revoke_lock);
@@ -1078,6 +1215,24 @@ static void journal_fail_superblock (journal_t *journal)
 	journal->j_sb_buffer = NULL;
 }
 
+/*
+ * Carve the fast commit area, if the journal has one, out of the end of
+ * the log.  Sets j_last accordingly.
+ */
+static void journal_fc_setup(journal_t *journal)
+{
+	unsigned long last = be32_to_cpu(journal->j_superblock->s_maxlen);
+
+	if (JBD2_HAS_INCOMPAT_FEATURE(journal,
+				      JBD2_FEATURE_INCOMPAT_FAST_COMMIT))
+		journal->j_fc_first = last - JBD2_FC_BLOCKS;
+	else
+		journal->j_fc_first = last;
+	journal->j_fc_last = last;
+	journal->j_fc_off = 0;
+	journal->j_last = journal->j_fc_first;
+}
+
 /*
  * Given a journal_t structure, initialise the various fields for
  * startup of a new journaling session.  We use this both when creating
@@ -1100,11 +1255,17 @@ static int journal_reset(journal_t *journal)
 	}
 
 	journal->j_first = first;
-	journal->j_last = last;
+	journal_fc_setup(journal);
+	if (journal->j_last - first < JBD2_MIN_JOURNAL_BLOCKS) {
+		printk(KERN_ERR "JBD: Journal too short for fast commits "
+		       "(blocks %llu-%llu).\n", first, last);
+		journal_fail_superblock(journal);
+		return -EINVAL;
+	}
 
 	journal->j_head = first;
 	journal->j_tail = first;
-	journal->j_free = last - first;
+	journal->j_free = journal->j_last - first;
 
 	journal->j_tail_sequence = journal->j_transaction_sequence;
 	journal->j_commit_sequence = journal->j_transaction_sequence - 1;
@@ -1285,7 +1446,7 @@ static int load_superblock(journal_t *journal)
 	journal->j_tail_sequence = be32_to_cpu(sb->s_sequence);
 	journal->j_tail = be32_to_cpu(sb->s_start);
 	journal->j_first = be32_to_cpu(sb->s_first);
-	journal->j_last = be32_to_cpu(sb->s_maxlen);
+	journal_fc_setup(journal);
 	journal->j_errno = be32_to_cpu(sb->s_errno);
 
 	return 0;
@@ -1487,6 +1648,30 @@ int jbd2_journal_check_available_features (journal_t *journal, unsigned long com
 	return 0;
 }
 
+/*
+ * The fast commit feature has just been switched on or off: move the end
+ * of the log accordingly.  This is only safe while the log is empty, and
+ * the superblock must reach the disk before the log can grow into (or
+ * fast commits be written to) the blocks which changed hands.
+ */
+static void journal_fc_update(journal_t *journal)
+{
+	unsigned long old_last;
+
+	if (!(journal->j_flags & JBD2_LOADED))
+		return;
+
+	write_lock(&journal->j_state_lock);
+	J_ASSERT(journal->j_head == journal->j_tail);
+	old_last = journal->j_last;
+	journal_fc_setup(journal);
+	journal->j_free = journal->j_free + journal->j_last - old_last;
+	write_unlock(&journal->j_state_lock);
+
+	mark_buffer_dirty(journal->j_sb_buffer);
+	sync_dirty_buffer(journal->j_sb_buffer);
+}
+
 /**
  * int jbd2_journal_set_features () - Mark a given journal feature in the superblock
  * @journal: Journal to act on.
@@ -1510,6 +1695,11 @@ int jbd2_journal_set_features (journal_t *journal, unsigned long compat,
 	if (!jbd2_journal_check_available_features(journal, compat, ro, incompat))
 		return 0;
 
+	if ((incompat & JBD2_FEATURE_INCOMPAT_FAST_COMMIT) &&
+	    journal->j_last - journal->j_first <
+			JBD2_MIN_JOURNAL_BLOCKS + JBD2_FC_BLOCKS)
+		return 0;
+
 	jbd_debug(1, "Setting new features 0x%lx/0x%lx/0x%lx\n",
 		  compat, ro, incompat);
 
@@ -1519,6 +1709,9 @@ int jbd2_journal_set_features (journal_t *journal, unsigned long compat,
 	sb->s_feature_ro_compat |= cpu_to_be32(ro);
 	sb->s_feature_incompat  |= cpu_to_be32(incompat);
 
+	if (incompat & JBD2_FEATURE_INCOMPAT_FAST_COMMIT)
+		journal_fc_update(journal);
+
 	return 1;
 }
 
@@ -1543,9 +1736,16 @@ void jbd2_journal_clear_features(journal_t *journal, unsigned long compat,
 
 	sb = journal->j_superblock;
 
+	if (!JBD2_HAS_INCOMPAT_FEATURE(journal,
+				       JBD2_FEATURE_INCOMPAT_FAST_COMMIT))
+		incompat &= ~JBD2_FEATURE_INCOMPAT_FAST_COMMIT;
+
 	sb->s_feature_compat    &= ~cpu_to_be32(compat);
 	sb->s_feature_ro_compat &= ~cpu_to_be32(ro);
 	sb->s_feature_incompat  &= ~cpu_to_be32(incompat);
+
+	if (incompat & JBD2_FEATURE_INCOMPAT_FAST_COMMIT)
+		journal_fc_update(journal);
 }
 EXPORT_SYMBOL(jbd2_journal_clear_features);
 
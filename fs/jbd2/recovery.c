@@ -210,6 +210,58 @@ do {									\
 		var -= ((journal)->j_last - (journal)->j_first);	\
 } while (0)
 
+/*
+ * Hand the fast commit blocks of transaction @tid, the one which was
+ * running when the journal was last used, to the filesystem.  The log is
+ * about to be restarted at transaction @next_tid; if that differs from
+ * @tid, the blocks are restamped with it so that they stay valid until
+ * the filesystem has applied them and committed the result.
+ */
+static int fc_do_one_pass(journal_t *journal, tid_t tid, tid_t next_tid)
+{
+	struct buffer_head *bh;
+	journal_header_t *header;
+	unsigned long blocknr;
+	int err = 0, off = 0;
+
+	if (!journal->j_fc_replay_callback ||
+	    !JBD2_HAS_INCOMPAT_FEATURE(journal,
+				       JBD2_FEATURE_INCOMPAT_FAST_COMMIT))
+		return 0;
+
+	for (blocknr = journal->j_fc_first; blocknr < journal->j_fc_last;
+	     blocknr++, off++) {
+		err = jread(&bh, journal, blocknr);
+		if (err)
+			break;
+
+		header = (journal_header_t *)bh->b_data;
+		if (header->h_magic != cpu_to_be32(JBD2_MAGIC_NUMBER) ||
+		    header->h_blocktype != cpu_to_be32(JBD2_FC_BLOCK) ||
+		    header->h_sequence != cpu_to_be32(tid)) {
+			brelse(bh);
+			break;
+		}
+
+		/* A positive return tells us to stop here */
+		err = journal->j_fc_replay_callback(journal, bh, off, tid);
+		if (!err && tid != next_tid) {
+			header->h_sequence = cpu_to_be32(next_tid);
+			mark_buffer_dirty(bh);
+			sync_dirty_buffer(bh);
+			if (buffer_write_io_error(bh))
+				err = -EIO;
+		}
+		brelse(bh);
+		if (err)
+			break;
+	}
+
+	jbd_debug(1, "JBD: found %d fast commit blocks for transaction %u\n",
+		  off, tid);
+	return err < 0 ? err : 0;
+}
+
 /**
  * jbd2_journal_recover - recovers a on-disk journal
  * @journal: the journal to recover
@@ -238,6 +290,10 @@ int jbd2_journal_recover(journal_t *journal)
 	 * unmounted.
 	 */
 
+	/*
+	 * jbd2_fc_begin_commit() records the log start before the first fast
+	 * commit after a flush, so a clean journal has none to replay.
+	 */
 	if (!sb->s_start) {
 		jbd_debug(1, "No recovery required, last transaction %d\n",
 			  be32_to_cpu(sb->s_sequence));
@@ -257,6 +313,10 @@ int jbd2_journal_recover(journal_t *journal)
 	jbd_debug(1, "JBD: Replayed %d and revoked %d/%d blocks\n",
 		  info.nr_replays, info.nr_revoke_hits, info.nr_revokes);
 
+	if (!err)
+		err = fc_do_one_pass(journal, info.end_transaction,
+				     info.end_transaction + 1);
+
 	/* Restart the log at the next transaction ID, thus invalidating
 	 * any existing commit records in the log. */
 	journal->j_transaction_sequence = ++info.end_transaction;
@@ -858,6 +858,168 @@ const struct file_operations proc_pagemap_operations = {
 };
 #endif /* CONFIG_PROC_PAGE_MONITOR */
 
+#ifdef CONFIG_PROCESS_RECLAIM
+struct reclaim_result {
+	unsigned long nr_reclaimed;
+	unsigned long nr_scanned;
+};
+
+struct reclaim_param {
+	struct vm_area_struct *vma;
+	struct reclaim_result result;
+};
+
+static int reclaim_pte_range(pmd_t *pmd, unsigned long addr,
+				unsigned long end, struct mm_walk *walk)
+{
+	struct reclaim_param *rp = walk->private;
+	struct vm_area_struct *vma = rp->vma;
+	pte_t *pte, ptent;
+	spinlock_t *ptl;
+	struct page *page;
+	LIST_HEAD(page_list);
+
+	split_huge_page_pmd(walk->mm, pmd);
+
+	pte = pte_offset_map_lock(vma->vm_mm, pmd, addr, &ptl);
+	for (; addr != end; pte++, addr += PAGE_SIZE) {
+		ptent = *pte;
+		if (!pte_present(ptent))
+			continue;
+
+		page = vm_normal_page(vma, addr, ptent);
+		if (!page)
+			continue;
+
+		rp->result.nr_scanned++;
+		/* Pages shared with other processes are left to kswapd */
+		if (page_mapcount(page) != 1)
+			continue;
+		if (isolate_lru_page(page))
+			continue;
+		list_add(&page->lru, &page_list);
+	}
+	pte_unmap_unlock(pte - 1, ptl);
+
+	rp->result.nr_reclaimed += reclaim_pages_from_list(&page_list);
+	cond_resched();
+	if (fatal_signal_pending(current))
+		return -EINTR;
+	return 0;
+}
+
+enum reclaim_type {
+	RECLAIM_FILE,
+	RECLAIM_ANON,
+	RECLAIM_ALL,
+};
+
+static ssize_t reclaim_write(struct file *file, const char __user *buf,
+				size_t count, loff_t *ppos)
+{
+	struct reclaim_result *rr = file->private_data;
+	struct reclaim_param rp = { };
+	struct task_struct *task;
+	char buffer[PROC_NUMBUF];
+	struct mm_struct *mm;
+	struct vm_area_struct *vma;
+	enum reclaim_type type;
+	char *type_buf;
+
+	memset(buffer, 0, sizeof(buffer));
+	if (count > sizeof(buffer) - 1)
+		count = sizeof(buffer) - 1;
+	if (copy_from_user(buffer, buf, count))
+		return -EFAULT;
+
+	type_buf = strstrip(buffer);
+	if (!strcmp(type_buf, "file"))
+		type = RECLAIM_FILE;
+	else if (!strcmp(type_buf, "anon"))
+		type = RECLAIM_ANON;
+	else if (!strcmp(type_buf, "all"))
+		type = RECLAIM_ALL;
+	else
+		return -EINVAL;
+
+	task = get_proc_task(file->f_path.dentry->d_inode);
+	if (!task)
+		return -ESRCH;
+
+	mm = get_task_mm(task);
+	if (mm) {
+		struct mm_walk reclaim_walk = {
+			.pmd_entry = reclaim_pte_range,
+			.mm = mm,
+			.private = &rp,
+		};
+
+		/* Get the pages sitting in this CPU's pagevecs onto the LRU */
+		lru_add_drain();
+		down_read(&mm->mmap_sem);
+		for (vma = mm->mmap; vma; vma = vma->vm_next) {
+			if (is_vm_hugetlb_page(vma))
+				continue;
+			if (vma->vm_flags & (VM_LOCKED | VM_PFNMAP))
+				continue;
+			if (type == RECLAIM_ANON && vma->vm_file)
+				continue;
+			if (type == RECLAIM_FILE && !vma->vm_file)
+				continue;
+			rp.vma = vma;
+			if (walk_page_range(vma->vm_start, vma->vm_end,
+					&reclaim_walk))
+				break;
+		}
+		up_read(&mm->mmap_sem);
+		mmput(mm);
+	}
+	put_task_struct(task);
+	*rr = rp.result;
+
+	return count;
+}
+
+/*
+ * Reading gives the result of the last reclaim written through the same
+ * open file, so that a manager can pwrite() and then pread() one fd.
+ */
+static ssize_t reclaim_read(struct file *file, char __user *buf,
+				size_t count, loff_t *ppos)
+{
+	struct reclaim_result *rr = file->private_data;
+	char buffer[64];
+	size_t len;
+
+	len = snprintf(buffer, sizeof(buffer), "reclaimed %lu\nscanned %lu\n",
+		       rr->nr_reclaimed, rr->nr_scanned);
+	return simple_read_from_buffer(buf, count, ppos, buffer, len);
+}
+
+static int reclaim_open(struct inode *inode, struct file *file)
+{
+	file->private_data = kzalloc(sizeof(struct reclaim_result),
+				     GFP_KERNEL);
+	if (!file->private_data)
+		return -ENOMEM;
+	return 0;
+}
+
+static int reclaim_release(struct inode *inode, struct file *file)
+{
+	kfree(file->private_data);
+	return 0;
+}
+
+const struct file_operations proc_reclaim_operations = {
+	.open		= reclaim_open,
+	.read		= reclaim_read,
+	.write		= reclaim_write,
+	.llseek		= default_llseek,
+	.release	= reclaim_release,
+};
+#endif /* CONFIG_PROCESS_RECLAIM */
+
 #ifdef CONFIG_NUMA
 
 struct numa_maps {
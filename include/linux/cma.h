@@ -0,0 +1,76 @@
+#ifndef _LINUX_CMA_H
+#define _LINUX_CMA_H
+
+/*
+ * Contiguous Memory Allocator
+ *
+ * A CMA area is a range of physical memory reserved by platform code
+ * at boot.  Its pageblocks are given to the page allocator as
+ * MIGRATE_CMA, so they back movable allocations (page cache, anonymous
+ * memory) for as long as nobody needs them.  A driver claiming a range
+ * of the area gets it back by migrating those pages away.
+ *
+ * Areas have to be declared from the machine's ->reserve() callback,
+ * while memblock is still the boot memory allocator; they are handed
+ * over to the page allocator from a core_initcall.
+ */
+
+#include <linux/errno.h>
+#include <linux/types.h>
+
+struct cma;
+struct page;
+
+#ifdef CONFIG_CMA
+
+#define MAX_CMA_AREAS	4
+
+extern int cma_declare_contiguous(phys_addr_t size, phys_addr_t base,
+				  phys_addr_t limit, struct cma **res_cma);
+
+extern phys_addr_t cma_get_base(struct cma *cma);
+extern unsigned long cma_get_size(struct cma *cma);
+
+extern struct page *cma_alloc(struct cma *cma, int count, unsigned int align);
+extern int cma_claim(struct cma *cma, unsigned long pfn, int count);
+extern bool cma_release(struct cma *cma, struct page *pages, int count);
+
+#else
+
+static inline int cma_declare_contiguous(phys_addr_t size, phys_addr_t base,
+					 phys_addr_t limit,
+					 struct cma **res_cma)
+{
+	return -ENOSYS;
+}
+
+static inline phys_addr_t cma_get_base(struct cma *cma)
+{
+	return 0;
+}
+
+static inline unsigned long cma_get_size(struct cma *cma)
+{
+	return 0;
+}
+
+static inline struct page *cma_alloc(struct cma *cma, int count,
+				     unsigned int align)
+{
+	return NULL;
+}
+
+static inline int cma_claim(struct cma *cma, unsigned long pfn, int count)
+{
+	return -ENOSYS;
+}
+
+static inline bool cma_release(struct cma *cma, struct page *pages,
+			       int count)
+{
+	return false;
+}
+
+#endif
+
+#endif
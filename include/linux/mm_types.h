@@ -92,9 +92,21 @@ struct page {
 	};
 
 	/* Third double word block */
-	struct list_head lru;		/* Pageout list, eg. active_list
+	union {
+		struct list_head lru;	/* Pageout list, eg. active_list
 					 * protected by zone->lru_lock !
 					 */
+		struct {		/* slub per cpu partial pages */
+			struct page *next;	/* Next partial slab */
+#ifdef CONFIG_64BIT
+			int pages;	/* Nr of partial slabs left */
+			int pobjects;	/* Approximate # of objects */
+#else
+			short int pages;
+			short int pobjects;
+#endif
+		};
+	};
 
 	/* Remainder is not double word aligned */
 	union {
@@ -143,7 +155,8 @@ struct page {
  * operations on struct page then it must change the #if to ensure
  * proper alignment of the page struct.
  */
-#if defined(CONFIG_SLUB) && defined(CONFIG_CMPXCHG_LOCAL)
+#if defined(CONFIG_SLUB) && \
+	(defined(CONFIG_CMPXCHG_LOCAL) || defined(CONFIG_CMPXCHG_DOUBLE))
 	__attribute__((__aligned__(2*sizeof(unsigned long))))
 #endif
 ;
@@ -230,6 +243,9 @@ struct vm_area_struct {
 #ifdef CONFIG_NUMA
 	struct mempolicy *vm_policy;	/* NUMA policy for the VMA */
 #endif
+#ifdef CONFIG_SWAP
+	atomic_long_t swap_readahead_info; /* last fault, window and hits */
+#endif
 };
 
 struct core_thread {
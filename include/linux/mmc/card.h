@@ -12,6 +12,7 @@
 
 #include <linux/mmc/core.h>
 #include <linux/mod_devicetable.h>
+#include <linux/ktime.h>
 
 struct mmc_cid {
 	unsigned int		manfid;
@@ -83,6 +84,11 @@ struct mmc_ext_csd {
 	u8			out_of_int_time;	/* out of int time */
 	bool			bk_ops;			/* BK ops support bit */
 	bool			bk_ops_en;		/* BK ops enable bit */
+	unsigned int		cache_size;		/* Units: KB */
+	bool			cache_ctrl;		/* cache enable bit */
+	u8			max_packed_writes;	/* 500 */
+	u8			max_packed_reads;	/* 501 */
+	bool			packed_event_en;	/* packed failure event */
 };
 
 struct sd_scr {
@@ -163,6 +169,14 @@ struct sdio_func_tuple;
 
 #define SDIO_MAX_FUNCS		7
 
+struct mmc_bkops_stats {
+	unsigned int		started;	/* bkops started */
+	unsigned int		urgent;		/* started at the card's request */
+	unsigned int		preempted;	/* interrupted by HPI */
+	unsigned int		completed;	/* finished before the next I/O */
+	u64			time_us;	/* total time spent in bkops */
+};
+
 /*
  * MMC device
  */
@@ -223,6 +237,9 @@ struct mmc_card {
 
 	unsigned int		sd_bus_speed;	/* Bus Speed Mode set for the card */
 
+	struct mmc_bkops_stats	bkops_stats;
+	ktime_t			bkops_start;	/* when running bkops began */
+
 	struct dentry		*debugfs_root;
 };
 
@@ -232,6 +232,11 @@ struct mmc_host {
 #define MMC_CAP_CMD23		(1 << 30)	/* CMD23 supported. */
 #define MMC_CAP_BKOPS		(1 << 31)	/* Host supports BKOPS */
 
+	u32			caps2;		/* More host capabilities */
+
+#define MMC_CAP2_CACHE_CTRL	(1 << 0)	/* Allow cache control */
+#define MMC_CAP2_PACKED_WR	(1 << 1)	/* Allow packed write */
+
 	mmc_pm_flag_t		pm_caps;	/* supported pm features */
 
 #ifdef CONFIG_MMC_CLKGATE
@@ -17,6 +17,25 @@
 #include <linux/io.h>
 #include <linux/mmc/host.h>
 
+/*
+ * DMA state of one request. There are three of these: the next request can
+ * be mapped by pre_req while the current one is running, and the last one
+ * is kept for requests that were not pre-mapped, such as the EXT_CSD read
+ * the block driver issues while two pre-mapped requests are outstanding.
+ */
+struct sdhci_dma_map {
+	s32 cookie;		/* 0 free, SDHCI_MAP_REQ or pre_req cookie */
+#define SDHCI_MAP_REQ		(-1)	/* Mapped on the request path */
+
+	int sg_count;		/* Mapped sg entries */
+
+	u8 *adma_desc;		/* ADMA descriptor table */
+	u8 *align_buffer;	/* Bounce buffer */
+
+	dma_addr_t adma_addr;	/* Mapped ADMA descr. table */
+	dma_addr_t align_addr;	/* Mapped bounce buffer */
+};
+
 struct sdhci_host {
 	/* Data set by hardware interface driver */
 	const char *hw_name;	/* Hardware bus name */
@@ -139,13 +158,10 @@ struct sdhci_host {
 	struct sg_mapping_iter sg_miter;	/* SG state for PIO */
 	unsigned int blocks;	/* remaining PIO blocks */
 
-	int sg_count;		/* Mapped sg entries */
-
-	u8 *adma_desc;		/* ADMA descriptor table */
-	u8 *align_buffer;	/* Bounce buffer */
-
-	dma_addr_t adma_addr;	/* Mapped ADMA descr. table */
-	dma_addr_t align_addr;	/* Mapped bounce buffer */
+#define SDHCI_DMA_MAPS		3
+	struct sdhci_dma_map dma_map[SDHCI_DMA_MAPS];	/* See sdhci_dma_map */
+	struct sdhci_dma_map *dma_cur;	/* Mapping used by host->data */
+	s32 dma_cookie;		/* Last cookie handed out by pre_req */
 
 	struct tasklet_struct card_tasklet;	/* Tasklet structures */
 	struct tasklet_struct finish_tasklet;
@@ -87,6 +87,25 @@ struct nvhost_waitchk {
 	__u32 thresh;
 };
 
+/*
+ * single-call submit: describes a whole job through user pointers, so that
+ * it is copied in and kicked off in one ioctl instead of write() + FLUSH
+ */
+struct nvhost_submit_args {
+	__u32 submit_version;
+	__u32 syncpt_id;
+	__u32 syncpt_incrs;
+	__u32 num_cmdbufs;
+	__u32 num_relocs;
+	__u32 num_waitchks;
+	__u32 waitchk_mask;
+	__u32 fence;		/* returns the syncpt value at job end */
+	__u64 cmdbufs;		/* struct nvhost_cmdbuf * */
+	__u64 relocs;		/* struct nvhost_reloc * */
+	__u64 reloc_shifts;	/* struct nvhost_reloc_shift *, version 2 */
+	__u64 waitchks;		/* struct nvhost_waitchk * */
+};
+
 struct nvhost_get_param_args {
 	__u32 value;
 };
@@ -138,9 +157,11 @@ struct nvhost_set_priority_args {
 	_IOR(NVHOST_IOCTL_MAGIC, 12, struct nvhost_get_param_args)
 #define NVHOST_IOCTL_CHANNEL_SET_PRIORITY	\
 	_IOW(NVHOST_IOCTL_MAGIC, 13, struct nvhost_set_priority_args)
+#define NVHOST_IOCTL_CHANNEL_SUBMIT		\
+	_IOWR(NVHOST_IOCTL_MAGIC, 14, struct nvhost_submit_args)
 #define NVHOST_IOCTL_CHANNEL_LAST		\
-	_IOC_NR(NVHOST_IOCTL_CHANNEL_SET_PRIORITY)
-#define NVHOST_IOCTL_CHANNEL_MAX_ARG_SIZE sizeof(struct nvhost_submit_hdr_ext)
+	_IOC_NR(NVHOST_IOCTL_CHANNEL_SUBMIT)
+#define NVHOST_IOCTL_CHANNEL_MAX_ARG_SIZE sizeof(struct nvhost_submit_args)
 
 struct nvhost_ctrl_syncpt_read_args {
 	__u32 id;
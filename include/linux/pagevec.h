@@ -9,7 +9,11 @@
 #define _LINUX_PAGEVEC_H
 
 /* 14 pointers + two long's align the pagevec structure to a power of two */
+#ifdef CONFIG_PAGEVEC_SIZE
+#define PAGEVEC_SIZE	CONFIG_PAGEVEC_SIZE
+#else
 #define PAGEVEC_SIZE	14
+#endif
 
 struct page;
 struct address_space;
@@ -23,7 +27,6 @@ struct pagevec {
 void __pagevec_release(struct pagevec *pvec);
 void __pagevec_free(struct pagevec *pvec);
 void ____pagevec_lru_add(struct pagevec *pvec, enum lru_list lru);
-void pagevec_strip(struct pagevec *pvec);
 unsigned pagevec_lookup(struct pagevec *pvec, struct address_space *mapping,
 		pgoff_t start, unsigned nr_pages);
 unsigned pagevec_lookup_tag(struct pagevec *pvec,
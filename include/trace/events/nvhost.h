@@ -172,6 +172,33 @@ TRACE_EVENT(nvhost_channel_write_cmdbuf_data,
 		  __entry->cmdbuf ? __entry->words * 4 : 0))
 );
 
+TRACE_EVENT(nvhost_channel_submit_cost,
+	TP_PROTO(const char *name, u32 cmdbufs, u32 relocs,
+			u32 waitchks, u32 cost_us),
+
+	TP_ARGS(name, cmdbufs, relocs, waitchks, cost_us),
+
+	TP_STRUCT__entry(
+		__field(const char *, name)
+		__field(u32, cmdbufs)
+		__field(u32, relocs)
+		__field(u32, waitchks)
+		__field(u32, cost_us)
+	),
+
+	TP_fast_assign(
+		__entry->name = name;
+		__entry->cmdbufs = cmdbufs;
+		__entry->relocs = relocs;
+		__entry->waitchks = waitchks;
+		__entry->cost_us = cost_us;
+	),
+
+	TP_printk("name=%s, cmdbufs=%u, relocs=%u, waitchks=%u, cost=%uus",
+	  __entry->name, __entry->cmdbufs, __entry->relocs,
+	  __entry->waitchks, __entry->cost_us)
+);
+
 TRACE_EVENT(nvhost_channel_write_reloc,
 	TP_PROTO(const char *name),
 
@@ -103,6 +103,23 @@ struct tegra_dc_ext_flip {
 	__u32	post_syncpt_val;
 };
 
+/*
+ * A flip with a damage rectangle, in output coordinates.  On outputs that can
+ * do partial updates (DSI command mode panels with their own frame memory)
+ * only the damaged rectangle is sent to the panel, so it must cover every
+ * pixel that differs from the previously flipped frame.  Other outputs, and
+ * a damage_w or damage_h of zero, update the full frame.
+ */
+struct tegra_dc_ext_flip_damage {
+	struct tegra_dc_ext_flip flip;
+	__u32	damage_x;
+	__u32	damage_y;
+	__u32	damage_w;
+	__u32	damage_h;
+	/* Leave some wiggle room for future expansion */
+	__u32	pad[4];
+};
+
 /*
  * Cursor image format:
  * - Tegra hardware supports two colors: foreground and background, specified
@@ -244,6 +261,9 @@ struct tegra_dc_ext_status {
 #define TEGRA_DC_EXT_SET_LUT \
 	_IOW('D', 0x0A, struct tegra_dc_ext_lut)
 
+#define TEGRA_DC_EXT_FLIP_DAMAGE \
+	_IOWR('D', 0x0B, struct tegra_dc_ext_flip_damage)
+
 enum tegra_dc_ext_control_output_type {
 	TEGRA_DC_EXT_DSI,
 	TEGRA_DC_EXT_LVDS,
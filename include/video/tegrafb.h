@@ -27,6 +27,15 @@ struct tegra_fb_modedb {
 	__u32 modedb_len;
 };
 
+/* rectangle of the visible framebuffer that was drawn to */
+struct tegra_fb_damage {
+	__u32 x;
+	__u32 y;
+	__u32 w;
+	__u32 h;
+};
+
 #define FBIO_TEGRA_GET_MODEDB	_IOWR('F', 0x42, struct tegra_fb_modedb)
+#define FBIO_TEGRA_DAMAGE	_IOW('F', 0x43, struct tegra_fb_damage)
 
 #endif
@@ -0,0 +1,292 @@
+/*
+ * linux/mm/cma.c
+ *
+ * Contiguous Memory Allocator
+ *
+ * Reserves physically contiguous areas at boot and lends them to the
+ * page allocator for movable pages until a driver claims a range, at
+ * which point the pages in the way are migrated out.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License or (at your option) any later version.
+ */
+
+#ifdef CONFIG_CMA_DEBUG
+#ifndef DEBUG
+#define DEBUG
+#endif
+#endif
+
+#include <linux/bitmap.h>
+#include <linux/cma.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/memblock.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/page-isolation.h>
+#include <linux/pfn.h>
+#include <linux/slab.h>
+
+#include "internal.h"
+
+struct cma {
+	unsigned long	base_pfn;
+	unsigned long	count;		/* in pages */
+	unsigned long	*bitmap;	/* one bit per claimed page */
+	struct mutex	lock;
+};
+
+static struct cma cma_areas[MAX_CMA_AREAS];
+static unsigned cma_area_count;
+
+/*
+ * Free buddy pages never straddle a CMA area boundary as long as the
+ * area is aligned to the largest buddy order, and pageblocks are only
+ * ever isolated whole, so align to whichever is larger.
+ */
+static phys_addr_t __init cma_alignment(void)
+{
+	return PAGE_SIZE << max_t(unsigned int, MAX_ORDER - 1,
+				  pageblock_order);
+}
+
+/**
+ * cma_declare_contiguous() - reserve a contiguous memory area
+ * @size:	size of the area
+ * @base:	physical base of the area, or 0 to let memblock pick one
+ * @limit:	upper bound of the area when @base is 0, or 0 for none
+ * @res_cma:	filled with the area on success
+ *
+ * Must be called from the machine's ->reserve() callback.  Size and
+ * base are rounded to the CMA alignment (the larger of MAX_ORDER and
+ * pageblock_order pages).
+ */
+int __init cma_declare_contiguous(phys_addr_t size, phys_addr_t base,
+				  phys_addr_t limit, struct cma **res_cma)
+{
+	phys_addr_t alignment = cma_alignment();
+	struct cma *cma;
+
+	if (cma_area_count == ARRAY_SIZE(cma_areas)) {
+		pr_err("cma: not enough areas\n");
+		return -ENOSPC;
+	}
+	cma = &cma_areas[cma_area_count];
+
+	if (!size)
+		return -EINVAL;
+
+	size = ALIGN(size, alignment);
+	limit &= ~(alignment - 1);
+
+	if (base) {
+		if (base & (alignment - 1)) {
+			pr_err("cma: base %08lx not aligned to %08lx\n",
+			       (unsigned long)base, (unsigned long)alignment);
+			return -EINVAL;
+		}
+		if (memblock_is_region_reserved(base, size) ||
+		    memblock_reserve(base, size) < 0)
+			return -EBUSY;
+	} else {
+		base = __memblock_alloc_base(size, alignment,
+					     limit ?: MEMBLOCK_ALLOC_ANYWHERE);
+		if (!base)
+			return -ENOMEM;
+	}
+
+	cma->base_pfn = PFN_DOWN(base);
+	cma->count = size >> PAGE_SHIFT;
+	*res_cma = cma;
+	cma_area_count++;
+
+	pr_info("cma: reserved %lu MiB at %08lx\n",
+		(unsigned long)(size >> 20), (unsigned long)base);
+	return 0;
+}
+
+static int __init cma_activate_area(struct cma *cma)
+{
+	int bitmap_size = BITS_TO_LONGS(cma->count) * sizeof(long);
+	unsigned long base_pfn = cma->base_pfn, pfn = base_pfn;
+	unsigned i = cma->count >> pageblock_order;
+	struct zone *zone;
+
+	cma->bitmap = kzalloc(bitmap_size, GFP_KERNEL);
+	if (!cma->bitmap)
+		return -ENOMEM;
+
+	WARN_ON_ONCE(!pfn_valid(pfn));
+	zone = page_zone(pfn_to_page(pfn));
+
+	do {
+		unsigned j;
+
+		base_pfn = pfn;
+		for (j = pageblock_nr_pages; j; --j, pfn++) {
+			WARN_ON_ONCE(!pfn_valid(pfn));
+			/* alloc_contig_range() requires a single zone */
+			if (page_zone(pfn_to_page(pfn)) != zone)
+				goto err;
+		}
+		init_cma_reserved_pageblock(pfn_to_page(base_pfn));
+	} while (--i);
+
+	mutex_init(&cma->lock);
+	return 0;
+
+err:
+	kfree(cma->bitmap);
+	cma->bitmap = NULL;
+	return -EINVAL;
+}
+
+static int __init cma_init_reserved_areas(void)
+{
+	unsigned i;
+
+	for (i = 0; i < cma_area_count; i++) {
+		int ret = cma_activate_area(&cma_areas[i]);
+		if (ret)
+			pr_err("cma: failed to activate area %u: %d\n", i, ret);
+	}
+
+	return 0;
+}
+core_initcall(cma_init_reserved_areas);
+
+phys_addr_t cma_get_base(struct cma *cma)
+{
+	return PFN_PHYS(cma->base_pfn);
+}
+EXPORT_SYMBOL(cma_get_base);
+
+unsigned long cma_get_size(struct cma *cma)
+{
+	return cma->count << PAGE_SHIFT;
+}
+EXPORT_SYMBOL(cma_get_size);
+
+/**
+ * cma_alloc() - allocate pages from a contiguous area
+ * @cma:	contiguous memory area
+ * @count:	number of pages
+ * @align:	alignment of the first page, as an order
+ *
+ * May sleep while pages are migrated out of the way.  Returns the first
+ * of @count contiguous pages, or NULL.
+ */
+struct page *cma_alloc(struct cma *cma, int count, unsigned int align)
+{
+	unsigned long mask = (1UL << align) - 1;
+	unsigned long start = 0, pageno, pfn;
+	struct page *page = NULL;
+	int ret;
+
+	if (!cma || !cma->bitmap || count <= 0)
+		return NULL;
+
+	pr_debug("%s(cma %p, count %d, align %u)\n", __func__, cma,
+		 count, align);
+
+	mutex_lock(&cma->lock);
+	for (;;) {
+		pageno = bitmap_find_next_zero_area(cma->bitmap, cma->count,
+						    start, count, mask);
+		if (pageno >= cma->count)
+			break;
+
+		pfn = cma->base_pfn + pageno;
+		ret = alloc_contig_range(pfn, pfn + count);
+		if (!ret) {
+			bitmap_set(cma->bitmap, pageno, count);
+			page = pfn_to_page(pfn);
+			break;
+		}
+		if (ret != -EBUSY)
+			break;
+
+		pr_debug("%s(): range %lx busy, retrying\n", __func__, pfn);
+		/* try again with a bit different memory target */
+		start = pageno + mask + 1;
+	}
+	mutex_unlock(&cma->lock);
+
+	pr_debug("%s(): returned %p\n", __func__, page);
+	return page;
+}
+EXPORT_SYMBOL(cma_alloc);
+
+/**
+ * cma_claim() - allocate a given range of a contiguous area
+ * @cma:	contiguous memory area
+ * @pfn:	first page of the range
+ * @count:	number of pages
+ *
+ * For users which place their buffers in the area themselves.  May
+ * sleep while pages are migrated out of the way.  Returns zero on
+ * success, -EBUSY if part of the range is already claimed or could not
+ * be vacated.
+ */
+int cma_claim(struct cma *cma, unsigned long pfn, int count)
+{
+	unsigned long pageno;
+	int ret;
+
+	if (!cma || !cma->bitmap || count <= 0)
+		return -EINVAL;
+	if (pfn < cma->base_pfn || pfn + count > cma->base_pfn + cma->count)
+		return -EINVAL;
+
+	pr_debug("%s(cma %p, pfn %lx, count %d)\n", __func__, cma, pfn, count);
+
+	pageno = pfn - cma->base_pfn;
+
+	mutex_lock(&cma->lock);
+	if (find_next_bit(cma->bitmap, pageno + count, pageno) <
+	    pageno + count) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	ret = alloc_contig_range(pfn, pfn + count);
+	if (!ret)
+		bitmap_set(cma->bitmap, pageno, count);
+out:
+	mutex_unlock(&cma->lock);
+	return ret;
+}
+EXPORT_SYMBOL(cma_claim);
+
+/**
+ * cma_release() - release pages allocated from a contiguous area
+ * @cma:	contiguous memory area
+ * @pages:	first page, as returned by cma_alloc() or claimed
+ * @count:	number of pages
+ *
+ * Returns false if the pages do not belong to @cma.
+ */
+bool cma_release(struct cma *cma, struct page *pages, int count)
+{
+	unsigned long pfn;
+
+	if (!cma || !pages)
+		return false;
+
+	pfn = page_to_pfn(pages);
+	if (pfn < cma->base_pfn || pfn + count > cma->base_pfn + cma->count)
+		return false;
+
+	pr_debug("%s(page %p, count %d)\n", __func__, pages, count);
+
+	mutex_lock(&cma->lock);
+	bitmap_clear(cma->bitmap, pfn - cma->base_pfn, count);
+	free_contig_range(pfn, count);
+	mutex_unlock(&cma->lock);
+
+	return true;
+}
+EXPORT_SYMBOL(cma_release);
@@ -300,25 +300,25 @@ static isolate_migrate_t isolate_migratepages(struct zone *zone,
 
 	/* Time to isolate some pages for migration */
 	cond_resched();
-	spin_lock_irq(&zone->lru_lock);
+	lru_lock_irq(zone);
 	for (; low_pfn < end_pfn; low_pfn++) {
 		struct page *page;
 		bool locked = true;
 
 		/* give a chance to irqs before checking need_resched() */
 		if (!((low_pfn+1) % SWAP_CLUSTER_MAX)) {
-			spin_unlock_irq(&zone->lru_lock);
+			lru_unlock_irq(zone);
 			locked = false;
 		}
 		if (need_resched() || spin_is_contended(&zone->lru_lock)) {
 			if (locked)
-				spin_unlock_irq(&zone->lru_lock);
+				lru_unlock_irq(zone);
 			cond_resched();
-			spin_lock_irq(&zone->lru_lock);
+			lru_lock_irq(zone);
 			if (fatal_signal_pending(current))
 				break;
 		} else if (!locked)
-			spin_lock_irq(&zone->lru_lock);
+			lru_lock_irq(zone);
 
 		if (!pfn_valid_within(low_pfn))
 			continue;
@@ -375,7 +375,7 @@ static isolate_migrate_t isolate_migratepages(struct zone *zone,
 
 	acct_isolated(zone, cc);
 
-	spin_unlock_irq(&zone->lru_lock);
+	lru_unlock_irq(zone);
 	cc->migrate_pfn = low_pfn;
 
 	trace_mm_compaction_isolate_migratepages(nr_scanned, nr_isolated);
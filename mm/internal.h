@@ -12,6 +12,7 @@
 #define __MM_INTERNAL_H
 
 #include <linux/mm.h>
+#include <linux/sched.h>
 
 void free_pgtables(struct mmu_gather *tlb, struct vm_area_struct *start_vma,
 		unsigned long floor, unsigned long ceiling);
@@ -88,7 +89,6 @@ extern unsigned long highest_memmap_pfn;
 /*
  * in mm/vmscan.c:
  */
-extern int isolate_lru_page(struct page *page);
 extern void putback_lru_page(struct page *page);
 
 /*
@@ -96,6 +96,9 @@ extern void putback_lru_page(struct page *page);
  */
 extern void __free_pages_bootmem(struct page *page, unsigned int order);
 extern void prep_compound_page(struct page *page, unsigned long order);
+#ifdef CONFIG_CMA
+extern void init_cma_reserved_pageblock(struct page *page);
+#endif
 #ifdef CONFIG_MEMORY_FAILURE
 extern bool is_free_buddy_page(struct page *page);
 #endif
@@ -295,6 +298,73 @@ static inline void mminit_validate_memmodel_limits(unsigned long *start_pfn,
 }
 #endif /* CONFIG_SPARSEMEM */
 
+/*
+ * zone->lru_lock is taken through these so that CONFIG_LRU_LOCK_STAT can
+ * account how often it is contended and for how long it is held.
+ */
+#ifdef CONFIG_LRU_LOCK_STAT
+static inline void lru_lock(struct zone *zone)
+{
+	struct lru_lock_stat *stat = &zone->lru_lock_stat;
+	u64 start;
+
+	if (!spin_trylock(&zone->lru_lock)) {
+		start = local_clock();
+		spin_lock(&zone->lru_lock);
+		stat->contended++;
+		stat->wait_ns += local_clock() - start;
+	}
+	stat->acquired++;
+	stat->locked_at = local_clock();
+}
+
+static inline void lru_unlock(struct zone *zone)
+{
+	struct lru_lock_stat *stat = &zone->lru_lock_stat;
+	u64 held = local_clock() - stat->locked_at;
+
+	stat->hold_ns += held;
+	if (held > stat->max_hold_ns)
+		stat->max_hold_ns = held;
+	spin_unlock(&zone->lru_lock);
+}
+#else
+static inline void lru_lock(struct zone *zone)
+{
+	spin_lock(&zone->lru_lock);
+}
+
+static inline void lru_unlock(struct zone *zone)
+{
+	spin_unlock(&zone->lru_lock);
+}
+#endif /* CONFIG_LRU_LOCK_STAT */
+
+static inline void lru_lock_irq(struct zone *zone)
+{
+	local_irq_disable();
+	lru_lock(zone);
+}
+
+static inline void lru_unlock_irq(struct zone *zone)
+{
+	lru_unlock(zone);
+	local_irq_enable();
+}
+
+#define lru_lock_irqsave(zone, flags)		\
+	do {					\
+		local_irq_save(flags);		\
+		lru_lock(zone);			\
+	} while (0)
+
+static inline void lru_unlock_irqrestore(struct zone *zone,
+					 unsigned long flags)
+{
+	lru_unlock(zone);
+	local_irq_restore(flags);
+}
+
 #define ZONE_RECLAIM_NOSCAN	-2
 #define ZONE_RECLAIM_FULL	-1
 #define ZONE_RECLAIM_SOME	0
@@ -57,6 +57,7 @@
 #include <linux/ftrace_event.h>
 #include <linux/memcontrol.h>
 #include <linux/prefetch.h>
+#include <linux/migrate.h>
 
 #include <asm/tlbflush.h>
 #include <asm/div64.h>
@@ -840,13 +841,19 @@ struct page *__rmqueue_smallest(struct zone *zone, unsigned int order,
 
 /*
  * This array describes the order lists are fallen back to when
- * the free lists for the desirable migrate type are depleted
+ * the free lists for the desirable migrate type are depleted.
+ * Each list is terminated by MIGRATE_RESERVE.  CMA pageblocks are
+ * only ever lent to movable allocations.
  */
-static int fallbacks[MIGRATE_TYPES][MIGRATE_TYPES-1] = {
+static int fallbacks[MIGRATE_TYPES][4] = {
 	[MIGRATE_UNMOVABLE]   = { MIGRATE_RECLAIMABLE, MIGRATE_MOVABLE,   MIGRATE_RESERVE },
 	[MIGRATE_RECLAIMABLE] = { MIGRATE_UNMOVABLE,   MIGRATE_MOVABLE,   MIGRATE_RESERVE },
+#ifdef CONFIG_CMA
+	[MIGRATE_MOVABLE]     = { MIGRATE_CMA,         MIGRATE_RECLAIMABLE, MIGRATE_UNMOVABLE, MIGRATE_RESERVE },
+#else
 	[MIGRATE_MOVABLE]     = { MIGRATE_RECLAIMABLE, MIGRATE_UNMOVABLE, MIGRATE_RESERVE },
-	[MIGRATE_RESERVE]     = { MIGRATE_RESERVE,     MIGRATE_RESERVE,   MIGRATE_RESERVE }, /* Never used */
+#endif
+	[MIGRATE_RESERVE]     = { MIGRATE_RESERVE }, /* Never used */
 };
 
 /*
@@ -941,12 +948,12 @@ __rmqueue_fallback(struct zone *zone, int order, int start_migratetype)
 	/* Find the largest possible block of pages in the other list */
 	for (current_order = MAX_ORDER-1; current_order >= order;
 						--current_order) {
-		for (i = 0; i < MIGRATE_TYPES - 1; i++) {
+		for (i = 0;; i++) {
 			migratetype = fallbacks[start_migratetype][i];
 
 			/* MIGRATE_RESERVE handled later if necessary */
 			if (migratetype == MIGRATE_RESERVE)
-				continue;
+				break;
 
 			area = &(zone->free_area[current_order]);
 			if (list_empty(&area->free_list[migratetype]))
@@ -960,11 +967,13 @@ __rmqueue_fallback(struct zone *zone, int order, int start_migratetype)
 			 * If breaking a large block of pages, move all free
 			 * pages to the preferred allocation list. If falling
 			 * back for a reclaimable kernel allocation, be more
-			 * aggressive about taking ownership of free pages
+			 * aggressive about taking ownership of free pages.
+			 * CMA pageblocks are only borrowed, never taken over.
 			 */
-			if (unlikely(current_order >= (pageblock_order >> 1)) ||
+			if (!is_migrate_cma(migratetype) &&
+			    (unlikely(current_order >= (pageblock_order >> 1)) ||
 					start_migratetype == MIGRATE_RECLAIMABLE ||
-					page_group_by_mobility_disabled) {
+					page_group_by_mobility_disabled)) {
 				unsigned long pages;
 				pages = move_freepages_block(zone, page,
 								start_migratetype);
@@ -983,7 +992,8 @@ __rmqueue_fallback(struct zone *zone, int order, int start_migratetype)
 			rmv_page_order(page);
 
 			/* Take ownership for orders >= pageblock_order */
-			if (current_order >= pageblock_order)
+			if (current_order >= pageblock_order &&
+			    !is_migrate_cma(migratetype))
 				change_pageblock_range(page, current_order,
 							start_migratetype);
 
@@ -1059,7 +1069,14 @@ static int rmqueue_bulk(struct zone *zone, unsigned int order,
 			list_add(&page->lru, list);
 		else
 			list_add_tail(&page->lru, list);
-		set_page_private(page, migratetype);
+		/*
+		 * CMA pages may have been lent to a movable request, make
+		 * sure they go back to their own free list when drained.
+		 */
+		if (is_migrate_cma(get_pageblock_migratetype(page)))
+			set_page_private(page, MIGRATE_CMA);
+		else
+			set_page_private(page, migratetype);
 		list = &page->lru;
 	}
 	__mod_zone_page_state(zone, NR_FREE_PAGES, -(i << order));
@@ -1290,8 +1307,12 @@ int split_free_page(struct page *page)
 
 	if (order >= pageblock_order - 1) {
 		struct page *endpage = page + (1 << order) - 1;
-		for (; page < endpage; page += pageblock_nr_pages)
-			set_pageblock_migratetype(page, MIGRATE_MOVABLE);
+		for (; page < endpage; page += pageblock_nr_pages) {
+			int mt = get_pageblock_migratetype(page);
+			if (mt != MIGRATE_ISOLATE && !is_migrate_cma(mt))
+				set_pageblock_migratetype(page,
+							  MIGRATE_MOVABLE);
+		}
 	}
 
 	return 1 << order;
@@ -5577,6 +5598,8 @@ static int
 __count_immobile_pages(struct zone *zone, struct page *page, int count)
 {
 	unsigned long pfn, iter, found;
+	int mt;
+
 	/*
 	 * For avoiding noise data, lru_add_drain_all() should be called
 	 * If ZONE_MOVABLE, the zone never contains immobile pages
@@ -5584,7 +5607,8 @@ __count_immobile_pages(struct zone *zone, struct page *page, int count)
 	if (zone_idx(zone) == ZONE_MOVABLE)
 		return true;
 
-	if (get_pageblock_migratetype(page) == MIGRATE_MOVABLE)
+	mt = get_pageblock_migratetype(page);
+	if (mt == MIGRATE_MOVABLE || is_migrate_cma(mt))
 		return true;
 
 	pfn = page_to_pfn(page);
@@ -5683,7 +5707,7 @@ out:
 	return ret;
 }
 
-void unset_migratetype_isolate(struct page *page)
+void unset_migratetype_isolate(struct page *page, int migratetype)
 {
 	struct zone *zone;
 	unsigned long flags;
@@ -5691,12 +5715,224 @@ void unset_migratetype_isolate(struct page *page)
 	spin_lock_irqsave(&zone->lock, flags);
 	if (get_pageblock_migratetype(page) != MIGRATE_ISOLATE)
 		goto out;
-	set_pageblock_migratetype(page, MIGRATE_MOVABLE);
-	move_freepages_block(zone, page, MIGRATE_MOVABLE);
+	set_pageblock_migratetype(page, migratetype);
+	move_freepages_block(zone, page, migratetype);
 out:
 	spin_unlock_irqrestore(&zone->lock, flags);
 }
 
+#ifdef CONFIG_CMA
+/*
+ * Hand a pageblock reserved with memblock at boot over to the page
+ * allocator as MIGRATE_CMA.
+ */
+void __init init_cma_reserved_pageblock(struct page *page)
+{
+	unsigned i = pageblock_nr_pages;
+	struct page *p = page;
+
+	do {
+		__ClearPageReserved(p);
+		set_page_count(p, 0);
+	} while (++p, --i);
+
+	set_page_refcounted(page);
+	set_pageblock_migratetype(page, MIGRATE_CMA);
+	__free_pages(page, pageblock_order);
+	totalram_pages += pageblock_nr_pages;
+#ifdef CONFIG_HIGHMEM
+	if (PageHighMem(page))
+		totalhigh_pages += pageblock_nr_pages;
+#endif
+}
+
+/*
+ * Isolation works on whole pageblocks, and a free buddy page may span
+ * MAX_ORDER_NR_PAGES, so the range handed to the isolation code is
+ * widened to the larger of the two.  CMA areas are aligned the same way.
+ */
+#define pfn_max_align_down(pfn)						\
+	((pfn) & ~(max_t(unsigned long, MAX_ORDER_NR_PAGES,		\
+			 pageblock_nr_pages) - 1))
+#define pfn_max_align_up(pfn)						\
+	ALIGN((pfn), max_t(unsigned long, MAX_ORDER_NR_PAGES,		\
+			   pageblock_nr_pages))
+
+#define NR_CONTIG_MIGRATE_PAGES		256
+#define CONTIG_MIGRATE_RETRIES		5
+
+static struct page *
+contig_migrate_alloc(struct page *page, unsigned long private, int **x)
+{
+	gfp_t gfp_mask = GFP_USER | __GFP_MOVABLE;
+
+	if (PageHighMem(page))
+		gfp_mask |= __GFP_HIGHMEM;
+
+	/* the range being claimed is isolated, so this never lands in it */
+	return alloc_page(gfp_mask);
+}
+
+/*
+ * Migrate every page on the LRU in [start, end) somewhere else.  Pages
+ * which cannot be isolated or migrated are left in place, the caller
+ * finds out when it tries to take the range.
+ */
+static int contig_migrate_range(unsigned long start, unsigned long end)
+{
+	unsigned long pfn = start;
+	struct page *page;
+	int nr_pages;
+	LIST_HEAD(source);
+
+	while (pfn < end) {
+		if (fatal_signal_pending(current))
+			return -EINTR;
+
+		for (nr_pages = 0;
+		     pfn < end && nr_pages < NR_CONTIG_MIGRATE_PAGES; pfn++) {
+			page = pfn_to_page(pfn);
+			if (!get_page_unless_zero(page))
+				continue;
+			if (!isolate_lru_page(page)) {
+				list_add_tail(&page->lru, &source);
+				inc_zone_page_state(page, NR_ISOLATED_ANON +
+						    page_is_file_cache(page));
+				nr_pages++;
+			}
+			put_page(page);
+		}
+
+		if (list_empty(&source))
+			continue;
+
+		/* this function returns # of failed pages */
+		if (migrate_pages(&source, contig_migrate_alloc, 0,
+				  false, true))
+			putback_lru_pages(&source);
+		cond_resched();
+	}
+
+	return 0;
+}
+
+/*
+ * Take every free page covering [start, end) off the buddy lists, split
+ * into order-0 pages.  Returns the pfn following the last page taken,
+ * which may lie past @end if a buddy page straddled it, or 0 if a page
+ * in the range is not free.  The first page taken may likewise lie
+ * before @start; it is returned in @outer_start.
+ */
+static unsigned long take_free_range(struct zone *zone, unsigned long start,
+				     unsigned long end,
+				     unsigned long *outer_start)
+{
+	unsigned long flags, pfn;
+	struct page *page;
+	int order;
+
+	spin_lock_irqsave(&zone->lock, flags);
+
+	/* find the buddy page start belongs to */
+	for (order = 0; order < MAX_ORDER; order++) {
+		pfn = start & (~0UL << order);
+		page = pfn_to_page(pfn);
+		if (PageBuddy(page) && page_order(page) >= order)
+			break;
+	}
+	if (order == MAX_ORDER)
+		goto busy;
+	*outer_start = pfn;
+
+	for (; pfn < end; pfn += 1UL << page_order(page)) {
+		page = pfn_to_page(pfn);
+		if (!PageBuddy(page))
+			goto busy;
+	}
+
+	for (pfn = *outer_start; pfn < end; pfn += 1UL << order) {
+		page = pfn_to_page(pfn);
+		order = page_order(page);
+
+		list_del(&page->lru);
+		rmv_page_order(page);
+		zone->free_area[order].nr_free--;
+		__mod_zone_page_state(zone, NR_FREE_PAGES, -(1UL << order));
+
+		set_page_refcounted(page);
+		split_page(page, order);
+	}
+
+	spin_unlock_irqrestore(&zone->lock, flags);
+	return pfn;
+
+busy:
+	spin_unlock_irqrestore(&zone->lock, flags);
+	return 0;
+}
+
+/**
+ * alloc_contig_range() -- tries to allocate given range of pages
+ * @start:	start PFN to allocate
+ * @end:	one-past-the-last PFN to allocate
+ *
+ * The PFN range must belong to a single zone and lie within a CMA
+ * area.  The pageblocks covering it are isolated, the pages in use are
+ * migrated away, and the range is then taken off the free lists.
+ *
+ * Returns zero on success, in which case every page in the range has a
+ * reference count of one and must be released with free_contig_range().
+ * Returns -EBUSY if some pages could not be moved, or -EINTR if the
+ * caller got a fatal signal.
+ */
+int alloc_contig_range(unsigned long start, unsigned long end)
+{
+	struct zone *zone = page_zone(pfn_to_page(start));
+	unsigned long outer_start, outer_end;
+	int tries, ret;
+
+	ret = start_isolate_page_range(pfn_max_align_down(start),
+				       pfn_max_align_up(end), MIGRATE_CMA);
+	if (ret)
+		return ret;
+
+	for (tries = 0; tries < CONTIG_MIGRATE_RETRIES; tries++) {
+		ret = contig_migrate_range(start, end);
+		if (ret)
+			goto done;
+
+		/* flush pages sitting on per-cpu lists back to the buddies */
+		lru_add_drain_all();
+		drain_all_pages();
+
+		outer_end = take_free_range(zone, start, end, &outer_start);
+		if (outer_end)
+			break;
+	}
+	if (tries == CONTIG_MIGRATE_RETRIES) {
+		ret = -EBUSY;
+		goto done;
+	}
+
+	/* give back the parts of straddling buddy pages outside the range */
+	if (start != outer_start)
+		free_contig_range(outer_start, start - outer_start);
+	if (end != outer_end)
+		free_contig_range(end, outer_end - end);
+
+done:
+	undo_isolate_page_range(pfn_max_align_down(start),
+				pfn_max_align_up(end), MIGRATE_CMA);
+	return ret;
+}
+
+void free_contig_range(unsigned long pfn, unsigned nr_pages)
+{
+	for (; nr_pages--; ++pfn)
+		__free_page(pfn_to_page(pfn));
+}
+#endif
+
 #ifdef CONFIG_MEMORY_HOTREMOVE
 /*
  * All pages in the range must be isolated before calling this.
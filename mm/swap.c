@@ -23,7 +23,6 @@
 #include <linux/init.h>
 #include <linux/module.h>
 #include <linux/mm_inline.h>
-#include <linux/buffer_head.h>	/* for try_to_release_page() */
 #include <linux/percpu_counter.h>
 #include <linux/percpu.h>
 #include <linux/cpu.h>
@@ -51,11 +50,11 @@ static void __page_cache_release(struct page *page)
 		unsigned long flags;
 		struct zone *zone = page_zone(page);
 
-		spin_lock_irqsave(&zone->lru_lock, flags);
+		lru_lock_irqsave(zone, flags);
 		VM_BUG_ON(!PageLRU(page));
 		__ClearPageLRU(page);
 		del_page_from_lru(zone, page);
-		spin_unlock_irqrestore(&zone->lru_lock, flags);
+		lru_unlock_irqrestore(zone, flags);
 	}
 }
 
@@ -216,15 +215,15 @@ static void pagevec_lru_move_fn(struct pagevec *pvec,
 
 		if (pagezone != zone) {
 			if (zone)
-				spin_unlock_irqrestore(&zone->lru_lock, flags);
+				lru_unlock_irqrestore(zone, flags);
 			zone = pagezone;
-			spin_lock_irqsave(&zone->lru_lock, flags);
+			lru_lock_irqsave(zone, flags);
 		}
 
 		(*move_fn)(page, arg);
 	}
 	if (zone)
-		spin_unlock_irqrestore(&zone->lru_lock, flags);
+		lru_unlock_irqrestore(zone, flags);
 	release_pages(pvec->pages, pvec->nr, pvec->cold);
 	pagevec_reinit(pvec);
 }
@@ -345,12 +344,46 @@ void activate_page(struct page *page)
 {
 	struct zone *zone = page_zone(page);
 
-	spin_lock_irq(&zone->lru_lock);
+	lru_lock_irq(zone);
 	__activate_page(page, NULL);
-	spin_unlock_irq(&zone->lru_lock);
+	lru_unlock_irq(zone);
 }
 #endif
 
+/*
+ * A page accessed a second time before it left this CPU's lru_add
+ * pagevec would otherwise go to the inactive list first, and take
+ * another trip through the lru_lock to be activated.  Move it over to
+ * the active pagevec instead.  Pages still on other CPUs' pagevecs are
+ * not found, and are activated on a later access as usual.
+ */
+static bool __lru_cache_activate_page(struct page *page)
+{
+	struct pagevec *pvecs = get_cpu_var(lru_add_pvecs);
+	enum lru_list lru = page_lru_base_type(page);
+	struct pagevec *pvec = &pvecs[lru - LRU_BASE];
+	bool found = false;
+	int i;
+
+	/* the page was most likely added recently, so search backwards */
+	for (i = pagevec_count(pvec) - 1; i >= 0; i--) {
+		if (pvec->pages[i] == page) {
+			pvec->pages[i] = pvec->pages[--pvec->nr];
+			found = true;
+			break;
+		}
+	}
+	if (found) {
+		lru += LRU_ACTIVE;
+		pvec = &pvecs[lru - LRU_BASE];
+		if (!pagevec_add(pvec, page))
+			____pagevec_lru_add(pvec, lru);
+		count_vm_event(PGACTIVATE);
+	}
+	put_cpu_var(lru_add_pvecs);
+	return found;
+}
+
 /*
  * Mark a page as having seen activity.
  *
@@ -361,9 +394,14 @@ void activate_page(struct page *page)
 void mark_page_accessed(struct page *page)
 {
 	if (!PageActive(page) && !PageUnevictable(page) &&
-			PageReferenced(page) && PageLRU(page)) {
-		activate_page(page);
+			PageReferenced(page)) {
+		if (PageLRU(page))
+			activate_page(page);
+		else if (!__lru_cache_activate_page(page))
+			return;
 		ClearPageReferenced(page);
+		if (page_is_file_cache(page))
+			workingset_activation(page);
 	} else if (!PageReferenced(page)) {
 		SetPageReferenced(page);
 	}
@@ -415,11 +453,11 @@ void add_page_to_unevictable_list(struct page *page)
 {
 	struct zone *zone = page_zone(page);
 
-	spin_lock_irq(&zone->lru_lock);
+	lru_lock_irq(zone);
 	SetPageUnevictable(page);
 	SetPageLRU(page);
 	add_page_to_lru_list(zone, page, LRU_UNEVICTABLE);
-	spin_unlock_irq(&zone->lru_lock);
+	lru_unlock_irq(zone);
 }
 
 /*
@@ -595,7 +633,7 @@ void release_pages(struct page **pages, int nr, int cold)
 
 		if (unlikely(PageCompound(page))) {
 			if (zone) {
-				spin_unlock_irqrestore(&zone->lru_lock, flags);
+				lru_unlock_irqrestore(zone, flags);
 				zone = NULL;
 			}
 			put_compound_page(page);
@@ -610,10 +648,9 @@ void release_pages(struct page **pages, int nr, int cold)
 
 			if (pagezone != zone) {
 				if (zone)
-					spin_unlock_irqrestore(&zone->lru_lock,
-									flags);
+					lru_unlock_irqrestore(zone, flags);
 				zone = pagezone;
-				spin_lock_irqsave(&zone->lru_lock, flags);
+				lru_lock_irqsave(zone, flags);
 			}
 			VM_BUG_ON(!PageLRU(page));
 			__ClearPageLRU(page);
@@ -622,7 +659,7 @@ void release_pages(struct page **pages, int nr, int cold)
 
 		if (!pagevec_add(&pages_to_free, page)) {
 			if (zone) {
-				spin_unlock_irqrestore(&zone->lru_lock, flags);
+				lru_unlock_irqrestore(zone, flags);
 				zone = NULL;
 			}
 			__pagevec_free(&pages_to_free);
@@ -630,7 +667,7 @@ void release_pages(struct page **pages, int nr, int cold)
   		}
 	}
 	if (zone)
-		spin_unlock_irqrestore(&zone->lru_lock, flags);
+		lru_unlock_irqrestore(zone, flags);
 
 	pagevec_free(&pages_to_free);
 }
@@ -723,24 +760,6 @@ void ____pagevec_lru_add(struct pagevec *pvec, enum lru_list lru)
 
 EXPORT_SYMBOL(____pagevec_lru_add);
 
-/*
- * Try to drop buffers from the pages in a pagevec
- */
-void pagevec_strip(struct pagevec *pvec)
-{
-	int i;
-
-	for (i = 0; i < pagevec_count(pvec); i++) {
-		struct page *page = pvec->pages[i];
-
-		if (page_has_private(page) && trylock_page(page)) {
-			if (page_has_private(page))
-				try_to_release_page(page, 0);
-			unlock_page(page);
-		}
-	}
-}
-
 /**
  * pagevec_lookup - gang pagecache lookup
  * @pvec:	Where the resulting pages are placed
@@ -95,6 +95,9 @@ struct scan_control {
 	/* Can pages be swapped as part of reclaim? */
 	int may_swap;
 
+	/* Reclaim referenced pages too (per-process reclaim) */
+	int ignore_references;
+
 	int order;
 
 	/*
@@ -519,9 +522,11 @@ static pageout_t pageout(struct page *page, struct address_space *mapping,
 
 /*
  * Same as remove_mapping, but if the page is removed from the mapping, it
- * gets returned with a refcount of 0.
+ * gets returned with a refcount of 0.  @reclaimed tells whether the page
+ * is being evicted by reclaim, in which case its eviction is remembered.
  */
-static int __remove_mapping(struct address_space *mapping, struct page *page)
+static int __remove_mapping(struct address_space *mapping, struct page *page,
+			    bool reclaimed)
 {
 	BUG_ON(!PageLocked(page));
 	BUG_ON(mapping != page_mapping(page));
@@ -567,10 +572,19 @@ static int __remove_mapping(struct address_space *mapping, struct page *page)
 		swapcache_free(swap, page);
 	} else {
 		void (*freepage)(struct page *);
+		void *shadow = NULL;
 
 		freepage = mapping->a_ops->freepage;
 
-		__delete_from_page_cache(page);
+		/*
+		 * Leave a shadow entry for reclaimed file cache so that a
+		 * refault can tell how long the page was gone.  Not for
+		 * pages that were invalidated, nor for shmem, whose slots
+		 * hold swap entries.
+		 */
+		if (reclaimed && page_is_file_cache(page))
+			shadow = workingset_eviction(mapping, page);
+		__delete_from_page_cache(page, shadow);
 		spin_unlock_irq(&mapping->tree_lock);
 		mem_cgroup_uncharge_cache_page(page);
 
@@ -593,7 +607,7 @@ cannot_free:
  */
 int remove_mapping(struct address_space *mapping, struct page *page)
 {
-	if (__remove_mapping(mapping, page)) {
+	if (__remove_mapping(mapping, page, false)) {
 		/*
 		 * Unfreezing the refcount with 1 rather than 2 effectively
 		 * drops the pagecache ref for us without requiring another
@@ -693,8 +707,9 @@ static enum page_references page_check_references(struct page *page,
 	referenced_ptes = page_referenced(page, 1, sc->mem_cgroup, &vm_flags);
 	referenced_page = TestClearPageReferenced(page);
 
-	/* Lumpy reclaim - ignore references */
-	if (sc->reclaim_mode & RECLAIM_MODE_LUMPYRECLAIM)
+	/* Lumpy reclaim and per-process reclaim - ignore references */
+	if ((sc->reclaim_mode & RECLAIM_MODE_LUMPYRECLAIM) ||
+	    sc->ignore_references)
 		return PAGEREF_RECLAIM;
 
 	/*
@@ -941,7 +956,7 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 			}
 		}
 
-		if (!mapping || !__remove_mapping(mapping, page))
+		if (!mapping || !__remove_mapping(mapping, page, true))
 			goto keep_locked;
 
 		/*
@@ -1273,7 +1288,7 @@ int isolate_lru_page(struct page *page)
 	if (PageLRU(page)) {
 		struct zone *zone = page_zone(page);
 
-		spin_lock_irq(&zone->lru_lock);
+		lru_lock_irq(zone);
 		if (PageLRU(page)) {
 			int lru = page_lru(page);
 			ret = 0;
@@ -1282,7 +1297,7 @@ int isolate_lru_page(struct page *page)
 
 			del_page_from_lru_list(zone, page, lru);
 		}
-		spin_unlock_irq(&zone->lru_lock);
+		lru_unlock_irq(zone);
 	}
 	return ret;
 }
@@ -1312,6 +1327,34 @@ static int too_many_isolated(struct zone *zone, int file,
 	return isolated > inactive;
 }
 
+/*
+ * The caller dropped the last reference to a page it had just put back
+ * on the LRU, with zone->lru_lock held.  Take it off again and queue it
+ * on @pages_to_free, so that the lock need not be dropped to free it.
+ */
+static void putback_free_page(struct zone *zone, struct page *page,
+			      enum lru_list lru, struct list_head *pages_to_free)
+{
+	__ClearPageLRU(page);
+	__ClearPageActive(page);
+	del_page_from_lru_list(zone, page, lru);
+
+	if (unlikely(PageCompound(page))) {
+		lru_unlock_irq(zone);
+		(*get_compound_page_dtor(page))(page);
+		lru_lock_irq(zone);
+	} else
+		list_add(&page->lru, pages_to_free);
+}
+
+static void free_page_list(struct list_head *pages)
+{
+	struct page *page, *next;
+
+	list_for_each_entry_safe(page, next, pages, lru)
+		free_hot_cold_page(page, 1);
+}
+
 /*
  * TODO: Try merging with migrations version of putback_lru_pages
  */
@@ -1321,24 +1364,22 @@ putback_lru_pages(struct zone *zone, struct scan_control *sc,
 				struct list_head *page_list)
 {
 	struct page *page;
-	struct pagevec pvec;
+	LIST_HEAD(pages_to_free);
 	struct zone_reclaim_stat *reclaim_stat = get_reclaim_stat(zone, sc);
 
-	pagevec_init(&pvec, 1);
-
 	/*
 	 * Put back any unfreeable pages.
 	 */
-	spin_lock(&zone->lru_lock);
+	lru_lock(zone);
 	while (!list_empty(page_list)) {
 		int lru;
 		page = lru_to_page(page_list);
 		VM_BUG_ON(PageLRU(page));
 		list_del(&page->lru);
 		if (unlikely(!page_evictable(page, NULL))) {
-			spin_unlock_irq(&zone->lru_lock);
+			lru_unlock_irq(zone);
 			putback_lru_page(page);
-			spin_lock_irq(&zone->lru_lock);
+			lru_lock_irq(zone);
 			continue;
 		}
 		SetPageLRU(page);
@@ -1349,17 +1390,14 @@ putback_lru_pages(struct zone *zone, struct scan_control *sc,
 			int numpages = hpage_nr_pages(page);
 			reclaim_stat->recent_rotated[file] += numpages;
 		}
-		if (!pagevec_add(&pvec, page)) {
-			spin_unlock_irq(&zone->lru_lock);
-			__pagevec_release(&pvec);
-			spin_lock_irq(&zone->lru_lock);
-		}
+		if (put_page_testzero(page))
+			putback_free_page(zone, page, lru, &pages_to_free);
 	}
 	__mod_zone_page_state(zone, NR_ISOLATED_ANON, -nr_anon);
 	__mod_zone_page_state(zone, NR_ISOLATED_FILE, -nr_file);
 
-	spin_unlock_irq(&zone->lru_lock);
-	pagevec_release(&pvec);
+	lru_unlock_irq(zone);
+	free_page_list(&pages_to_free);
 }
 
 static noinline_for_stack void update_isolated_counts(struct zone *zone,
@@ -1459,7 +1497,7 @@ shrink_inactive_list(unsigned long nr_to_scan, struct zone *zone,
 
 	set_reclaim_mode(priority, sc, false);
 	lru_add_drain();
-	spin_lock_irq(&zone->lru_lock);
+	lru_lock_irq(zone);
 
 	if (scanning_global_lru(sc)) {
 		nr_taken = isolate_pages_global(nr_to_scan,
@@ -1488,13 +1526,13 @@ shrink_inactive_list(unsigned long nr_to_scan, struct zone *zone,
 	}
 
 	if (nr_taken == 0) {
-		spin_unlock_irq(&zone->lru_lock);
+		lru_unlock_irq(zone);
 		return 0;
 	}
 
 	update_isolated_counts(zone, sc, &nr_anon, &nr_file, &page_list);
 
-	spin_unlock_irq(&zone->lru_lock);
+	lru_unlock_irq(zone);
 
 	nr_reclaimed = shrink_page_list(&page_list, zone, sc);
 
@@ -1519,6 +1557,60 @@ shrink_inactive_list(unsigned long nr_to_scan, struct zone *zone,
 	return nr_reclaimed;
 }
 
+#ifdef CONFIG_PROCESS_RECLAIM
+/**
+ * reclaim_pages_from_list() - reclaim pages isolated from a process
+ * @page_list:	pages taken off the LRU with isolate_lru_page()
+ *
+ * For /proc/<pid>/reclaim, which finds the pages by walking the page
+ * tables of one process instead of scanning the LRU.  The pages are
+ * reclaimed regardless of their referenced state, and those which cannot
+ * be reclaimed are put back on the inactive lists.  Returns the number
+ * of pages reclaimed.
+ */
+unsigned long reclaim_pages_from_list(struct list_head *page_list)
+{
+	struct scan_control sc = {
+		.gfp_mask = GFP_KERNEL,
+		.may_writepage = !laptop_mode,
+		.may_unmap = 1,
+		.may_swap = 1,
+		.ignore_references = 1,
+		.reclaim_mode = RECLAIM_MODE_SINGLE | RECLAIM_MODE_ASYNC,
+	};
+	unsigned long nr_reclaimed = 0;
+
+	/* shrink_page_list() wants the pages of one zone at a time */
+	while (!list_empty(page_list)) {
+		struct zone *zone = page_zone(lru_to_page(page_list));
+		unsigned long nr_anon = 0, nr_file = 0, nr_freed;
+		struct page *page, *next;
+		LIST_HEAD(zone_list);
+
+		list_for_each_entry_safe(page, next, page_list, lru) {
+			if (page_zone(page) != zone)
+				continue;
+			list_move(&page->lru, &zone_list);
+			ClearPageActive(page);
+			if (page_is_file_cache(page))
+				nr_file++;
+			else
+				nr_anon++;
+		}
+		mod_zone_page_state(zone, NR_ISOLATED_ANON, nr_anon);
+		mod_zone_page_state(zone, NR_ISOLATED_FILE, nr_file);
+
+		nr_freed = shrink_page_list(&zone_list, zone, &sc);
+
+		local_irq_disable();
+		__count_zone_vm_events(PGSTEAL, zone, nr_freed);
+		putback_lru_pages(zone, &sc, nr_anon, nr_file, &zone_list);
+		nr_reclaimed += nr_freed;
+	}
+	return nr_reclaimed;
+}
+#endif /* CONFIG_PROCESS_RECLAIM */
+
 /*
  * This moves pages from the active list to the inactive list.
  *
@@ -1539,14 +1631,12 @@ shrink_inactive_list(unsigned long nr_to_scan, struct zone *zone,
 
 static void move_active_pages_to_lru(struct zone *zone,
 				     struct list_head *list,
+				     struct list_head *pages_to_free,
 				     enum lru_list lru)
 {
 	unsigned long pgmoved = 0;
-	struct pagevec pvec;
 	struct page *page;
 
-	pagevec_init(&pvec, 1);
-
 	while (!list_empty(list)) {
 		page = lru_to_page(list);
 
@@ -1557,13 +1647,9 @@ static void move_active_pages_to_lru(struct zone *zone,
 		mem_cgroup_add_lru_list(page, lru);
 		pgmoved += hpage_nr_pages(page);
 
-		if (!pagevec_add(&pvec, page) || list_empty(list)) {
-			spin_unlock_irq(&zone->lru_lock);
-			if (buffer_heads_over_limit)
-				pagevec_strip(&pvec);
-			__pagevec_release(&pvec);
-			spin_lock_irq(&zone->lru_lock);
-		}
+		/* pgmoved counts it, del_page_from_lru_list() takes it off */
+		if (put_page_testzero(page))
+			putback_free_page(zone, page, lru, pages_to_free);
 	}
 	__mod_zone_page_state(zone, NR_LRU_BASE + lru, pgmoved);
 	if (!is_active_lru(lru))
@@ -1579,12 +1665,13 @@ static void shrink_active_list(unsigned long nr_pages, struct zone *zone,
 	LIST_HEAD(l_hold);	/* The pages which were snipped off */
 	LIST_HEAD(l_active);
 	LIST_HEAD(l_inactive);
+	LIST_HEAD(pages_to_free);
 	struct page *page;
 	struct zone_reclaim_stat *reclaim_stat = get_reclaim_stat(zone, sc);
 	unsigned long nr_rotated = 0;
 
 	lru_add_drain();
-	spin_lock_irq(&zone->lru_lock);
+	lru_lock_irq(zone);
 	if (scanning_global_lru(sc)) {
 		nr_taken = isolate_pages_global(nr_pages, &l_hold,
 						&pgscanned, sc->order,
@@ -1610,7 +1697,7 @@ static void shrink_active_list(unsigned long nr_pages, struct zone *zone,
 	else
 		__mod_zone_page_state(zone, NR_ACTIVE_ANON, -nr_taken);
 	__mod_zone_page_state(zone, NR_ISOLATED_ANON + file, nr_taken);
-	spin_unlock_irq(&zone->lru_lock);
+	lru_unlock_irq(zone);
 
 	while (!list_empty(&l_hold)) {
 		cond_resched();
@@ -1622,6 +1709,14 @@ static void shrink_active_list(unsigned long nr_pages, struct zone *zone,
 			continue;
 		}
 
+		if (unlikely(buffer_heads_over_limit)) {
+			if (page_has_private(page) && trylock_page(page)) {
+				if (page_has_private(page))
+					try_to_release_page(page, 0);
+				unlock_page(page);
+			}
+		}
+
 		if (page_referenced(page, 0, sc->mem_cgroup, &vm_flags)) {
 			nr_rotated += hpage_nr_pages(page);
 			/*
@@ -1646,7 +1741,7 @@ static void shrink_active_list(unsigned long nr_pages, struct zone *zone,
 	/*
 	 * Move pages back to the lru list.
 	 */
-	spin_lock_irq(&zone->lru_lock);
+	lru_lock_irq(zone);
 	/*
 	 * Count referenced pages from currently used mappings as rotated,
 	 * even though only some of them are actually re-activated.  This
@@ -1655,12 +1750,14 @@ static void shrink_active_list(unsigned long nr_pages, struct zone *zone,
 	 */
 	reclaim_stat->recent_rotated[file] += nr_rotated;
 
-	move_active_pages_to_lru(zone, &l_active,
+	move_active_pages_to_lru(zone, &l_active, &pages_to_free,
 						LRU_ACTIVE + file * LRU_FILE);
-	move_active_pages_to_lru(zone, &l_inactive,
+	move_active_pages_to_lru(zone, &l_inactive, &pages_to_free,
 						LRU_BASE   + file * LRU_FILE);
 	__mod_zone_page_state(zone, NR_ISOLATED_ANON + file, -nr_taken);
-	spin_unlock_irq(&zone->lru_lock);
+	lru_unlock_irq(zone);
+
+	free_page_list(&pages_to_free);
 }
 
 #ifdef CONFIG_SWAP
@@ -1852,7 +1949,7 @@ static void get_scan_count(struct zone *zone, struct scan_control *sc,
 	 *
 	 * anon in [0], file in [1]
 	 */
-	spin_lock_irq(&zone->lru_lock);
+	lru_lock_irq(zone);
 	if (unlikely(reclaim_stat->recent_scanned[0] > anon / 4)) {
 		reclaim_stat->recent_scanned[0] /= 2;
 		reclaim_stat->recent_rotated[0] /= 2;
@@ -1873,7 +1970,7 @@ static void get_scan_count(struct zone *zone, struct scan_control *sc,
 
 	fp = (file_prio + 1) * (reclaim_stat->recent_scanned[1] + 1);
 	fp /= reclaim_stat->recent_rotated[1] + 1;
-	spin_unlock_irq(&zone->lru_lock);
+	lru_unlock_irq(zone);
 
 	fraction[0] = ap;
 	fraction[1] = fp;
@@ -3330,16 +3427,16 @@ void scan_mapping_unevictable_pages(struct address_space *mapping)
 
 			if (pagezone != zone) {
 				if (zone)
-					spin_unlock_irq(&zone->lru_lock);
+					lru_unlock_irq(zone);
 				zone = pagezone;
-				spin_lock_irq(&zone->lru_lock);
+				lru_lock_irq(zone);
 			}
 
 			if (PageLRU(page) && PageUnevictable(page))
 				check_move_unevictable_page(page, zone);
 		}
 		if (zone)
-			spin_unlock_irq(&zone->lru_lock);
+			lru_unlock_irq(zone);
 		pagevec_release(&pvec);
 
 		count_vm_events(UNEVICTABLE_PGSCANNED, pg_scanned);
@@ -3368,7 +3465,7 @@ static void scan_zone_unevictable_pages(struct zone *zone)
 		unsigned long batch_size = min(nr_to_scan,
 						SCAN_UNEVICTABLE_BATCH_SIZE);
 
-		spin_lock_irq(&zone->lru_lock);
+		lru_lock_irq(zone);
 		for (scan = 0;  scan < batch_size; scan++) {
 			struct page *page = lru_to_page(l_unevictable);
 
@@ -3382,7 +3479,7 @@ static void scan_zone_unevictable_pages(struct zone *zone)
 
 			unlock_page(page);
 		}
-		spin_unlock_irq(&zone->lru_lock);
+		lru_unlock_irq(zone);
 
 		nr_to_scan -= batch_size;
 	}
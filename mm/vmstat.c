@@ -613,6 +613,9 @@ static char * const migratetype_names[MIGRATE_TYPES] = {
 	"Reclaimable",
 	"Movable",
 	"Reserve",
+#ifdef CONFIG_CMA
+	"CMA",
+#endif
 	"Isolate",
 };
 
@@ -708,6 +711,8 @@ const char * const vmstat_text[] = {
 	"nr_shmem",
 	"nr_dirtied",
 	"nr_written",
+	"workingset_refault",
+	"workingset_activate",
 
 #ifdef CONFIG_NUMA
 	"numa_hit",
@@ -778,6 +783,12 @@ const char * const vmstat_text[] = {
 	"unevictable_pgs_stranded",
 	"unevictable_pgs_mlockfreed",
 
+#ifdef CONFIG_SWAP
+	"swap_ra",
+	"swap_ra_hit",
+	"swap_ra_miss",
+#endif
+
 #ifdef CONFIG_TRANSPARENT_HUGEPAGE
 	"thp_fault_alloc",
 	"thp_fault_fallback",
@@ -1021,6 +1032,19 @@ static void zoneinfo_show_print(struct seq_file *m, pg_data_t *pgdat,
 		   zone->all_unreclaimable,
 		   zone->zone_start_pfn,
 		   zone->inactive_ratio);
+#ifdef CONFIG_LRU_LOCK_STAT
+	seq_printf(m,
+		   "\n  lru_lock acquired:    %lu"
+		   "\n           contended:   %lu"
+		   "\n           wait_us:     %llu"
+		   "\n           hold_us:     %llu"
+		   "\n           max_hold_us: %llu",
+		   zone->lru_lock_stat.acquired,
+		   zone->lru_lock_stat.contended,
+		   div_u64(zone->lru_lock_stat.wait_ns, NSEC_PER_USEC),
+		   div_u64(zone->lru_lock_stat.hold_ns, NSEC_PER_USEC),
+		   div_u64(zone->lru_lock_stat.max_hold_ns, NSEC_PER_USEC));
+#endif
 	seq_putc(m, '\n');
 }
 
@@ -0,0 +1,130 @@
+/*
+ * mm/workingset.c - workingset detection for the page cache
+ *
+ * The file LRU is split into an inactive list, where new pages start, and
+ * an active list for pages that were accessed again while inactive.  If
+ * the inactive list is too small for a workload's access pattern, its
+ * pages are evicted before their second access and the workload thrashes
+ * without ever promoting them.
+ *
+ * To notice that, each zone counts the pages that leave its inactive file
+ * list, by eviction or activation, in zone->inactive_age.  When reclaim
+ * evicts a page cache page, it leaves a shadow entry with the current
+ * counter in the page's radix tree slot.  When the page is faulted back
+ * in, the difference between the counter then and the one in the shadow
+ * is the refault distance: how many more slots the inactive list would
+ * have needed to keep the page until this access.
+ *
+ * The inactive list can only grow at the expense of the active list, so
+ * a page whose refault distance is no bigger than the active file list
+ * could have stayed in memory.  Such a page is activated at once, and so
+ * competes with the active pages instead of being evicted from the
+ * inactive list once more.
+ *
+ * Shadow entries live until the page is faulted back in or its range is
+ * truncated, which includes the final truncate when the inode is evicted.
+ * Mappings that are never evicted, like the block device inode behind a
+ * mounted filesystem's metadata, would collect them without bound, so a
+ * mapping gets no new shadows once it holds as many as could still be
+ * useful: a shadow older than the active file list never activates.
+ */
+
+#include <linux/mm.h>
+#include <linux/mmzone.h>
+#include <linux/swap.h>
+#include <linux/pagemap.h>
+#include <linux/radix-tree.h>
+#include <linux/vmstat.h>
+
+#define EVICTION_SHIFT	(RADIX_TREE_EXCEPTIONAL_SHIFT + \
+			 NODES_SHIFT + ZONES_SHIFT)
+#define EVICTION_MASK	(~0UL >> EVICTION_SHIFT)
+
+static void *pack_shadow(unsigned long eviction, struct zone *zone)
+{
+	eviction = (eviction << NODES_SHIFT) | zone_to_nid(zone);
+	eviction = (eviction << ZONES_SHIFT) | zone_idx(zone);
+	eviction = (eviction << RADIX_TREE_EXCEPTIONAL_SHIFT);
+
+	return (void *)(eviction | RADIX_TREE_EXCEPTIONAL_ENTRY);
+}
+
+static void unpack_shadow(void *shadow, struct zone **zone,
+			  unsigned long *distance)
+{
+	unsigned long entry = (unsigned long)shadow;
+	unsigned long eviction, refault;
+	int zid, nid;
+
+	entry >>= RADIX_TREE_EXCEPTIONAL_SHIFT;
+	zid = entry & ((1UL << ZONES_SHIFT) - 1);
+	entry >>= ZONES_SHIFT;
+	nid = entry & ((1UL << NODES_SHIFT) - 1);
+	entry >>= NODES_SHIFT;
+	eviction = entry;
+
+	*zone = NODE_DATA(nid)->node_zones + zid;
+
+	refault = atomic_long_read(&(*zone)->inactive_age);
+	/*
+	 * The shadow only has room for the low bits of the counter.  The
+	 * masked unsigned subtraction gives the right distance across a
+	 * wrap of those bits, as long as the page was not gone for a full
+	 * period; on 32 bit that is still millions of evictions.
+	 */
+	*distance = (refault - eviction) & EVICTION_MASK;
+}
+
+/**
+ * workingset_eviction - note the eviction of a page from memory
+ * @mapping: address space the page was backing
+ * @page: the page being evicted
+ *
+ * Returns a shadow entry to be stored in @mapping->page_tree in place
+ * of the evicted @page so that a later refault can be detected, or NULL
+ * if @mapping has enough shadow entries already.  Called with the
+ * mapping's tree_lock held.
+ */
+void *workingset_eviction(struct address_space *mapping, struct page *page)
+{
+	struct zone *zone = page_zone(page);
+	unsigned long eviction;
+
+	eviction = atomic_long_inc_return(&zone->inactive_age);
+	if (mapping->nrshadows >= zone_page_state(zone, NR_ACTIVE_FILE))
+		return NULL;
+	return pack_shadow(eviction, zone);
+}
+
+/**
+ * workingset_refault - evaluate the refault of a previously evicted page
+ * @shadow: shadow entry of the evicted page
+ *
+ * Calculates and evaluates the refault distance of the previously
+ * evicted page in the context of the zone it was allocated in.
+ *
+ * Returns %true if the page should be activated, %false otherwise.
+ */
+bool workingset_refault(void *shadow)
+{
+	unsigned long refault_distance;
+	struct zone *zone;
+
+	unpack_shadow(shadow, &zone, &refault_distance);
+	inc_zone_state(zone, WORKINGSET_REFAULT);
+
+	if (refault_distance <= zone_page_state(zone, NR_ACTIVE_FILE)) {
+		inc_zone_state(zone, WORKINGSET_ACTIVATE);
+		return true;
+	}
+	return false;
+}
+
+/**
+ * workingset_activation - note a page activation
+ * @page: page that is being activated
+ */
+void workingset_activation(struct page *page)
+{
+	atomic_long_inc(&page_zone(page)->inactive_age);
+}